@@ -0,0 +1,106 @@
+#Expands #include directives of all shaders in res/shaders and writes them into a c++ source table,
+#used by LoadShaderSource (src/Shader.cpp) instead of reading the files at runtime.
+#Runs in script mode: cmake -DSOURCE_DIR=<repository root> -DOUTPUT=<generated .cpp> -P EmbedShaders.cmake
+#Expansion mirrors loadSource from src/Shader.cpp: every line containing #include is replaced
+#by the included file (path relative to the including one), every line ends with a newline.
+
+if (NOT SOURCE_DIR OR NOT OUTPUT)
+	message(FATAL_ERROR "EmbedShaders: SOURCE_DIR and OUTPUT have to be defined")
+endif()
+
+#Raw string literals are split into chunks, msvc limits the length of a single literal
+set(CHUNK_SIZE 8000)
+
+#Expanded source of a file, includes already expanded once are reused (e.g. sky/common.glsl)
+function(expand_shader path result)
+	string(MAKE_C_IDENTIFIER "${path}" key)
+	get_property(expanded GLOBAL PROPERTY EXPANDED_${key} SET)
+
+	if (expanded)
+		get_property(content GLOBAL PROPERTY EXPANDED_${key})
+		set(${result} "${content}" PARENT_SCOPE)
+		return()
+	endif()
+
+	if (NOT EXISTS "${path}")
+		message(FATAL_ERROR "EmbedShaders: Could not open shader source file: ${path}")
+	endif()
+
+	file(READ "${path}" content)
+
+	if (NOT content MATCHES "\n$")
+		string(APPEND content "\n")
+	endif()
+
+	#Leading newline, so that every line is delimited on both sides
+	set(content "\n${content}")
+
+	get_filename_component(directory "${path}" DIRECTORY)
+	string(REGEX MATCHALL "\n[^\n]*#include[^\n]*" include_lines "${content}")
+
+	foreach(include_line IN LISTS include_lines)
+		string(REGEX REPLACE "^\n[^\"]*\"(.*)\"[^\"]*$" "\\1" filename "${include_line}")
+		get_filename_component(include_path "${directory}/${filename}" ABSOLUTE)
+
+		expand_shader("${include_path}" included)
+
+		#Same directive may appear more than once
+		string(FIND "${content}" "${include_line}\n" position)
+
+		while (position GREATER_EQUAL 0)
+			string(REPLACE "${include_line}\n" "\n${included}" content "${content}")
+			string(FIND "${content}" "${include_line}\n" position)
+		endwhile()
+	endforeach()
+
+	string(SUBSTRING "${content}" 1 -1 content)
+
+	set_property(GLOBAL PROPERTY EXPANDED_${key} "${content}")
+	set(${result} "${content}" PARENT_SCOPE)
+endfunction()
+
+file(GLOB_RECURSE shader_files
+	"${SOURCE_DIR}/res/shaders/*.glsl"
+	"${SOURCE_DIR}/res/shaders/*.vert"
+	"${SOURCE_DIR}/res/shaders/*.frag"
+)
+
+list(SORT shader_files)
+
+set(chunks "")
+set(table "")
+set(index 0)
+
+foreach(shader_file IN LISTS shader_files)
+	file(RELATIVE_PATH relative_path "${SOURCE_DIR}" "${shader_file}")
+
+	expand_shader("${shader_file}" source)
+
+	string(LENGTH "${source}" length)
+	string(APPEND chunks "//${relative_path}\nconst char* const s_Chunks${index}[] = {\n")
+
+	set(offset 0)
+
+	while (offset LESS length)
+		string(SUBSTRING "${source}" ${offset} ${CHUNK_SIZE} chunk)
+		string(APPEND chunks "R\"lofi(${chunk})lofi\",\n")
+		math(EXPR offset "${offset} + ${CHUNK_SIZE}")
+	endwhile()
+
+	string(APPEND chunks "nullptr\n};\n\n")
+	string(APPEND table "    { \"${relative_path}\", s_Chunks${index} },\n")
+
+	math(EXPR index "${index} + 1")
+endforeach()
+
+file(WRITE "${OUTPUT}"
+	"//Generated by cmake/EmbedShaders.cmake from res/shaders, do not edit\n\n"
+	"#include \"EmbeddedShaders.h\"\n\n"
+	"namespace {\n\n"
+	"${chunks}"
+	"}\n\n"
+	"const EmbeddedShader g_EmbeddedShaders[] = {\n"
+	"${table}"
+	"    { nullptr, nullptr }\n"
+	"};\n"
+)
@@ -0,0 +1,37 @@
+//Clipmap vertex input, shared by all vertex shaders drawing clipmap geometry.
+//Displaced mode: aPos comes from the vertex buffer, height was written by displace.glsl
+//Sampled mode: aPos comes from the (static) vertex buffer, height is sampled from the heightmap
+//Instanced mode: position is rebuilt from local grid coordinates and per-instance
+//data (origin.xz, vertex spacing, snap scale), height is sampled from the heightmap
+//Sampled heights come from the heightmap stack instead if it is active (height_stack.glsl)
+
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in uvec2 aLocal;
+layout (location = 2) in vec4 aInstance;
+
+uniform int uInstanced;
+uniform int uSampleHeight;
+
+uniform sampler2D heightmap;
+
+#include "frame.glsl"
+
+#include "height_stack.glsl"
+
+//xz - position relative to the snapped camera position, w - snap scale
+vec4 getClipmapVertex() {
+    if (uInstanced == 1) {
+        vec2 xz = aInstance.xy + aInstance.z * vec2(aLocal);
+        return vec4(xz.x, 0.0, xz.y, aInstance.w);
+    }
+
+    return aPos;
+}
+
+//Same sampling as in displace.glsl
+float getClipmapHeight(vec4 vertex, vec2 uv) {
+    if (uSampleHeight == 1)
+        return 0.5 * uScaleY * getMapHeight(heightmap, uv);
+
+    return vertex.y;
+}
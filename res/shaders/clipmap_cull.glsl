@@ -0,0 +1,190 @@
+#version 450 core
+
+//Frustum (and optionally occlusion) culling of clipmap grids, appends indirect draw commands
+//of the visible ones. Vertical extents of each grid come from the max mip chain of the
+//heightmap (maximal_mip.glsl), occlusion is tested against a max depth pyramid (hi-z).
+
+struct Entry {
+    //center.xz, half side length (negative - never culled), snap scale
+    vec4 bounds;
+    //element count, first index, base vertex, topology
+    uvec4 draw;
+    vec4 instance;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer entryBuffer
+{
+    Entry entries[];
+};
+
+layout(std430, binding = 1) buffer commandBuffer
+{
+    DrawCommand commands[];
+};
+
+layout(std430, binding = 2) buffer counterBuffer
+{
+    uint drawCount;
+};
+
+layout(std430, binding = 3) writeonly buffer instanceBuffer
+{
+    vec4 instances[];
+};
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+uniform sampler2D heightmap;
+
+#include "frame.glsl"
+
+//Frustum planes in the coordinate system tied to the grid (see PerspectiveCamera::updateFrustum)
+uniform vec3 uPlaneOrigins[6];
+uniform vec3 uPlaneNormals[6];
+
+uniform int uNumEntries;
+uniform int uInstanced;
+
+uniform int uOcclusion;
+uniform sampler2D hizmap;
+
+#include "height_stack.glsl"
+
+//Maximal height within the uv rectangle
+float maxHeight(vec2 uv_min, vec2 uv_max) {
+    int top = textureQueryLevels(heightmap) - 1;
+
+    //Rectangles crossing the border of the map use maximum of the entire map
+    if (any(lessThan(uv_min, vec2(0.0))) || any(greaterThan(uv_max, vec2(1.0))))
+        return texelFetch(heightmap, ivec2(0), top).r;
+
+    //Texels of this mip are at least as large as the rectangle, so it covers at most 2x2 of them
+    float extent = max(uv_max.x - uv_min.x, uv_max.y - uv_min.y) * float(textureSize(heightmap, 0).x);
+    int mip = clamp(int(ceil(log2(max(extent, 1.0)))), 0, top);
+
+    ivec2 size = textureSize(heightmap, mip);
+    ivec2 t0 = clamp(ivec2(uv_min * vec2(size)), ivec2(0), size - 1);
+    ivec2 t1 = clamp(ivec2(uv_max * vec2(size)), ivec2(0), size - 1);
+
+    float h =  texelFetch(heightmap, ivec2(t0.x, t0.y), mip).r;
+    h = max(h, texelFetch(heightmap, ivec2(t1.x, t0.y), mip).r);
+    h = max(h, texelFetch(heightmap, ivec2(t0.x, t1.y), mip).r);
+    h = max(h, texelFetch(heightmap, ivec2(t1.x, t1.y), mip).r);
+
+    return h;
+}
+
+//Box is in world space
+bool isOccluded(vec3 center, vec3 extents) {
+    vec3 ndc_min = vec3( 1e30);
+    vec3 ndc_max = vec3(-1e30);
+
+    for (int i = 0; i < 8; i++) {
+        vec3 corner_sign = vec3((i & 1) == 0 ? -1.0 : 1.0,
+                                (i & 2) == 0 ? -1.0 : 1.0,
+                                (i & 4) == 0 ? -1.0 : 1.0);
+
+        vec4 clip = uViewProj * vec4(center + corner_sign * extents, 1.0);
+
+        //Box intersects the near plane
+        if (clip.w <= 0.0)
+            return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        ndc_min = min(ndc_min, ndc);
+        ndc_max = max(ndc_max, ndc);
+    }
+
+    vec2 uv_min = clamp(0.5 * ndc_min.xy + 0.5, vec2(0.0), vec2(1.0));
+    vec2 uv_max = clamp(0.5 * ndc_max.xy + 0.5, vec2(0.0), vec2(1.0));
+    float depth = 0.5 * ndc_min.z + 0.5;
+
+    int top = textureQueryLevels(hizmap) - 1;
+
+    //Mip where the rectangle covers at most 2x2 texels, one level coarser since
+    //the pyramid is rendered at lower resolution than the screen
+    vec2 extent = (uv_max - uv_min) * vec2(textureSize(hizmap, 0));
+    int mip = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))) + 1, 0, top);
+
+    ivec2 size = textureSize(hizmap, mip);
+    ivec2 t0 = clamp(ivec2(uv_min * vec2(size)), ivec2(0), size - 1);
+    ivec2 t1 = clamp(ivec2(uv_max * vec2(size)), ivec2(0), size - 1);
+
+    float occluder =        texelFetch(hizmap, ivec2(t0.x, t0.y), mip).r;
+    occluder = max(occluder, texelFetch(hizmap, ivec2(t1.x, t0.y), mip).r);
+    occluder = max(occluder, texelFetch(hizmap, ivec2(t0.x, t1.y), mip).r);
+    occluder = max(occluder, texelFetch(hizmap, ivec2(t1.x, t1.y), mip).r);
+
+    return depth > occluder;
+}
+
+bool isVisible(Entry e) {
+    if (e.bounds.z < 0.0)
+        return true;
+
+    //Grid is drawn shifted by the snapped camera position
+    vec2 snap_offset = mod(uCameraPos.xz, e.bounds.w);
+    vec2 hoffset = uCameraPos.xz - snap_offset;
+
+    vec2 uv_min = (e.bounds.xy - e.bounds.z + hoffset) / uScaleXZ + 0.5;
+    vec2 uv_max = (e.bounds.xy + e.bounds.z + hoffset) / uScaleXZ + 0.5;
+
+    //Same scaling as in displace.glsl, lower bound kept from the old fixed bounding boxes
+    float bottom = -0.1 * uScaleY;
+    float top = 0.5 * uScaleY * maxHeight(uv_min, uv_max);
+
+    //Stack has no max mips, fall back to the old fixed bounding boxes (heights up to 1.0)
+    if (uHeightStack == 1)
+        top = 0.5 * uScaleY;
+
+    vec3 center = vec3(e.bounds.x - snap_offset.x, 0.5 * (top + bottom), e.bounds.y - snap_offset.y);
+    vec3 extents = vec3(e.bounds.z, 0.5 * (top - bottom), e.bounds.z);
+
+    //Same test as Plane::IsInFront
+    for (int i = 0; i < 6; i++) {
+        float r = dot(extents, abs(uPlaneNormals[i]));
+        float sd = -dot(uPlaneOrigins[i] - center, uPlaneNormals[i]);
+
+        if (sd < -r)
+            return false;
+    }
+
+    if (uOcclusion == 1)
+        return !isOccluded(center + vec3(uCameraPos.x, 0.0, uCameraPos.z), extents);
+
+    return true;
+}
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+
+    if (id >= uint(uNumEntries))
+        return;
+
+    Entry e = entries[id];
+
+    if (!isVisible(e))
+        return;
+
+    if (uInstanced == 1) {
+        //Commands are per topology, instances are appended to their ranges
+        uint topology = e.draw.w;
+        uint slot = atomicAdd(commands[topology].instanceCount, 1u);
+
+        instances[commands[topology].baseInstance + slot] = e.instance;
+    }
+
+    else {
+        uint slot = atomicAdd(drawCount, 1u);
+
+        commands[slot] = DrawCommand(e.draw.x, 1u, e.draw.y, int(e.draw.z), 0u);
+    }
+}
@@ -9,26 +9,66 @@ layout(std430, binding = 1) buffer vertexBuffer
     Vert verts[];
 };
 
-layout(local_size_x = 1024, local_size_y = 1, local_size_z = 1) in;
+//Range of a single grid/fill within the vertex buffer
+struct Descriptor {
+    uint baseVertex;
+    uint vertexCount;
+    uint level;
+    uint padding;
+};
+
+layout(std430, binding = 2) readonly buffer descriptorBuffer
+{
+    Descriptor descriptors[];
+};
+
+//x - vertex within the drawable, y - drawable (descriptor) index
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
 
 uniform sampler2D heightmap;
 
-uniform float uScaleXZ;
-uniform float uScaleY;
+#include "frame.glsl"
+
 uniform vec2 uPos;
 
 uniform float uModScale;
 
+#include "height_stack.glsl"
+
+//Bit i is set if level i should be displaced
+uniform int uDirtyLevels;
+
+//If set, only vertices within the uv rectangle (min.xy, max.xy) of the
+//heightmap are displaced. Tested on wrapped uv, which is conservative for finite maps
+uniform int uUseDirtyRect;
+uniform vec4 uDirtyRect;
+
 void main() {
-    uint i = gl_GlobalInvocationID.x;
+    Descriptor d = descriptors[gl_GlobalInvocationID.y];
+
+    if ((uDirtyLevels & (1 << d.level)) == 0)
+        return;
+
+    //Dispatch is sized for the largest drawable
+    if (gl_GlobalInvocationID.x >= d.vertexCount)
+        return;
+
+    uint i = d.baseVertex + gl_GlobalInvocationID.x;
 
     vec2 hoffset = uPos - mod(uPos, verts[i].pos.w);
     //vec2 hoffset = uPos - mod(uPos, uModScale);
 
     vec2 uv = (2.0/uScaleXZ) * (verts[i].pos.xz + hoffset);
     uv = 0.5*uv + 0.5;
+
+    if (uUseDirtyRect == 1) {
+        vec2 p = fract(uv);
+
+        if (any(lessThan(p, uDirtyRect.xy)) || any(greaterThan(p, uDirtyRect.zw)))
+            return;
+    }
     
-    float height = 0.5 * uScaleY * texture(heightmap, uv).r;
+    float height = 0.5 * uScaleY * getMapHeight(heightmap, uv);
 
     verts[i].pos.y = height;
 }
@@ -0,0 +1,27 @@
+//State shared by all passes of a frame, written once per frame by the Renderer
+//(see FrameUniforms/MapUniforms in src/Renderer.h, layouts have to match)
+#ifndef FRAME_GLSL
+#define FRAME_GLSL
+
+layout(std140, binding = 1) uniform FrameData {
+    mat4 uViewProj;
+
+    vec3 uCameraPos;
+    vec3 uCameraFront;
+
+    //View directions through the corners of the screen
+    vec3 uBotLeft;
+    vec3 uBotRight;
+    vec3 uTopLeft;
+    vec3 uTopRight;
+
+    vec3 uSunDir;
+    vec3 uSunCol;
+};
+
+layout(std140, binding = 2) uniform MapData {
+    float uScaleXZ;
+    float uScaleY;
+};
+
+#endif
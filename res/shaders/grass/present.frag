@@ -5,10 +5,7 @@ in vec2 world_uv;
 
 out vec4 frag_col;
 
-uniform vec3 uPos;
-uniform vec3 uLightDir;
-
-uniform vec3 uSunCol;
+#include "../frame.glsl"
 
 uniform float uSunStr;
 uniform float uSkyDiff;
@@ -149,7 +146,7 @@ vec3 diffuseOnly(vec3 norm, vec3 ldir, vec3 albedo)
 
 void main() {
     
-    vec3 view = normalize(frag_pos - uPos);
+    vec3 view = normalize(frag_pos - uCameraPos);
 
     //Retrieve noise
     vec3 uSlant = uStrength * texture(noise, uNoiseTiling*frag_pos.xz + uTime*uScrollVel).rgb;
@@ -203,10 +200,10 @@ void main() {
     //vec3 albedo = uAlbedo;//vec3(0.9); 
     //float roughness = uRoughness;//0.7f;
 
-    vec3 color = shadow * sun_col * ShadePBR(view, norm, uLightDir, uAlbedo, uRoughness);
+    vec3 color = shadow * sun_col * ShadePBR(view, norm, uSunDir, uAlbedo, uRoughness);
     color += amb * IBL(norm, view, uAlbedo, uRoughness);
-    //color += amb * ref_col * diffuseOnly(norm, -uLightDir, uAlbedo);
-    color += uTranslucent * diffuseOnly(norm, -uLightDir, uAlbedo);
+    //color += amb * ref_col * diffuseOnly(norm, -uSunDir, uAlbedo);
+    color += uTranslucent * diffuseOnly(norm, -uSunDir, uAlbedo);
 
     //Generate fake ao, assumes max_depth = 1.0
     float fake_depth = 1.0 - clamp(0.577*in_dist, 0.0, 1.0);
@@ -1,11 +1,6 @@
 #version 450 core
 
-layout (location = 0) in vec4 aPos;
-
-uniform float uL;
-uniform mat4 uMVP;
-
-uniform vec3 uPos;
+#include "../clipmap.glsl"
 
 uniform float uGrassHeight;
 
@@ -14,12 +9,16 @@ out vec2 world_uv;
 out vec3 frag_pos;
 
 void main() {
-    vec2 hoffset = uPos.xz - mod(uPos.xz, aPos.w);
+    vec4 vertex = getClipmapVertex();
 
-    world_uv = (2.0/uL) * (aPos.xz + hoffset);
+    vec2 hoffset = uCameraPos.xz - mod(uCameraPos.xz, vertex.w);
+
+    world_uv = (2.0/uScaleXZ) * (vertex.xz + hoffset);
     world_uv = 0.5*world_uv + 0.5;
+
+    vertex.y = getClipmapHeight(vertex, world_uv);
     
-    frag_pos = aPos.xyz + vec3(hoffset.x, uGrassHeight, hoffset.y);
+    frag_pos = vertex.xyz + vec3(hoffset.x, uGrassHeight, hoffset.y);
 
-    gl_Position = uMVP * vec4(aPos.xyz + vec3(hoffset.x, uGrassHeight, hoffset.y), 1.0);
+    gl_Position = uViewProj * vec4(frag_pos, 1.0);
 }
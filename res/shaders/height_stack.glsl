@@ -0,0 +1,54 @@
+//Toroidal heightmap stack used by unbounded worlds (see MapGenerator::UpdateHeightStack).
+//Layer i covers (uStackExtent * 2^i)^2 in map uv units around the camera, texel
+//with global coordinates p is stored at p mod uStackResolution, so the stack is
+//sampled with repeat wrapping.
+
+uniform int uHeightStack;
+uniform sampler2DArray heightStack;
+
+//Uv of the camera the stack was last updated for
+uniform vec2 uStackCenter;
+//Uv extent of the finest layer
+uniform float uStackExtent;
+uniform int uStackLayers;
+uniform int uStackResolution;
+
+float getStackLayerExtent(int layer) {
+    return uStackExtent * exp2(float(layer));
+}
+
+//Finest layer containing uv, layers are centered on the camera up to a texel
+//and sampling needs a texel around, so 2 texel margin is kept
+int getStackLayer(vec2 uv) {
+    vec2 d = abs(uv - uStackCenter);
+    float dist = max(d.x, d.y);
+
+    float usable = (0.5 - 2.0/float(uStackResolution)) * uStackExtent;
+    int layer = int(ceil(log2(max(dist/usable, 1.0))));
+
+    return min(layer, uStackLayers - 1);
+}
+
+float sampleStackLayer(vec2 uv, int layer) {
+    return textureLod(heightStack, vec3(uv / getStackLayerExtent(layer), float(layer)), 0.0).r;
+}
+
+//Height in [0,1] range of the fixed heightmap, from whichever source is active
+float getMapHeight(sampler2D heightmap, vec2 uv) {
+    if (uHeightStack == 1)
+        return sampleStackLayer(uv, getStackLayer(uv));
+
+    return textureLod(heightmap, uv, 0.0).r;
+}
+
+//Same convention as terrain/normal.glsl
+vec3 getStackNormal(vec2 uv, float scale_xz, float scale_y) {
+    int layer = getStackLayer(uv);
+    vec2 h = vec2(0.0, getStackLayerExtent(layer) / float(uStackResolution));
+
+    return normalize(vec3(
+        scale_y*0.5*(sampleStackLayer(uv+h.yx, layer) - sampleStackLayer(uv-h.yx, layer))/h.y,
+        scale_xz,
+        scale_y*0.5*(sampleStackLayer(uv+h.xy, layer) - sampleStackLayer(uv-h.xy, layer))/h.y
+    ));
+}
@@ -0,0 +1,8 @@
+#version 450 core
+
+//Depth of the occluders, max-reduced into the hi-z pyramid afterwards
+out float frag_depth;
+
+void main() {
+    frag_depth = gl_FragCoord.z;
+}
@@ -21,16 +21,11 @@ uniform sampler2DArray normal;
 uniform samplerCube irradiance;
 uniform samplerCube prefiltered;
 
-uniform vec3 uPos;
-uniform vec3 uLightDir;
-
 uniform int uShadow;
 uniform int uMaterial;
 uniform int uFixTiling;
 uniform int uFog;
 
-uniform vec3 uSunCol;
-
 uniform float uSunStr;
 uniform float uSkyDiff;
 uniform float uSkySpec;
@@ -39,6 +34,10 @@ uniform float uRefStr;
 uniform float uTilingFactor;
 uniform float uNormalStrength;
 
+#include "frame.glsl"
+
+#include "height_stack.glsl"
+
 #define SUM_COMPONENTS(v) (v.x + v.y + v.z + v.w)
 
 vec4 getMaterialTexture(sampler2DArray sampler, vec2 uv_map, vec2 uv_mat) {
@@ -238,6 +237,12 @@ void main() {
     vec3 norm = 2.0*res.xyz - 1.0;
     float amb = res.w;
 
+    //Unbounded worlds take normals from the heightmap stack, ao is only baked for the fixed map
+    if (uHeightStack == 1) {
+        norm = getStackNormal(uv, uScaleXZ, uScaleY);
+        amb = 1.0;
+    }
+
     float mat_amb = 1.0;
     float roughness = 0.7;
     vec3 albedo = vec3(1.0);
@@ -257,8 +262,8 @@ void main() {
     //Band-aid solution, will have to fix normal generation
     norm = vec3(-1.0, 1.0, -1.0)*norm;
 
-    //vec3 view = normalize(frag_pos - uPos);
-    vec3 view = normalize(uPos - frag_pos);
+    //vec3 view = normalize(frag_pos - uCameraPos);
+    vec3 view = normalize(uCameraPos - frag_pos);
     
     //Do pbr lighting
     float shadow = 1.0;
@@ -267,9 +272,9 @@ void main() {
     vec3 sun_col = uSunStr * uSunCol;
     vec3 ref_col = uRefStr * uSunCol;
 
-    vec3 color = shadow * sun_col * ShadePBR(view, norm, uLightDir, albedo, roughness);
+    vec3 color = shadow * sun_col * ShadePBR(view, norm, uSunDir, albedo, roughness);
     color += amb * IBL(norm, view, albedo, roughness);
-    color += amb * ref_col * diffuseOnly(norm, -uLightDir, albedo);
+    color += amb * ref_col * diffuseOnly(norm, -uSunDir, albedo);
     color *= mat_amb;
 
     //Aerial perspective fog
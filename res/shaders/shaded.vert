@@ -1,16 +1,12 @@
 #version 450 core
 
-layout (location = 0) in vec4 aPos;
+#include "clipmap.glsl"
 
 out vec2 uv;
 out mat3 norm_rot;
 out vec3 frag_pos;
 out vec4 fog_data;
 
-uniform float uL;
-uniform vec3 uPos;
-uniform mat4 uMVP;
-
 uniform sampler2D normalmap;
 uniform sampler3D aerial;
 
@@ -26,17 +22,25 @@ mat3 rotation(vec3 N){
 }
 
 void main() {
-    vec2 hoffset = uPos.xz - mod(uPos.xz, aPos.w);
+    vec4 vertex = getClipmapVertex();
+
+    vec2 hoffset = uCameraPos.xz - mod(uCameraPos.xz, vertex.w);
 
-    uv = (2.0/uL) * (aPos.xz + hoffset);
+    uv = (2.0/uScaleXZ) * (vertex.xz + hoffset);
     uv = 0.5*uv + 0.5;
 
+    vertex.y = getClipmapHeight(vertex, uv);
+
     vec3 norm = 2.0*texture(normalmap, uv).rgb - 1.0;
+
+    if (uHeightStack == 1)
+        norm = getStackNormal(uv, uScaleXZ, uScaleY);
+
     norm_rot = rotation(normalize(norm));
 
-    frag_pos = aPos.xyz + vec3(hoffset.x, 0.0, hoffset.y);;
+    frag_pos = vertex.xyz + vec3(hoffset.x, 0.0, hoffset.y);
 
-    vec4 pos = uMVP * vec4(aPos.xyz + vec3(hoffset.x, 0.0, hoffset.y), 1.0);
+    vec4 pos = uViewProj * vec4(frag_pos, 1.0);
 
     if (uFog == 1) {
         //normalized device coordinates should be from [-1, 1], to sample fog we need [0,1]
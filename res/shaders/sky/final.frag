@@ -17,12 +17,7 @@ out vec4 frag_col;
 uniform sampler2D transLUT;
 uniform sampler2D skyLUT;
 
-uniform vec3 uSunDir;
-
-uniform vec3 uBotLeft;
-uniform vec3 uBotRight;
-uniform vec3 uTopLeft;
-uniform vec3 uTopRight;
+#include "../frame.glsl"
 
 uniform float uSkyBrightness;
 
@@ -33,7 +28,6 @@ uniform float uHeight;
 const float ground_rad = 6.360;
 const float atmosphere_rad = 6.460;
 
-
 float safeacos(float x);
 vec3 getValueFromLUT(sampler2D tex, vec3 pos, vec3 sunDir);
 
@@ -8,8 +8,9 @@ layout(rgba16, binding = 0) uniform imageCube prefilteredMap;
 
 uniform sampler2D skyLUT;
 
+#include "../frame.glsl"
+
 uniform int uResolution;
-uniform vec3 uSunDir;
 uniform float uSkyBrightness;
 uniform float uIBLOversaturation;
 
@@ -9,20 +9,13 @@ uniform sampler2D multiLUT;
 
 #include "common.glsl"
 
-uniform float uHeight;
+#include "../frame.glsl"
 
-uniform vec3 uSunDir;
+uniform float uHeight;
 
 uniform float uFar;
 uniform float uNear;
 
-uniform vec3 uFront;
-
-uniform vec3 uBotLeft;
-uniform vec3 uBotRight;
-uniform vec3 uTopLeft;
-uniform vec3 uTopRight;
-
 uniform float uDistScale;
 
 //uniform vec3 uGroundAlbedo;
@@ -68,7 +61,7 @@ void main() {
     //uNear/uFar are along z axis, so we need to project onto the ray
     //We also change units to megameters
     //And we also consider distance scale parameter
-    float proj = 1.0/dot(uFront, dir);
+    float proj = 1.0/dot(uCameraFront, dir);
 
     float t0    =            proj*0.000001*uNear;
     float t_end = uDistScale*proj*0.000001*uFar;
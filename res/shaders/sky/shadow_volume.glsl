@@ -6,22 +6,12 @@ layout(r16f, binding = 1) uniform image3D shadowVolume;
 
 uniform sampler2D shadowmap;
 
-uniform vec3 uPos;
-uniform vec3 uSunDir;
+#include "../frame.glsl"
 
 uniform float uFar;
 uniform float uNear;
 
-uniform vec3 uFront;
-
-uniform vec3 uBotLeft;
-uniform vec3 uBotRight;
-uniform vec3 uTopLeft;
-uniform vec3 uTopRight;
-
 uniform float uL;
-uniform float uScaleY;
-uniform float uScaleXZ;
 
 vec2 getShadowUV(vec3 pos)
 {
@@ -49,14 +39,14 @@ void main() {
     dir = normalize(dir);
 
     //Calculate world position
-    float proj = 1.0/dot(uFront, dir);
+    float proj = 1.0/dot(uCameraFront, dir);
 
     float t0    = proj*uNear;
     float t_end = proj*uFar;
 
     float tf = t0 + coord.z*(t_end-t0);
 
-    vec3 pos = uPos + tf*dir;
+    vec3 pos = uCameraPos + tf*dir;
 
     //Sample shadow map
     #define MULTISAMPLE
@@ -84,7 +74,7 @@ void main() {
 
     //Debug shadowmap visualization
     //float t_meters = 1000000*tf/(uDistScale);
-    //vec3 pos = vec3(1,1,1)*uPos + t_meters*dir;
+    //vec3 pos = vec3(1,1,1)*uCameraPos + t_meters*dir;
     //vec2 shadow_uv = (4.0/2.0)*vec2(pos.x, pos.z)/400.0;
     //shadow_uv = 0.5*shadow_uv + 0.5;
     //float shadow = texture(shadowmap, shadow_uv).r;
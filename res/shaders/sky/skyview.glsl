@@ -14,7 +14,7 @@ layout(rgba16, binding = 0) uniform image2D skyLUT;
 uniform sampler2D transLUT;
 uniform sampler2D multiLUT;
 
-uniform vec3 uSunDir;
+#include "../frame.glsl"
 
 uniform float uHeight;
 
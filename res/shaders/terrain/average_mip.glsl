@@ -0,0 +1,28 @@
+#version 450 core
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+//Lower res mip, written only, so format is taken from the bound image
+layout(binding = 0) writeonly uniform image2D target;
+
+//Higher res mip, read through a sampler so that any format works
+layout(binding = 1) uniform sampler2D source;
+uniform int uSourceLevel;
+
+//Region is given in texels of the lower res mip (the one written to)
+#include "region.glsl"
+
+void main() {
+    if (!inRegion())
+        return;
+
+    ivec2 texelCoord = getRegionTexel();
+
+    //Same 2x2 box filter as glGenerateMipmap for power of two sizes
+    vec4 sum = texelFetch(source, 2*texelCoord + ivec2(0,0), uSourceLevel);
+    sum += texelFetch(source, 2*texelCoord + ivec2(1,0), uSourceLevel);
+    sum += texelFetch(source, 2*texelCoord + ivec2(0,1), uSourceLevel);
+    sum += texelFetch(source, 2*texelCoord + ivec2(1,1), uSourceLevel);
+
+    imageStore(target, texelCoord, 0.25 * sum);
+}
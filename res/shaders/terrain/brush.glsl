@@ -0,0 +1,95 @@
+#version 450 core
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+//Sculpt layer holds offsets added on top of the procedural heightmap
+layout(r32f, binding = 0) uniform image2D sculpt;
+
+#include "region.glsl"
+
+//Final heightmap of the last update (procedures + sculpt layer)
+uniform sampler2D heightmap;
+
+//Brush center and radius in uv
+uniform vec2 uCenter;
+uniform float uRadius;
+
+//Already scaled by the frame time
+uniform float uStrength;
+
+//Height flattened to, picked at the beginning of the stroke
+uniform float uTarget;
+
+uniform int uMode;
+
+#define BRUSH_RAISE   0
+#define BRUSH_LOWER   1
+#define BRUSH_SMOOTH  2
+#define BRUSH_FLATTEN 3
+#define BRUSH_ERODE   4
+
+//Slope (height difference per texel) that erosion doesn't go below
+const float talus = 0.0005;
+
+float getHeight(ivec2 texel) {
+    ivec2 size = textureSize(heightmap, 0);
+    return texelFetch(heightmap, clamp(texel, ivec2(0), size - 1), 0).r;
+}
+
+void main() {
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+    vec2 uv = getRegionUV(texel);
+
+    float dist = length(uv - uCenter) / uRadius;
+
+    if (dist >= 1.0)
+        return;
+
+    float falloff = 1.0 - smoothstep(0.0, 1.0, dist);
+
+    float h = getHeight(texel);
+    float offset = imageLoad(sculpt, texel).r;
+
+    //Modes moving towards some height never overshoot it
+    float k = clamp(uStrength * falloff, 0.0, 1.0);
+
+    switch(uMode) {
+        case BRUSH_RAISE:
+        {
+            offset += uStrength * falloff;
+            break;
+        }
+        case BRUSH_LOWER:
+        {
+            offset -= uStrength * falloff;
+            break;
+        }
+        case BRUSH_SMOOTH:
+        {
+            float avg = 0.25 * (getHeight(texel + ivec2(1, 0)) + getHeight(texel - ivec2(1, 0))
+                              + getHeight(texel + ivec2(0, 1)) + getHeight(texel - ivec2(0, 1)));
+
+            offset += k * (avg - h);
+            break;
+        }
+        case BRUSH_FLATTEN:
+        {
+            offset += k * (uTarget - h);
+            break;
+        }
+        case BRUSH_ERODE:
+        {
+            //Thermal erosion, material slides off slopes steeper than talus
+            float lowest = min(min(getHeight(texel + ivec2(1, 0)), getHeight(texel - ivec2(1, 0))),
+                               min(getHeight(texel + ivec2(0, 1)), getHeight(texel - ivec2(0, 1))));
+
+            offset -= 0.5 * k * max(h - lowest - talus, 0.0);
+            break;
+        }
+    }
+
+    imageStore(sculpt, texel, vec4(offset));
+}
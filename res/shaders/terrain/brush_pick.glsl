@@ -0,0 +1,74 @@
+#version 450 core
+
+//Finds the point of the terrain hit by a ray (center of the screen when sculpting)
+
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, binding = 0) writeonly buffer pickBuffer
+{
+    //uv, height in [0,1] range, 1.0 if anything was hit
+    vec4 result;
+};
+
+uniform sampler2D heightmap;
+
+uniform float uScaleXZ;
+uniform float uScaleY;
+
+uniform vec3 uOrigin;
+uniform vec3 uDir;
+uniform float uMaxDist;
+
+//Same scaling as in displace.glsl
+float getHeight(vec3 p) {
+    vec2 uv = p.xz / uScaleXZ + 0.5;
+    return 0.5 * uScaleY * textureLod(heightmap, uv, 0.0).r;
+}
+
+void main() {
+    const int steps = 512;
+    const int refine_steps = 8;
+
+    float t_prev = 0.0;
+    float t = 0.0;
+    bool hit = false;
+
+    //Step length grows with distance, details far away don't matter
+    for (int i = 0; i < steps; i++) {
+        float dt = max(0.01, 0.01 * t);
+
+        t_prev = t;
+        t += dt;
+
+        if (t > uMaxDist)
+            break;
+
+        vec3 p = uOrigin + t * uDir;
+
+        if (p.y <= getHeight(p)) {
+            hit = true;
+            break;
+        }
+    }
+
+    if (!hit) {
+        result = vec4(0.0);
+        return;
+    }
+
+    //Bisection between the last point above and the first point below the terrain
+    for (int i = 0; i < refine_steps; i++) {
+        float t_mid = 0.5 * (t_prev + t);
+        vec3 p = uOrigin + t_mid * uDir;
+
+        if (p.y <= getHeight(p))
+            t = t_mid;
+        else
+            t_prev = t_mid;
+    }
+
+    vec3 p = uOrigin + t * uDir;
+    vec2 uv = p.xz / uScaleXZ + 0.5;
+
+    result = vec4(uv, textureLod(heightmap, uv, 0.0).r, 1.0);
+}
@@ -1,15 +1,9 @@
 #version 450 core
 
-layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
-
-layout(r32f, binding = 0) uniform image2D heightmap;
+#include "procedure.glsl"
 
 uniform float uValue;
 
-void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
-
-    vec4 res = vec4(uValue, vec3(0.0));
-
-    imageStore(heightmap, texelCoord, res);
+float procedure(float prev, vec2 uv) {
+    return uValue;
 }
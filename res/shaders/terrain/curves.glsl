@@ -1,17 +1,9 @@
 #version 450 core
 
-layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
-
-layout(r32f, binding = 0) uniform image2D heightmap;
+#include "procedure.glsl"
 
 uniform float uExponent;
 
-void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
-
-    float height = float(imageLoad(heightmap, texelCoord));
-
-    height = pow(height, uExponent);
-
-    imageStore(heightmap, texelCoord, vec4(height));
-}
\ No newline at end of file
+float procedure(float prev, vec2 uv) {
+    return pow(prev, uExponent);
+}
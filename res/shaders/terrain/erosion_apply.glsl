@@ -0,0 +1,47 @@
+#version 450 core
+
+//Adds the upsampled height change of the simulation to the input heightmap
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(r32f, binding = 0) uniform image2D heightmap;
+layout(r32f, binding = 1) uniform image2D inputCopy;
+layout(rgba32f, binding = 2) uniform image2D state;
+
+#include "region.glsl"
+#include "erosion_common.glsl"
+
+uniform int uResolution;
+uniform float uHeightScale;
+
+float changeAt(ivec2 texel) {
+    vec4 s = imageLoad(state, wrapTexel(texel));
+
+    //Sediment still carried by water settles in place
+    return s.x + s.z - s.w;
+}
+
+void main() {
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+
+    //Texel centers of both grids are aligned
+    vec2 pos = (vec2(texel) + 0.5) * (float(uSimResolution) / float(uResolution)) - 0.5;
+
+    vec2 base = floor(pos);
+    vec2 t = pos - base;
+    ivec2 i0 = ivec2(base);
+
+    float c00 = changeAt(i0);
+    float c10 = changeAt(i0 + ivec2(1, 0));
+    float c01 = changeAt(i0 + ivec2(0, 1));
+    float c11 = changeAt(i0 + ivec2(1, 1));
+
+    float change = mix(mix(c00, c10, t.x), mix(c01, c11, t.x), t.y);
+
+    float h = imageLoad(inputCopy, texel).r + change / uHeightScale;
+
+    imageStore(heightmap, texel, vec4(h));
+}
@@ -0,0 +1,35 @@
+//Shared by the erosion passes (see Erosion.h), mirrored by ErodeReference.
+//Simulation grid has unit spacing, flux channels are stored in the order of NEIGHBOURS.
+
+uniform int uSimResolution;
+uniform int uTiling;
+
+const float DT = 0.05;
+const float G = 9.81;
+
+//Left, right, down, up - opposite of neighbour i is i^1
+const ivec2 NEIGHBOURS[4] = ivec2[](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+
+//Tiling maps wrap around, others are clamped at the border
+ivec2 wrapTexel(ivec2 texel) {
+    if (uTiling == 1)
+        return ((texel % uSimResolution) + uSimResolution) % uSimResolution;
+
+    return clamp(texel, ivec2(0), ivec2(uSimResolution - 1));
+}
+
+//Returns false if the neighbour lies outside of a non tiling map
+bool getNeighbour(ivec2 texel, int i, out ivec2 neighbour) {
+    neighbour = texel + NEIGHBOURS[i];
+
+    if (uTiling == 1) {
+        neighbour = wrapTexel(neighbour);
+        return true;
+    }
+
+    return all(greaterThanEqual(neighbour, ivec2(0))) && all(lessThan(neighbour, ivec2(uSimResolution)));
+}
+
+bool inSimulation() {
+    return all(lessThan(gl_GlobalInvocationID.xy, uvec2(uSimResolution)));
+}
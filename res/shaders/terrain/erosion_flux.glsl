@@ -0,0 +1,50 @@
+#version 450 core
+
+//Outflow through virtual pipes to the four neighbours, driven by differences of water surface height
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(rgba32f, binding = 1) uniform image2D stateIn;
+layout(rgba32f, binding = 3) uniform image2D fluxIn;
+layout(rgba32f, binding = 4) uniform image2D fluxOut;
+
+#include "erosion_common.glsl"
+
+uniform float uRain;
+
+void main() {
+    if (!inSimulation())
+        return;
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    vec4 s = imageLoad(stateIn, texel);
+    vec4 f = imageLoad(fluxIn, texel);
+
+    float water = s.y + uRain;
+    float surface = s.x + water;
+
+    for (int i = 0; i < 4; i++) {
+        ivec2 n;
+
+        if (getNeighbour(texel, i, n)) {
+            vec4 sn = imageLoad(stateIn, n);
+            float dh = surface - (sn.x + sn.y + uRain);
+
+            f[i] = max(0.0, f[i] + DT * G * dh);
+        }
+
+        //Closed border
+        else {
+            f[i] = 0.0;
+        }
+    }
+
+    //Outflow can't exceed the water in the texel
+    float total = f.x + f.y + f.z + f.w;
+
+    if (total > 0.0)
+        f *= min(1.0, water / (total * DT));
+
+    imageStore(fluxOut, texel, f);
+}
@@ -0,0 +1,40 @@
+#version 450 core
+
+//Downsamples the heightmap into the simulation state and keeps a full resolution copy of it
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(r32f, binding = 0) uniform image2D heightmap;
+layout(r32f, binding = 1) uniform image2D inputCopy;
+layout(rgba32f, binding = 2) uniform image2D state;
+
+#include "erosion_common.glsl"
+
+uniform int uResolution;
+//Simulation height of heightmap value 1.0
+uniform float uHeightScale;
+
+void main() {
+    if (!inSimulation())
+        return;
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    int k = uResolution / uSimResolution;
+
+    float sum = 0.0;
+
+    for (int j = 0; j < k; j++) {
+        for (int i = 0; i < k; i++) {
+            ivec2 coord = k * texel + ivec2(i, j);
+
+            float h = imageLoad(heightmap, coord).r;
+            imageStore(inputCopy, coord, vec4(h));
+
+            sum += h;
+        }
+    }
+
+    float b = uHeightScale * sum / float(k * k);
+
+    imageStore(state, texel, vec4(b, 0.0, 0.0, b));
+}
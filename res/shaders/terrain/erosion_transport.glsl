@@ -0,0 +1,65 @@
+#version 450 core
+
+//Semi-lagrangian sediment advection, evaporation and thermal erosion
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(rgba32f, binding = 1) uniform image2D stateIn;
+layout(rgba32f, binding = 2) uniform image2D stateOut;
+layout(rg32f, binding = 5) uniform image2D velocity;
+
+#include "erosion_common.glsl"
+
+uniform float uEvaporation;
+uniform float uTalus;
+uniform float uThermal;
+
+float sedimentAt(ivec2 texel) {
+    return imageLoad(stateIn, wrapTexel(texel)).z;
+}
+
+//Bilinear interpolation done by hand, so it matches the cpu reference
+float sampleSediment(vec2 pos) {
+    vec2 base = floor(pos);
+    vec2 t = pos - base;
+    ivec2 i0 = ivec2(base);
+
+    float s00 = sedimentAt(i0);
+    float s10 = sedimentAt(i0 + ivec2(1, 0));
+    float s01 = sedimentAt(i0 + ivec2(0, 1));
+    float s11 = sedimentAt(i0 + ivec2(1, 1));
+
+    return mix(mix(s00, s10, t.x), mix(s01, s11, t.x), t.y);
+}
+
+void main() {
+    if (!inSimulation())
+        return;
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    vec4 s = imageLoad(stateIn, texel);
+    vec2 v = imageLoad(velocity, texel).xy;
+
+    float sediment = sampleSediment(vec2(texel) - DT * v);
+    float water = s.y * (1.0 - uEvaporation * DT);
+
+    //Exchange with each neighbour is computed the same way on both sides, so material is conserved
+    float delta = 0.0;
+
+    for (int i = 0; i < 4; i++) {
+        ivec2 n;
+
+        if (getNeighbour(texel, i, n)) {
+            float diff = imageLoad(stateIn, n).x - s.x;
+            float excess = abs(diff) - uTalus;
+
+            if (excess > 0.0)
+                delta += sign(diff) * excess;
+        }
+    }
+
+    float b = s.x + 0.125 * uThermal * delta;
+
+    imageStore(stateOut, texel, vec4(b, water, sediment, s.w));
+}
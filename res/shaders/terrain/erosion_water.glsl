@@ -0,0 +1,74 @@
+#version 450 core
+
+//Updates water depth from the fluxes, computes velocity and erodes/deposits sediment
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(rgba32f, binding = 1) uniform image2D stateIn;
+layout(rgba32f, binding = 2) uniform image2D stateOut;
+layout(rgba32f, binding = 3) uniform image2D flux;
+layout(rg32f, binding = 5) uniform image2D velocity;
+
+#include "erosion_common.glsl"
+
+uniform float uRain;
+uniform float uCapacity;
+uniform float uErosion;
+uniform float uDeposition;
+
+void main() {
+    if (!inSimulation())
+        return;
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    vec4 s = imageLoad(stateIn, texel);
+    vec4 f = imageLoad(flux, texel);
+
+    //Inflow from each neighbour and terrain heights of neighbours (own height outside of the map)
+    vec4 fin = vec4(0.0);
+    vec4 bn = vec4(s.x);
+
+    for (int i = 0; i < 4; i++) {
+        ivec2 n;
+
+        if (getNeighbour(texel, i, n)) {
+            fin[i] = imageLoad(flux, n)[i ^ 1];
+            bn[i] = imageLoad(stateIn, n).x;
+        }
+    }
+
+    float d1 = s.y + uRain;
+    float d2 = max(0.0, d1 + DT * ((fin.x + fin.y + fin.z + fin.w) - (f.x + f.y + f.z + f.w)));
+
+    //Water passing through the texel along x and y
+    vec2 w = 0.5 * vec2(fin.x - f.x + f.y - fin.y, fin.z - f.z + f.w - fin.w);
+    float depth = 0.5 * (d1 + d2);
+
+    vec2 v = (depth > 1e-4) ? w / depth : vec2(0.0);
+
+    //Sine of the local tilt angle, bounded below so flat areas still carry some sediment
+    vec2 grad = 0.5 * vec2(bn.y - bn.x, bn.w - bn.z);
+    float g2 = dot(grad, grad);
+    float sin_tilt = max(sqrt(g2 / (1.0 + g2)), 0.05);
+
+    //Thin films of water carry less, velocity is unreliable there anyway
+    float capacity = uCapacity * sin_tilt * length(v) * min(d2, 1.0);
+
+    float b = s.x, sediment = s.z;
+
+    if (capacity > sediment) {
+        float amount = uErosion * (capacity - sediment);
+        b -= amount;
+        sediment += amount;
+    }
+
+    else {
+        float amount = uDeposition * (sediment - capacity);
+        b += amount;
+        sediment -= amount;
+    }
+
+    imageStore(stateOut, texel, vec4(b, d2, sediment, s.w));
+    imageStore(velocity, texel, vec4(v, 0.0, 0.0));
+}
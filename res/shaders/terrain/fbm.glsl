@@ -1,8 +1,6 @@
 #version 450 core
 
-layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
-
-layout(r32f, binding = 0) uniform image2D heightmap;
+#include "procedure.glsl"
 
 uniform int uOctaves;
 uniform float uScale;
@@ -75,12 +73,7 @@ float fbm(in vec2 p, int octaves) {
     return scale_y * res;
 }
 
-void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
-
-    float prev = float(imageLoad(heightmap, texelCoord));
-
-    vec2 uv = vec2(texelCoord)/imageSize(heightmap);
+float procedure(float prev, vec2 uv) {
     vec2 ts = uScale*uv;
 
     float h = fbm(ts, uOctaves);
@@ -103,5 +96,5 @@ void main() {
         }
     }
 
-    imageStore(heightmap, texelCoord, vec4(h));
+    return h;
 }
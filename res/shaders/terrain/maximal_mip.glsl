@@ -7,8 +7,14 @@ layout(r32f, binding = 0) uniform image2D heightmap;
 //Lower mip means higher res
 layout(r32f, binding = 1) uniform image2D lower_mip; 
 
+//Region is given in texels of the higher mip (the one written to)
+#include "region.glsl"
+
 void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (!inRegion())
+        return;
+
+    ivec2 texelCoord = getRegionTexel();
 
     float h =  imageLoad(lower_mip, 2*texelCoord + ivec2(0,0)).r;
     h = max(h, imageLoad(lower_mip, 2*texelCoord + ivec2(1,0)).r);
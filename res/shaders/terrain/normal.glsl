@@ -7,6 +7,8 @@ layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 
 layout(rgba8, binding = 0) uniform image2D normalmap;
 
+#include "region.glsl"
+
 uniform sampler2D heightmap;
 
 uniform float uScaleXZ;
@@ -57,9 +59,14 @@ float getAO(vec2 p) {
 }
 
 void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+    ivec2 texelCoord = getStorageTexel(texel, imageSize(normalmap));
 
-    vec2 uv = vec2(texelCoord)/imageSize(normalmap);
+    //Outside of [0,1] only for regions wrapping around tiling maps
+    vec2 uv = getRegionUV(texel);
     
     float ao = getAO(uv);
     vec3 norm = 0.5*getNorm(uv) + 0.5;
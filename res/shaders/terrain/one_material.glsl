@@ -4,10 +4,16 @@ layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 
 layout(rgba8, binding = 0) uniform image2D materialmap;
 
+#include "region.glsl"
+
 uniform int uID;
 
 void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+    ivec2 texelCoord = getStorageTexel(texel, imageSize(materialmap));
 
     vec4 res = vec4(0.0); //This is already case 4
 
@@ -0,0 +1,27 @@
+//Common part of the heightmap procedures. Each procedure includes this file and then defines
+//    float procedure(float prev, vec2 uv)
+//returning the new height from the previous one. For fused dispatches (see FusedProcedures.h)
+//everything after the include is copied into a single kernel, with identifiers suffixed
+//per instance and uniforms moved to a uniform block. So after the include procedures should
+//only declare plain (non opaque) uniforms, defines and functions.
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(r32f, binding = 0) uniform image2D heightmap;
+
+#include "region.glsl"
+
+float procedure(float prev, vec2 uv);
+
+void main() {
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+    ivec2 texelCoord = getStorageTexel(texel, imageSize(heightmap));
+
+    float prev = imageLoad(heightmap, texelCoord).r;
+    float height = procedure(prev, getRegionUV(texel));
+
+    imageStore(heightmap, texelCoord, vec4(height));
+}
@@ -0,0 +1,28 @@
+//Region of the heightmap updated by a single dispatch (see DispatchRegion).
+//Texel coordinates are global, with toroidal addressing texel p is stored at p mod imageSize.
+//Uv is in map units, the fixed heightmap spans [0,1]^2.
+
+uniform ivec2 uRegionOffset;
+uniform ivec2 uRegionSize;
+uniform float uTexelSize;
+uniform int uToroidal;
+
+//Dispatch is rounded up to the local size
+bool inRegion() {
+    return all(lessThan(gl_GlobalInvocationID.xy, uvec2(uRegionSize)));
+}
+
+ivec2 getRegionTexel() {
+    return uRegionOffset + ivec2(gl_GlobalInvocationID.xy);
+}
+
+ivec2 getStorageTexel(ivec2 texel, ivec2 size) {
+    if (uToroidal == 1)
+        return ((texel % size) + size) % size;
+
+    return texel;
+}
+
+vec2 getRegionUV(ivec2 texel) {
+    return vec2(texel) * uTexelSize;
+}
@@ -0,0 +1,19 @@
+#version 450 core
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(r32f, binding = 0) uniform image2D heightmap;
+layout(r32f, binding = 1) uniform image2D sculpt;
+
+#include "region.glsl"
+
+void main() {
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+
+    float height = imageLoad(heightmap, texel).r + imageLoad(sculpt, texel).r;
+
+    imageStore(heightmap, texel, vec4(height));
+}
@@ -4,6 +4,8 @@ layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 
 layout(rgba8, binding = 0) uniform image2D materialmap;
 
+#include "region.glsl"
+
 uniform sampler2D heightmap;
 
 uniform float uSlopeUpper;
@@ -28,10 +30,14 @@ vec3 getNorm(vec2 uv) {
 #define SUM_COMPONENTS(v) (v.x + v.y + v.z + v.w)
 
 void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (!inRegion())
+        return;
+
+    ivec2 texel = getRegionTexel();
+    ivec2 texelCoord = getStorageTexel(texel, imageSize(materialmap));
 
     //Slope
-    vec2 uv = vec2(texelCoord)/imageSize(materialmap);
+    vec2 uv = getRegionUV(texel);
     vec3 norm = getNorm(uv);
     float slope = 1.0 - norm.y;
 
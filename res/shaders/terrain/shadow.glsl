@@ -10,6 +10,8 @@ layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 
 layout(r8, binding = 0) uniform image2D shadowmap;
 
+#include "region.glsl"
+
 uniform int uResolution;
 
 uniform sampler2D heightmap;
@@ -81,7 +83,10 @@ bool IntersectTerrain(vec2 org2, vec2 dir2, vec3 org3, vec3 dir3,
 }
 
 void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
+    if (!inRegion())
+        return;
+
+    ivec2 texelCoord = getRegionTexel();
     
     //Not normalized (from 0 to uResolution)
     vec2 uv = vec2(texelCoord);
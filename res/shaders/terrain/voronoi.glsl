@@ -1,8 +1,6 @@
 #version 450 core
 
-layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
-
-layout(r32f, binding = 0) uniform image2D heightmap;
+#include "procedure.glsl"
 
 uniform float uScale;
 uniform float uRandomness;
@@ -64,13 +62,7 @@ vec2 voronoi(vec2 x){
     return sqrt(res);
 }
 
-void main() {
-    ivec2 texelCoord = ivec2(gl_GlobalInvocationID.xy);
-
-    float prev = float(imageLoad(heightmap, texelCoord));
-
-    vec2 uv = vec2(texelCoord)/imageSize(heightmap);
-
+float procedure(float prev, vec2 uv) {
     vec2 voro = voronoi(uScale*uv);
     float h = 0.0;
 
@@ -110,7 +102,5 @@ void main() {
         }
     }
 
-    vec4 res = vec4(h, vec3(0.0));
-
-    imageStore(heightmap, texelCoord, res);
+    return h;
 }
@@ -1,16 +1,18 @@
 #version 450 core
 
-layout (location = 0) in vec4 aPos;
-
-uniform float uL;
-uniform mat4 uMVP;
-
-uniform vec2 uPos;
+#include "clipmap.glsl"
 
 uniform sampler2D tex;
 
 void main() {
-    vec2 hoffset = uPos - mod(uPos, aPos.w);
+    vec4 vertex = getClipmapVertex();
+
+    vec2 hoffset = uCameraPos.xz - mod(uCameraPos.xz, vertex.w);
+
+    vec2 uv = (2.0/uScaleXZ) * (vertex.xz + hoffset);
+    uv = 0.5*uv + 0.5;
+
+    vertex.y = getClipmapHeight(vertex, uv);
     
-    gl_Position = uMVP * vec4(aPos.xyz + vec3(hoffset.x, 0.0, hoffset.y), 1.0);
+    gl_Position = uViewProj * vec4(vertex.xyz + vec3(hoffset.x, 0.0, hoffset.y), 1.0);
 }
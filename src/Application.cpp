@@ -15,9 +15,10 @@
 #include "glad/glad.h"
 
 #include <iostream>
+#include <chrono>
 
-Application::Application(const std::string& title, unsigned int width, unsigned int height) 
-    : m_Window(title, width, height), m_Renderer(width, height) 
+Application::Application(const std::string& title, unsigned int width, unsigned int height, bool headless) 
+    : m_Window(title, width, height, !headless), m_Renderer(width, height) 
 {
     //Initialize ImGui:
     IMGUI_CHECKVERSION();
@@ -58,6 +59,9 @@ Application::Application(const std::string& title, unsigned int width, unsigned
 }
 
 Application::~Application() {
+    //Makes sure the trace file is properly terminated
+    Profiler::StopCapture();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -70,7 +74,7 @@ void Application::StartFrame() {
 }
 
 void Application::EndFrame() {
-    ProfilerCPUEvent we("Application::EndFrame");
+    LOFI_PROFILE_CPU("Application::EndFrame");
 
     ImGuiIO& io = ImGui::GetIO();
     io.DisplaySize = ImVec2(m_Window.getWidth(), m_Window.getHeight());
@@ -111,18 +115,33 @@ void Application::StartMenu() {
         m_StartSettings.MaterialRes = std::exp2(std::round(std::log2(m_StartSettings.MaterialRes)));
 
         //-----World type selection----------------------
-        std::vector<std::string> options{"finite", "tiling"};
+        std::vector<std::string> options{"finite", "tiling", "unbounded"};
 
-        static int selected_id = 1;
+        static int selected_id = m_StartSettings.Unbounded ? 2
+                               : (m_StartSettings.WrapType == GL_CLAMP_TO_BORDER) ? 0 : 1;
 
         ImGui::Columns(2, "###col");
         ImGuiUtils::ColCombo("World type", options, selected_id);
 
         if (selected_id == 0)
             m_StartSettings.WrapType = GL_CLAMP_TO_BORDER;
-        else if (selected_id == 1)
+        else
             m_StartSettings.WrapType = GL_REPEAT;
 
+        m_StartSettings.Unbounded = (selected_id == 2);
+
+        //-----Clipmap geometry selection----------------
+        std::vector<std::string> geometry_options{"displaced", "sampled", "instanced"};
+
+        int geometry_id = static_cast<int>(m_StartSettings.GeometryMode);
+
+        ImGuiUtils::ColCombo("Terrain geometry", geometry_options, geometry_id);
+
+        m_StartSettings.GeometryMode = static_cast<ClipmapMode>(geometry_id);
+
+        ImGuiUtils::ColCheckbox("Occlusion culling", &m_StartSettings.OcclusionCulling);
+        ImGuiUtils::ColCheckbox("Cpu heightmap", &m_StartSettings.CpuProcedures);
+
         ImGui::Columns(1, "###col");
         ImGui::EndChild();
 
@@ -163,6 +182,117 @@ void Application::Run() {
     }
 }
 
+void Application::RunBenchmark(const LaunchSettings& settings) {
+    if (!settings.WorldPath.empty())
+        m_Renderer.LoadWorld(settings.WorldPath);
+
+    if (settings.ValidateCpu) {
+        const float error = m_Renderer.ValidateCpuProcedures();
+
+        if (error < 0.0f)
+            throw std::runtime_error("Heightmap procedures of the world have no cpu implementation");
+
+        std::cout << "Cpu heightmap procedures, largest difference from gpu: " << error << '\n';
+
+        if (!(error <= settings.CpuTolerance))
+            throw std::runtime_error("Cpu heightmap procedures differ from gpu by more than " + std::to_string(settings.CpuTolerance));
+    }
+
+    CameraPath camera_path;
+
+    if (!settings.CameraPath.empty())
+        camera_path.Load(settings.CameraPath);
+
+    //Render to an offscreen target, so that results don't depend
+    //on the (hidden) window's default framebuffer
+    Texture2DSpec target_spec{
+        int(settings.Width), int(settings.Height), GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,
+        GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, {0.0f, 0.0f, 0.0f, 0.0f}
+    };
+
+    FramebufferTexture target;
+    target.Initialize(target_spec, true);
+
+    m_Renderer.OnWindowResize(settings.Width, settings.Height);
+
+    //Fixed timestep keeps runs reproducible regardless of frame times
+    const float deltatime = 1.0f / 60.0f;
+
+    const int total_frames = settings.WarmupFrames + settings.Frames;
+
+    //Timestamp pairs instead of GL_TIME_ELAPSED, since elapsed
+    //queries can't be nested with the ones issued by the profiler
+    std::vector<unsigned int> queries(2 * settings.Frames);
+    glGenQueries(queries.size(), queries.data());
+
+    std::vector<float> cpu_times;
+    cpu_times.reserve(settings.Frames);
+
+    for (int frame = 0; frame < total_frames; frame++) {
+        const int measured_id = frame - settings.WarmupFrames;
+        const bool measured = (measured_id >= 0);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+
+        if (measured)
+            glQueryCounter(queries[2 * measured_id], GL_TIMESTAMP);
+
+        Profiler::NextFrame();
+
+        //Stats of the warmup frames are discarded (apart from gpu
+        //frames still in flight, which land in the first measured ones)
+        if (measured_id == 0)
+            Profiler::ResetStats();
+
+        if (!camera_path.Empty()) {
+            const CameraKey key = camera_path.Sample(float(frame));
+            m_Renderer.SetCameraPose(key.Pos, key.Yaw, key.Pitch);
+        }
+
+        m_Renderer.OnUpdate(deltatime);
+
+        target.BindFBO();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        m_Renderer.OnRender();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        Profiler::SwapBuffers();
+
+        if (measured)
+            glQueryCounter(queries[2 * measured_id + 1], GL_TIMESTAMP);
+
+        //No swap buffers, so commands need to be flushed manually
+        glFlush();
+
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        if (measured)
+            cpu_times.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+
+        glfwPollEvents();
+    }
+
+    glFinish();
+
+    std::vector<float> gpu_times;
+    gpu_times.reserve(settings.Frames);
+
+    for (int i = 0; i < settings.Frames; i++) {
+        GLuint64 begin_ns, end_ns;
+        glGetQueryObjectui64v(queries[2 * i], GL_QUERY_RESULT, &begin_ns);
+        glGetQueryObjectui64v(queries[2 * i + 1], GL_QUERY_RESULT, &end_ns);
+
+        gpu_times.push_back(1e-6f * float(end_ns - begin_ns));
+    }
+
+    glDeleteQueries(queries.size(), queries.data());
+
+    WriteBenchmarkResults(settings.OutputPath, cpu_times, gpu_times);
+    Profiler::WriteStats(settings.StatsPath);
+}
+
 void Application::OnEvent(Event& e) {
    EventType type = e.getEventType();
 
@@ -216,6 +346,12 @@ void Application::OnEvent(Event& e) {
             m_Renderer.OnMousePressed(ptr->getButton(), ptr->getMods());
             break;
         }
+        case EventType::MouseReleased:
+        {
+            MouseReleasedEvent* ptr = dynamic_cast<MouseReleasedEvent*>(&e);
+            m_Renderer.OnMouseReleased(ptr->getButton(), ptr->getMods());
+            break;
+        }
    }
 }
 
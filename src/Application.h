@@ -3,16 +3,23 @@
 #include "Window.h"
 #include "Renderer.h"
 #include "Timer.h"
+#include "Benchmark.h"
 
 class Application{
 public:
-    Application(const std::string& title, unsigned int width, unsigned int height);
+    Application(const std::string& title, unsigned int width, unsigned int height, bool headless = false);
     ~Application();
 
     void StartMenu();
     void Init();
     void Run();
 
+    //Renders scripted frames offscreen, writes timings and returns.
+    //Requires Init to be called first.
+    void RunBenchmark(const LaunchSettings& settings);
+
+    void setStartSettings(const Renderer::StartSettings& settings) { m_StartSettings = settings; }
+
     void OnEvent(Event& e);
 private:
     void StartFrame();
@@ -0,0 +1,327 @@
+#include "Benchmark.h"
+
+#include "glad/glad.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+
+LaunchSettings ParseCommandLine(int argc, char** argv)
+{
+    LaunchSettings settings;
+
+    auto NextValue = [argc, argv](int& i) -> std::string
+    {
+        if (i + 1 >= argc)
+            throw std::runtime_error(std::string("Missing value for argument: ") + argv[i]);
+
+        return argv[++i];
+    };
+
+    auto NextInt = [argv, &NextValue](int& i) -> int
+    {
+        const std::string arg = argv[i];
+        const std::string value = NextValue(i);
+
+        try
+        {
+            return std::stoi(value);
+        }
+
+        catch (const std::exception&)
+        {
+            throw std::runtime_error("Invalid integer value for " + arg + ": " + value);
+        }
+    };
+
+    //Unsigned settings would silently wrap negative values
+    auto NextPositiveInt = [argv, &NextInt](int& i) -> int
+    {
+        const std::string arg = argv[i];
+        const int value = NextInt(i);
+
+        if (value <= 0)
+            throw std::runtime_error("Value of " + arg + " must be positive: " + std::to_string(value));
+
+        return value;
+    };
+
+    auto NextFloat = [argv, &NextValue](int& i) -> float
+    {
+        const std::string arg = argv[i];
+        const std::string value = NextValue(i);
+
+        try
+        {
+            return std::stof(value);
+        }
+
+        catch (const std::exception&)
+        {
+            throw std::runtime_error("Invalid float value for " + arg + ": " + value);
+        }
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help")
+            settings.ShowHelp = true;
+
+        else if (arg == "--headless")
+            settings.Headless = true;
+
+        else if (arg == "--world")
+            settings.WorldPath = NextValue(i);
+
+        else if (arg == "--camera")
+            settings.CameraPath = NextValue(i);
+
+        else if (arg == "--output")
+            settings.OutputPath = NextValue(i);
+
+        else if (arg == "--stats")
+            settings.StatsPath = NextValue(i);
+
+        else if (arg == "--trace")
+            settings.TracePath = NextValue(i);
+
+        else if (arg == "--shader-cache")
+            settings.ShaderCachePath = NextValue(i);
+
+        else if (arg == "--no-shader-cache")
+            settings.ShaderCachePath.clear();
+
+        else if (arg == "--shaders-from-disk")
+            settings.ShadersFromDisk = true;
+
+        else if (arg == "--frames")
+            settings.Frames = NextInt(i);
+
+        else if (arg == "--warmup")
+            settings.WarmupFrames = NextInt(i);
+
+        else if (arg == "--width")
+            settings.Width = NextPositiveInt(i);
+
+        else if (arg == "--height")
+            settings.Height = NextPositiveInt(i);
+
+        else if (arg == "--subdivisions")
+            settings.Start.Subdivisions = NextInt(i);
+
+        else if (arg == "--lod-levels")
+            settings.Start.LodLevels = NextInt(i);
+
+        else if (arg == "--height-res")
+            settings.Start.HeightRes = NextInt(i);
+
+        else if (arg == "--shadow-res")
+            settings.Start.ShadowRes = NextInt(i);
+
+        else if (arg == "--material-res")
+            settings.Start.MaterialRes = NextInt(i);
+
+        else if (arg == "--wrap")
+        {
+            const std::string value = NextValue(i);
+
+            settings.Start.Unbounded = false;
+
+            if (value == "finite")
+                settings.Start.WrapType = GL_CLAMP_TO_BORDER;
+            else if (value == "tiling")
+                settings.Start.WrapType = GL_REPEAT;
+            else if (value == "unbounded")
+            {
+                settings.Start.WrapType = GL_REPEAT;
+                settings.Start.Unbounded = true;
+            }
+            else
+                throw std::runtime_error("Invalid world type: " + value + " (expected finite/tiling/unbounded)");
+        }
+
+        else if (arg == "--stack-res")
+            settings.Start.HeightStackRes = NextInt(i);
+
+        else if (arg == "--occlusion-culling")
+            settings.Start.OcclusionCulling = true;
+
+        else if (arg == "--cpu-procedures")
+            settings.Start.CpuProcedures = true;
+
+        else if (arg == "--validate-cpu")
+            settings.ValidateCpu = true;
+
+        else if (arg == "--cpu-tolerance")
+            settings.CpuTolerance = NextFloat(i);
+
+        else if (arg == "--geometry")
+        {
+            const std::string value = NextValue(i);
+
+            if (value == "displaced")
+                settings.Start.GeometryMode = ClipmapMode::Displaced;
+            else if (value == "sampled")
+                settings.Start.GeometryMode = ClipmapMode::Sampled;
+            else if (value == "instanced")
+                settings.Start.GeometryMode = ClipmapMode::Instanced;
+            else
+                throw std::runtime_error("Invalid geometry mode: " + value + " (expected displaced/sampled/instanced)");
+        }
+
+        else
+            throw std::runtime_error("Unknown argument: " + arg);
+    }
+
+    if (settings.Frames <= 0 || settings.WarmupFrames < 0)
+        throw std::runtime_error("Frame counts must be positive");
+
+    return settings;
+}
+
+void PrintUsage()
+{
+    std::cout
+        << "Usage: LofiLandscapes [options]\n"
+        << "\n"
+        << "Start settings (prefill the start menu in interactive mode):\n"
+        << "  --subdivisions <n>     Clipmap grid subdivisions\n"
+        << "  --lod-levels <n>       Clipmap lod levels\n"
+        << "  --height-res <n>       Heightmap resolution\n"
+        << "  --shadow-res <n>       Shadowmap resolution\n"
+        << "  --material-res <n>     Material resolution\n"
+        << "  --wrap <finite|tiling|unbounded>\n"
+        << "                         World type, unbounded generates heights around the camera\n"
+        << "  --stack-res <n>        Heightmap stack resolution (unbounded worlds)\n"
+        << "  --geometry <displaced|sampled|instanced>\n"
+        << "                         Clipmap geometry: per-grid buffers displaced by a compute pass,\n"
+        << "                         the same buffers sampling the heightmap in the vertex shader,\n"
+        << "                         or shared instanced grids sampling the heightmap\n"
+        << "  --occlusion-culling    Cull terrain grids hidden behind last frame's visible ones\n"
+        << "  --cpu-procedures       Generate the heightmap on the cpu\n"
+        << "\n"
+        << "Profiling:\n"
+        << "  --trace <file>         Capture all profiler events to a Chrome trace json file\n"
+        << "\n"
+        << "Shaders:\n"
+        << "  --shader-cache <dir>   Directory of cached program binaries (default shader_cache)\n"
+        << "  --no-shader-cache      Always compile shaders from source\n"
+        << "  --shaders-from-disk    Read shader sources from res/shaders instead of the executable\n"
+        << "\n"
+        << "Headless benchmark:\n"
+        << "  --headless             Render offscreen without the start menu and exit\n"
+        << "  --world <file>         World file to load (e.g. examples/Island.world)\n"
+        << "  --camera <file>        Camera path script (e.g. examples/Flyover.campath)\n"
+        << "  --frames <n>           Number of measured frames (default 300)\n"
+        << "  --warmup <n>           Number of frames rendered before measuring (default 0)\n"
+        << "  --width <n>            Render target width (default 1280)\n"
+        << "  --height <n>           Render target height (default 720)\n"
+        << "  --output <file>        Csv file with per-frame timings (default benchmark.csv)\n"
+        << "  --stats <file>         Csv file with per-scope profiler statistics (default benchmark_scopes.csv)\n"
+        << "  --validate-cpu         Compare cpu and gpu heightmap procedures of the world first,\n"
+        << "                         fail if they differ by more than the tolerance\n"
+        << "  --cpu-tolerance <x>    Tolerance of --validate-cpu (default 0.001)\n";
+}
+
+void CameraPath::Load(const std::string& filepath)
+{
+    std::ifstream input{ filepath };
+
+    if (!input)
+        throw std::runtime_error("Could not open camera path file:\n" + filepath);
+
+    m_Keys.clear();
+
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(input, line))
+    {
+        line_number++;
+
+        const auto first = line.find_first_not_of(" \t\r");
+
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        CameraKey key;
+
+        if (!(stream >> key.Frame >> key.Pos.x >> key.Pos.y >> key.Pos.z >> key.Yaw >> key.Pitch))
+        {
+            throw std::runtime_error(
+                "Malformed camera key in " + filepath + ", line " + std::to_string(line_number)
+            );
+        }
+
+        m_Keys.push_back(key);
+    }
+
+    std::stable_sort(m_Keys.begin(), m_Keys.end(),
+        [](const CameraKey& lhs, const CameraKey& rhs)
+        {
+            return lhs.Frame < rhs.Frame;
+        }
+    );
+}
+
+CameraKey CameraPath::Sample(float frame) const
+{
+    if (frame <= m_Keys.front().Frame)
+        return m_Keys.front();
+
+    if (frame >= m_Keys.back().Frame)
+        return m_Keys.back();
+
+    auto next = std::upper_bound(m_Keys.begin(), m_Keys.end(), frame,
+        [](float value, const CameraKey& key)
+        {
+            return value < key.Frame;
+        }
+    );
+
+    const CameraKey& b = *next;
+    const CameraKey& a = *(next - 1);
+
+    const float t = (frame - a.Frame) / (b.Frame - a.Frame);
+
+    auto Lerp = [t](auto x, auto y) { return x + t * (y - x); };
+
+    return CameraKey{
+        frame, Lerp(a.Pos, b.Pos), Lerp(a.Yaw, b.Yaw), Lerp(a.Pitch, b.Pitch)
+    };
+}
+
+void WriteBenchmarkResults(const std::string& filepath,
+                           const std::vector<float>& cpu_times,
+                           const std::vector<float>& gpu_times)
+{
+    std::ofstream output(filepath, std::ios::trunc);
+
+    if (!output)
+        throw std::runtime_error("Could not open benchmark output file:\n" + filepath);
+
+    output << "frame,cpu_ms,gpu_ms\n";
+
+    for (size_t i = 0; i < cpu_times.size(); i++)
+        output << i << ',' << cpu_times[i] << ',' << gpu_times[i] << '\n';
+
+    auto PrintSummary = [](const std::string& name, const std::vector<float>& times)
+    {
+        const auto [min, max] = std::minmax_element(times.begin(), times.end());
+        const float mean = std::accumulate(times.begin(), times.end(), 0.0f) / float(times.size());
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << name << " [ms]: mean " << mean
+                  << ", min " << *min << ", max " << *max << '\n';
+    };
+
+    std::cout << "Benchmark: " << cpu_times.size() << " frames, timings written to " << filepath << '\n';
+    PrintSummary("CPU", cpu_times);
+    PrintSummary("GPU", gpu_times);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Renderer.h"
+
+#include "glm/glm.hpp"
+
+#include <string>
+#include <vector>
+
+//Settings gathered from the command line. In interactive mode they only
+//prefill the start menu, with '--headless' the application renders
+//a fixed number of frames offscreen and writes out frame timings
+struct LaunchSettings {
+    bool Headless = false;
+    bool ShowHelp = false;
+
+    Renderer::StartSettings Start;
+
+    unsigned int Width = 1280, Height = 720;
+    int Frames = 300, WarmupFrames = 0;
+
+    std::string WorldPath, CameraPath;
+    std::string OutputPath = "benchmark.csv";
+
+    //Per scope profiler statistics of the measured frames
+    std::string StatsPath = "benchmark_scopes.csv";
+
+    //If not empty, profiler capture is started right after Init
+    std::string TracePath;
+
+    //Directory of the program binary cache, empty disables it
+    std::string ShaderCachePath = "shader_cache";
+
+    //Reads shader sources from res/shaders instead of the embedded ones (for editing shaders)
+    bool ShadersFromDisk = false;
+
+    //Compares cpu and gpu heightmap procedures before the benchmark,
+    //fails if they differ by more than the tolerance
+    bool ValidateCpu = false;
+    float CpuTolerance = 1e-3f;
+};
+
+//Throws std::runtime_error on unknown arguments or malformed values
+LaunchSettings ParseCommandLine(int argc, char** argv);
+void PrintUsage();
+
+struct CameraKey {
+    float Frame;
+    glm::vec3 Pos;
+    //Both in degrees, same convention as in the Camera class
+    float Yaw, Pitch;
+};
+
+//Camera path script is a plain text file, each line has the form:
+//  frame  pos_x pos_y pos_z  yaw pitch
+//Empty lines and lines starting with '#' are skipped.
+//Poses between keys are linearly interpolated, outside the keyed range
+//the first/last key is held.
+class CameraPath {
+public:
+    void Load(const std::string& filepath);
+
+    bool Empty() const { return m_Keys.empty(); }
+    CameraKey Sample(float frame) const;
+
+private:
+    std::vector<CameraKey> m_Keys;
+};
+
+//Writes per-frame timings as csv and prints a short summary to stdout
+void WriteBenchmarkResults(const std::string& filepath,
+                           const std::vector<float>& cpu_times,
+                           const std::vector<float>& gpu_times);
@@ -142,6 +142,18 @@ void FPCamera::Update(float aspect, float deltatime)
 {
     m_PrevPos = m_Pos;
 
+    if (m_PoseQueued)
+    {
+        m_Pos = m_QueuedPos;
+        m_Yaw = m_QueuedYaw;
+        m_Pitch = glm::clamp(m_QueuedPitch, -89.0f, 89.0f);
+
+        updateVectors();
+        updateFrustum(aspect);
+
+        m_PoseQueued = false;
+    }
+
     ProcessKeyboard(deltatime);
 
     //Vectors are not updated here, since they only change on mouse input
@@ -193,6 +205,15 @@ void FPCamera::ProcessMouse(float xoffset, float yoffset, float aspect)
     updateFrustum(aspect);
 }
 
+void FPCamera::QueuePose(const glm::vec3& pos, float yaw, float pitch)
+{
+    m_QueuedPos = pos;
+    m_QueuedYaw = yaw;
+    m_QueuedPitch = pitch;
+
+    m_PoseQueued = true;
+}
+
 void FPCamera::OnKeyPressed(int keycode, bool repeat)
 {
     if (!repeat) {
@@ -62,6 +62,7 @@ public:
     //This is the same for all cameras as only construction of
     //frustum planes is assumed to differ (this is definitely the case for ortho and perspective)
     bool IsInFrustum(const AABB& aabb, float scale_y) const;
+    const Frustum& getFrustum() const { return m_Frustum; }
 
     virtual void OnImGui(bool& open) = 0;
 
@@ -125,6 +126,10 @@ public:
 
     void setMouseInit(bool p) { m_MouseInit = p; }
 
+    //Pose gets applied on next Update, so that previous position
+    //is tracked the same way as with keyboard movement. Angles in degrees
+    void QueuePose(const glm::vec3& pos, float yaw, float pitch);
+
     void OnKeyPressed(int keycode, bool repeat);
     void OnKeyReleased(int keycode);
     void OnMouseMoved(float x, float y, unsigned int width, unsigned int height, float aspect);
@@ -150,5 +155,9 @@ private:
     bool m_MouseInit = true;
     float m_MouseLastX = 0.0f, m_MouseLastY = 0.0f;
 
+    bool m_PoseQueued = false;
+    glm::vec3 m_QueuedPos = glm::vec3(0.0f);
+    float m_QueuedYaw = 0.0f, m_QueuedPitch = 0.0f;
+
     glm::mat4 m_Proj, m_View, m_ViewProj;
 };
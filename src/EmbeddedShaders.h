@@ -0,0 +1,12 @@
+#pragma once
+
+//Shader sources with includes expanded, generated at build time by cmake/EmbedShaders.cmake
+//(only compiled in with LOFI_EMBED_SHADERS). Sources are split into null terminated lists of chunks.
+struct EmbeddedShader {
+    //Relative to the repository root, e.g. "res/shaders/shaded.frag"
+    const char* Path;
+    const char* const* Chunks;
+};
+
+//Terminated by an entry with null path
+extern const EmbeddedShader g_EmbeddedShaders[];
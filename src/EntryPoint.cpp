@@ -1,14 +1,46 @@
 #include "Application.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "Shader.h"
 
 #include <iostream>
 
-int main() {
+int main(int argc, char** argv) {
     try {
-        Application app("LofiLandscapes", 800, 600);
+        LaunchSettings settings = ParseCommandLine(argc, argv);
 
-        app.StartMenu();
-        app.Init();
-        app.Run();
+        if (settings.ShowHelp) {
+            PrintUsage();
+            return 0;
+        }
+
+        SetShaderCacheDirectory(settings.ShaderCachePath);
+        SetEmbeddedShaderSources(!settings.ShadersFromDisk);
+
+        if (settings.Headless) {
+            Application app("LofiLandscapes", settings.Width, settings.Height, true);
+
+            app.setStartSettings(settings.Start);
+            app.Init();
+
+            if (!settings.TracePath.empty())
+                Profiler::StartCapture(settings.TracePath);
+
+            app.RunBenchmark(settings);
+        }
+
+        else {
+            Application app("LofiLandscapes", 800, 600);
+
+            app.setStartSettings(settings.Start);
+            app.StartMenu();
+            app.Init();
+
+            if (!settings.TracePath.empty())
+                Profiler::StartCapture(settings.TracePath);
+
+            app.Run();
+        }
     }
 
     catch(const std::exception &e) {
@@ -6,14 +6,39 @@
 
 #include "ImGuiUtils.h"
 
+#include "nlohmann/json.hpp"
+
 #include <algorithm>
+#include <iostream>
+#include <cfloat>
+
+void FrameData::Reset(size_t frame)
+{
+	//Clearing keeps the capacity, so no reallocation happens here
+	Events.clear();
+	Frame = frame;
+	Complete = false;
+}
+
+int FrameData::AddEvent(uint32_t id, double start, int depth, int parent)
+{
+	if (Events.size() == Events.capacity())
+		return -1;
+
+	Events.push_back(ProfilerEvent{ start, 0.0f, 0.0f, id, depth, parent });
 
-FrameData::FrameData()
+	return Events.size() - 1;
+}
+
+void FrameData::SetTiming(int slot, float time)
 {
-	const int start_capacity = 10;
+	Events[slot].Timing = time;
+	Events[slot].SelfTime += time;
+
+	const int parent = Events[slot].Parent;
 
-	Timings.reserve(start_capacity);
-	Ids.reserve(start_capacity);
+	if (parent >= 0)
+		Events[parent].SelfTime -= time;
 }
 
 //=====Profiler static variables=====================
@@ -21,18 +46,32 @@ FrameData::FrameData()
 int Profiler::s_SelectedFrame = s_NumFrames - 2;
 bool Profiler::s_StopProfiling = false;
 float Profiler::s_MaxHeight = 17.0f;
+int Profiler::s_NumTopScopes = 10;
 
 std::vector<std::string> Profiler::s_CPUEventLabels, Profiler::s_GPUEventLabels;
-std::deque<FrameData> Profiler::s_CPUFrames, Profiler::s_GPUFrames;
+Profiler::FrameRing Profiler::s_CPUFrames, Profiler::s_GPUFrames;
 
-std::vector<unsigned int> Profiler::s_QueryIDs1, Profiler::s_QueryIDs2;
+size_t Profiler::s_FrameIndex = 0;
+size_t Profiler::s_DroppedEvents = 0;
+std::chrono::high_resolution_clock::time_point Profiler::s_Epoch = std::chrono::high_resolution_clock::now();
 
-std::vector<unsigned int>* Profiler::s_FrontBuffer = &s_QueryIDs1;
-std::vector<unsigned int>* Profiler::s_BackBuffer = &s_QueryIDs2;
+std::vector<int> Profiler::s_CPUScopeStack, Profiler::s_GPUScopeStack;
+
+std::vector<ScopeStats> Profiler::s_CPUStats, Profiler::s_GPUStats;
+FrameHistogram Profiler::s_CPUHistogram, Profiler::s_GPUHistogram;
+std::vector<float> Profiler::s_ScopeSums;
+std::vector<CounterTrack> Profiler::s_Counters;
+
+std::ofstream Profiler::s_TraceFile;
+std::string Profiler::s_TracePath = "profile.json";
+
+std::array<GPUQueryPool, Profiler::s_NumQueryPools> Profiler::s_QueryPools;
+size_t Profiler::s_CurrentPool = 0;
+double Profiler::s_GPUTimeOffset = 0.0;
 
 //===================================================
 
-size_t FindOrInsert(std::vector<std::string>& vec, const std::string& name)
+uint32_t FindOrInsert(std::vector<std::string>& vec, const std::string& name)
 {
 	auto idx = std::find(vec.begin(), vec.end(), name);
 
@@ -48,96 +87,501 @@ size_t FindOrInsert(std::vector<std::string>& vec, const std::string& name)
 	}
 }
 
-size_t Profiler::GetCPUEventID(const std::string& name)
+uint32_t Profiler::GetCPUEventID(const std::string& name)
 {
 	return FindOrInsert(s_CPUEventLabels, name);
 }
 
-size_t Profiler::GetGPUEventID(const std::string& name)
+uint32_t Profiler::GetGPUEventID(const std::string& name)
 {
 	return FindOrInsert(s_GPUEventLabels, name);
 }
 
-void Profiler::SubmitCpuEvent(size_t idx, float time)
+double Profiler::GetTimestamp(std::chrono::high_resolution_clock::time_point time)
 {
-	if (s_StopProfiling) return;
+	using namespace std::chrono;
+
+	return duration_cast<nanoseconds>(time - s_Epoch).count() * 1e-6;
+}
+
+FrameData& Profiler::GetFrame(FrameRing& frames, int idx)
+{
+	//Current frame is s_NumFrames-1, so oldest one is s_FrameIndex+1 modulo ring size
+	return frames[(s_FrameIndex + 1 + idx) % s_NumFrames];
+}
 
-	if (!s_CPUFrames.empty())
+FrameData& Profiler::CurrentFrame(FrameRing& frames)
+{
+	return frames[s_FrameIndex % s_NumFrames];
+}
+
+int Profiler::BeginCpuEvent(uint32_t idx, double start)
+{
+	if (s_StopProfiling || s_FrameIndex == 0) return -1;
+
+	const int depth = s_CPUScopeStack.size();
+	const int parent = s_CPUScopeStack.empty() ? -1 : s_CPUScopeStack.back();
+
+	const int slot = CurrentFrame(s_CPUFrames).AddEvent(idx, start, depth, parent);
+
+	if (slot < 0)
 	{
-		s_CPUFrames.back().Timings.push_back(time);
-		s_CPUFrames.back().Ids.push_back(idx);
+		s_DroppedEvents++;
+		return -1;
 	}
+
+	s_CPUScopeStack.push_back(slot);
+
+	return slot;
 }
 
-void Profiler::SubmitGpuEvent(size_t idx)
+void Profiler::EndCpuEvent(size_t frame, int slot, float time)
 {
-	if (s_StopProfiling) return;
+	if (slot < 0 || frame != s_FrameIndex) return;
 
-	if (!s_GPUFrames.empty())
+	s_CPUScopeStack.pop_back();
+	CurrentFrame(s_CPUFrames).SetTiming(slot, time);
+}
+
+int Profiler::BeginGpuEvent(uint32_t idx)
+{
+	if (s_StopProfiling || s_FrameIndex == 0) return -1;
+
+	auto& pool = s_QueryPools[s_CurrentPool];
+
+	//Events issued outside of NextFrame/SwapBuffers are ignored
+	if (pool.Pending) return -1;
+
+	//Starts and timings are filled in when the pool is resolved
+	const int depth = s_GPUScopeStack.size();
+	const int parent = s_GPUScopeStack.empty() ? -1 : s_GPUScopeStack.back();
+
+	const int slot = CurrentFrame(s_GPUFrames).AddEvent(idx, 0.0, depth, parent);
+
+	if (slot < 0)
 	{
-		s_GPUFrames.back().Ids.push_back(idx);
+		s_DroppedEvents++;
+		return -1;
 	}
+
+	s_GPUScopeStack.push_back(slot);
+
+	//Slot i corresponds to queries 2i, 2i+1, pools are large enough to fit all events
+	glQueryCounter(pool.Queries[2 * slot], GL_TIMESTAMP);
+	pool.Used = 2 * (slot + 1);
+	pool.LastIssued = 2 * slot;
+
+	return slot;
 }
 
-void Profiler::NextFrame()
+void Profiler::EndGpuEvent(size_t frame, int slot)
 {
-	if (s_StopProfiling) return;
+	if (slot < 0 || frame != s_FrameIndex) return;
+
+	s_GPUScopeStack.pop_back();
+
+	auto& pool = s_QueryPools[s_CurrentPool];
+
+	glQueryCounter(pool.Queries[2 * slot + 1], GL_TIMESTAMP);
+	pool.LastIssued = 2 * slot + 1;
+}
+
+void Profiler::ResolveQueryPool(GPUQueryPool& pool)
+{
+	pool.Pending = false;
+
+	auto& frame = s_GPUFrames[pool.Frame % s_NumFrames];
+
+	//Frame was already overwritten
+	if (frame.Frame != pool.Frame)
+		return;
+
+	for (size_t slot = 0; slot < frame.Events.size(); slot++)
+	{
+		GLuint64 begin_ns, end_ns;
+		glGetQueryObjectui64v(pool.Queries[2 * slot], GL_QUERY_RESULT, &begin_ns);
+		glGetQueryObjectui64v(pool.Queries[2 * slot + 1], GL_QUERY_RESULT, &end_ns);
+
+		frame.Events[slot].Start = s_GPUTimeOffset + double(begin_ns) * 1e-6;
+		frame.SetTiming(slot, float(end_ns - begin_ns) * 1e-6f);
+	}
+
+	frame.Complete = true;
+
+	AccumulateStats(frame, s_GPUStats, s_GPUHistogram, s_GPUEventLabels.size());
+
+	if (IsCapturing())
+		WriteTraceFrame(frame, s_GPUEventLabels, 1);
+}
 
-	//Retrieve gpu timings from last frame
-	if (!s_GPUFrames.empty())
+void Profiler::ResolveQueryPools(bool blocking)
+{
+	//Oldest pools first, so that frames are resolved in order
+	for (size_t offset = 1; offset <= s_NumQueryPools; offset++)
 	{
-		auto& last_frame = s_GPUFrames.back();
+		auto& pool = s_QueryPools[(s_CurrentPool + offset) % s_NumQueryPools];
+
+		if (!pool.Pending)
+			continue;
 
-		for (size_t event_id = 0; event_id < last_frame.Ids.size(); event_id++)
+		if (!blocking)
 		{
-			auto id = last_frame.Ids[event_id];
-			auto query_id = GetFrontbufferQueryID(id);
+			GLint available = 0;
+			glGetQueryObjectiv(pool.Queries[pool.LastIssued], GL_QUERY_RESULT_AVAILABLE, &available);
+
+			//Later pools can't be ready either
+			if (!available)
+				break;
+		}
+
+		ResolveQueryPool(pool);
+	}
+}
+
+void Profiler::CalibrateGPUClock()
+{
+	GLint64 gpu_time;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_time);
 
-			size_t time;
-			glGetQueryObjectui64v(query_id, GL_QUERY_RESULT, &time);
+	const double cpu_time = GetTimestamp(std::chrono::high_resolution_clock::now());
+
+	s_GPUTimeOffset = cpu_time - double(gpu_time) * 1e-6;
+}
+
+void Profiler::NextFrame()
+{
+	if (s_StopProfiling) return;
+
+	//Retrieve gpu timings of all frames that are already finished
+	ResolveQueryPools(false);
+
+	//Cpu frame is complete at this point
+	if (s_FrameIndex > 0)
+	{
+		auto& frame = CurrentFrame(s_CPUFrames);
+		frame.Complete = true;
 
-			float time_ms = float(time) * 1e-6;
+		AccumulateStats(frame, s_CPUStats, s_CPUHistogram, s_CPUEventLabels.size());
 
-			last_frame.Timings.push_back(time_ms);
+		if (IsCapturing())
+		{
+			WriteTraceFrame(frame, s_CPUEventLabels, 0);
+			WriteTraceCounters();
 		}
 	}
 
-	//Cycle frames
-	if (s_CPUFrames.size() >= s_NumFrames)
-		s_CPUFrames.pop_front();
+	//Scopes can't span multiple frames
+	s_CPUScopeStack.clear();
+	s_GPUScopeStack.clear();
+
+	//Cycle frames, the oldest one gets overwritten
+	s_FrameIndex++;
+
+	CurrentFrame(s_CPUFrames).Reset(s_FrameIndex);
+	CurrentFrame(s_GPUFrames).Reset(s_FrameIndex);
+
+	//Cycle query pools, this only waits if gpu
+	//is more than s_NumQueryPools-1 frames behind
+	s_CurrentPool = (s_CurrentPool + 1) % s_NumQueryPools;
+
+	auto& pool = s_QueryPools[s_CurrentPool];
 
-	if (s_GPUFrames.size() >= s_NumFrames)
-		s_GPUFrames.pop_front();
+	if (pool.Pending)
+		ResolveQueryPool(pool);
 
-	s_CPUFrames.push_back(FrameData());
-	s_GPUFrames.push_back(FrameData());
+	pool.Used = 0;
+	pool.LastIssued = 0;
+	pool.Frame = s_FrameIndex;
 }
 
 void Profiler::SwapBuffers()
 {
-	std::swap(s_FrontBuffer, s_BackBuffer);
+	auto& pool = s_QueryPools[s_CurrentPool];
+
+	//Pool is not submitted if profiling was stopped this frame
+	if (pool.Frame == s_FrameIndex && pool.Used > 0)
+		pool.Pending = true;
 }
 
 void Profiler::OnInit()
 {
-	s_QueryIDs1.resize(s_MaxGPUQueries);
-	s_QueryIDs2.resize(s_MaxGPUQueries);
+	//All storage is allocated upfront
+	for (auto& frame : s_CPUFrames)
+		frame.Events.reserve(s_MaxEventsPerFrame);
+
+	for (auto& frame : s_GPUFrames)
+		frame.Events.reserve(s_MaxEventsPerFrame);
+
+	s_CPUScopeStack.reserve(s_MaxScopeDepth);
+	s_GPUScopeStack.reserve(s_MaxScopeDepth);
+
+	//Scope ids are interned before the first frame for most call sites,
+	//so stats usually don't grow afterwards
+	s_CPUStats.reserve(s_MaxEventsPerFrame);
+	s_GPUStats.reserve(s_MaxEventsPerFrame);
+	s_ScopeSums.reserve(s_MaxEventsPerFrame);
+
+	for (auto& pool : s_QueryPools)
+	{
+		pool.Queries.resize(2 * s_MaxEventsPerFrame);
+		glGenQueries(pool.Queries.size(), &pool.Queries[0]);
+	}
+
+	CalibrateGPUClock();
+}
+
+void Profiler::StartCapture(const std::string& filepath)
+{
+	if (IsCapturing())
+		StopCapture();
+
+	s_TraceFile.open(filepath, std::ios::trunc);
+
+	if (!s_TraceFile)
+	{
+		std::cerr << "Profiler Error: Could not open trace file " << filepath << '\n';
+		return;
+	}
+
+	s_TracePath = filepath;
+
+	//Clocks may drift apart over long runs
+	CalibrateGPUClock();
+
+	//Capture starts with current values of all counters
+	for (auto& track : s_Counters)
+		track.Dirty = true;
+
+	//Metadata events naming the cpu/gpu timelines
+	s_TraceFile << "{\"traceEvents\":[\n"
+		<< R"({"name":"thread_name","ph":"M","pid":0,"tid":0,"args":{"name":"CPU"}},)" << '\n'
+		<< R"({"name":"thread_name","ph":"M","pid":0,"tid":1,"args":{"name":"GPU"}})";
+}
+
+void Profiler::StopCapture()
+{
+	if (!IsCapturing()) return;
+
+	//Flush gpu events still in flight
+	ResolveQueryPools(true);
+
+	s_TraceFile << "\n],\n";
+
+	//Extra top level keys are ignored by trace viewers
+	WriteTraceStats();
+
+	s_TraceFile << ",\n\"displayTimeUnit\":\"ms\"\n}\n";
+	s_TraceFile.close();
+}
+
+void Profiler::AccumulateStats(const FrameData& frame, std::vector<ScopeStats>& stats,
+	                           FrameHistogram& histogram, size_t num_labels)
+{
+	if (frame.Events.empty()) return;
+
+	if (stats.size() < num_labels)
+		stats.resize(num_labels);
+
+	//Negative sum marks scopes that weren't called this frame
+	if (s_ScopeSums.size() < num_labels)
+		s_ScopeSums.resize(num_labels, -1.0f);
+
+	float frame_time = 0.0f;
+
+	for (auto& event : frame.Events)
+	{
+		float& sum = s_ScopeSums[event.Id];
+		sum = std::max(sum, 0.0f) + event.Timing;
+
+		if (event.Depth == 0)
+			frame_time += event.Timing;
+	}
+
+	//Scopes that weren't called don't get a sample, so stats describe
+	//the cost of a scope when it runs (e.g. shadowmap updates)
+	for (auto& event : frame.Events)
+	{
+		float& sum = s_ScopeSums[event.Id];
+
+		if (sum < 0.0f) continue;
+
+		stats[event.Id].Add(sum);
+		sum = -1.0f;
+	}
+
+	histogram.Add(frame_time);
+}
+
+void Profiler::SetCounter(const std::string& track, const std::string& series, double value)
+{
+	auto track_it = std::find_if(s_Counters.begin(), s_Counters.end(),
+		[&track](const CounterTrack& counter) {return counter.Name == track; });
+
+	if (track_it == s_Counters.end())
+	{
+		s_Counters.push_back(CounterTrack{ track });
+		track_it = s_Counters.end() - 1;
+	}
+
+	auto& values = track_it->Series;
+
+	auto series_it = std::find_if(values.begin(), values.end(),
+		[&series](const std::pair<std::string, double>& entry) {return entry.first == series; });
+
+	if (series_it == values.end())
+	{
+		values.emplace_back(series, value);
+		track_it->Dirty = true;
+	}
+
+	else if (series_it->second != value)
+	{
+		series_it->second = value;
+		track_it->Dirty = true;
+	}
+}
+
+void Profiler::ResetStats()
+{
+	for (auto& scope : s_CPUStats)
+		scope.Reset();
+
+	for (auto& scope : s_GPUStats)
+		scope.Reset();
+
+	s_CPUHistogram.Reset();
+	s_GPUHistogram.Reset();
+}
+
+nlohmann::json StatsToJson(const std::vector<ScopeStats>& stats, const std::vector<std::string>& labels)
+{
+	nlohmann::json output = nlohmann::json::array();
+
+	for (size_t id = 0; id < stats.size(); id++)
+	{
+		auto& scope = stats[id];
+
+		if (scope.Count == 0) continue;
+
+		output.push_back({
+			{"name", labels[id]},
+			{"frames", scope.Count},
+			{"mean_ms", scope.Mean},
+			{"min_ms", scope.Min},
+			{"max_ms", scope.Max},
+			{"p50_ms", scope.P50.Get()},
+			{"p95_ms", scope.P95.Get()},
+			{"p99_ms", scope.P99.Get()}
+		});
+	}
+
+	return output;
+}
+
+void Profiler::WriteTraceStats()
+{
+	nlohmann::json histogram{
+		{"binWidthMs", FrameHistogram::BinWidth},
+		{"cpu", s_CPUHistogram.Bins},
+		{"gpu", s_GPUHistogram.Bins}
+	};
+
+	//Last values of all counters
+	nlohmann::json counters = nlohmann::json::object();
+
+	for (auto& track : s_Counters)
+	{
+		for (auto& [series, value] : track.Series)
+			counters[track.Name][series] = value;
+	}
+
+	nlohmann::json stats{
+		{"cpu", StatsToJson(s_CPUStats, s_CPUEventLabels)},
+		{"gpu", StatsToJson(s_GPUStats, s_GPUEventLabels)},
+		{"frameHistogram", histogram},
+		{"counters", counters}
+	};
+
+	s_TraceFile << "\"scopeStats\":" << stats.dump();
+}
+
+void Profiler::WriteStats(const std::string& filepath)
+{
+	//Flush gpu events still in flight
+	ResolveQueryPools(true);
 
-	glGenQueries(s_MaxGPUQueries, &s_QueryIDs1[0]);
-	glGenQueries(s_MaxGPUQueries, &s_QueryIDs2[0]);
+	std::ofstream output(filepath, std::ios::trunc);
+
+	if (!output)
+	{
+		std::cerr << "Profiler Error: Could not open stats file " << filepath << '\n';
+		return;
+	}
+
+	output << "timeline,scope,frames,mean_ms,min_ms,max_ms,p50_ms,p95_ms,p99_ms\n";
+
+	auto WriteRows = [&output](const std::string& timeline, const std::vector<ScopeStats>& stats,
+		                       const std::vector<std::string>& labels)
+	{
+		for (size_t id = 0; id < stats.size(); id++)
+		{
+			auto& scope = stats[id];
+
+			if (scope.Count == 0) continue;
+
+			output << timeline << ",\"" << labels[id] << "\"," << scope.Count << ','
+				<< scope.Mean << ',' << scope.Min << ',' << scope.Max << ','
+				<< scope.P50.Get() << ',' << scope.P95.Get() << ',' << scope.P99.Get() << '\n';
+		}
+	};
+
+	WriteRows("cpu", s_CPUStats, s_CPUEventLabels);
+	WriteRows("gpu", s_GPUStats, s_GPUEventLabels);
 }
 
-unsigned int Profiler::GetFrontbufferQueryID(size_t id)
+void Profiler::WriteTraceCounters()
 {
-	return s_FrontBuffer->at(id);
+	const double timestamp_us = 1e3 * GetTimestamp(std::chrono::high_resolution_clock::now());
+
+	for (auto& track : s_Counters)
+	{
+		if (!track.Dirty) continue;
+
+		nlohmann::json args = nlohmann::json::object();
+
+		for (auto& [series, value] : track.Series)
+			args[series] = value;
+
+		s_TraceFile << ",\n{\"name\":" << nlohmann::json(track.Name).dump()
+			<< ",\"ph\":\"C\",\"pid\":0" << std::fixed << ",\"ts\":" << timestamp_us
+			<< ",\"args\":" << args.dump() << "}";
+
+		track.Dirty = false;
+	}
 }
 
-unsigned int Profiler::GetBackbufferQueryID(size_t id)
+void Profiler::WriteTraceFrame(const FrameData& frame, const std::vector<std::string>& labels, int tid)
 {
-	return s_BackBuffer->at(id);
+	for (auto& event : frame.Events)
+	{
+		//Metadata events are always written first, so separator is always needed
+		s_TraceFile << ",\n";
+
+		//Trace format expects microseconds
+		const double start_us = 1e3 * event.Start;
+		const double duration_us = 1e3 * double(event.Timing);
+
+		//Dumping through json takes care of escaping
+		s_TraceFile << "{\"name\":" << nlohmann::json(labels[event.Id]).dump()
+			<< ",\"cat\":\"" << (tid == 0 ? "CPU" : "GPU") << "\""
+			<< ",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+			<< std::fixed << ",\"ts\":" << start_us << ",\"dur\":" << duration_us
+			<< ",\"args\":{\"frame\":" << frame.Frame << ",\"depth\":" << event.Depth
+			<< ",\"self_ms\":" << event.SelfTime << "}}";
+	}
 }
 
-void Profiler::DrawGraph(std::deque<FrameData>& frames, const ImU32* color_palette, int palette_size)
+void Profiler::DrawGraph(FrameRing& frames, const ImU32* color_palette, int palette_size)
 {
 	ImDrawList* drawList = ImGui::GetWindowDrawList();
 
@@ -149,15 +593,20 @@ void Profiler::DrawGraph(std::deque<FrameData>& frames, const ImU32* color_palet
 
 	const float frame_width = graph_width / (s_NumFrames - 1);
 
-	for (size_t frame_id = 0; frame_id < frames.size() - 1; frame_id++)
+	for (int frame_id = 0; frame_id < s_NumFrames - 1; frame_id++)
 	{
-		auto& frame = frames.at(frame_id);
+		auto& frame = GetFrame(frames, frame_id);
+
+		if (!frame.Complete) continue;
 
 		float height_offset = 0.0f;
 
-		for (size_t event_id = 0; event_id < frame.Timings.size(); event_id++)
+		for (auto& event : frame.Events)
 		{
-			const float block_height = (frame.Timings.at(event_id) / s_MaxHeight) * graph_height;
+			//Only top level scopes are stacked, nested ones are already included
+			if (event.Depth != 0) continue;
+
+			const float block_height = (event.Timing / s_MaxHeight) * graph_height;
 
 			const glm::vec2 margin{ 1.0f, -1.0f };
 			const glm::vec2 offset{ frame_id * frame_width, graph_height - height_offset };
@@ -167,7 +616,7 @@ void Profiler::DrawGraph(std::deque<FrameData>& frames, const ImU32* color_palet
 
 			height_offset += block_height;
 
-			const ImU32 color = color_palette[frame.Ids.at(event_id) % palette_size];
+			const ImU32 color = color_palette[event.Id % palette_size];
 
 			drawList->AddRectFilled(ImVec2(min_point.x, min_point.y), ImVec2(max_point.x, max_point.y), color);
 		}
@@ -180,32 +629,286 @@ void Profiler::DrawGraph(std::deque<FrameData>& frames, const ImU32* color_palet
 	drawList->AddRect(ImVec2(selected_min.x, selected_min.y), ImVec2(selected_max.x, selected_max.y), 0xffffffff);
 }
 
-void Profiler::DrawLegend(std::deque<FrameData>& frames, std::vector<std::string>& labels,
+void Profiler::DrawLegend(FrameRing& frames, std::vector<std::string>& labels,
 	                      const std::string& title, const ImU32* color_palette, int palette_size)
 {
-	auto& frame = frames[s_SelectedFrame];
-
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::Separator();
 
-	for (size_t idx = 0; idx < frame.Timings.size(); idx++)
+	auto& frame = GetFrame(frames, s_SelectedFrame);
+
+	if (!frame.Complete)
+		return;
+
+	for (auto& event : frame.Events)
 	{
-		auto id = frame.Ids.at(idx);
+		const ImU32 color = color_palette[event.Id % palette_size];
+
+		//Nested scopes are indented, self time is shown only if it differs
+		const std::string indent(2 * event.Depth, ' ');
+		std::string timings = std::to_string(event.Timing) + " ms";
 
-		const ImU32 color = color_palette[id % palette_size];
+		if (event.SelfTime != event.Timing)
+			timings += ", self " + std::to_string(event.SelfTime) + " ms";
 
 		ImGui::PushStyleColor(ImGuiCol_Text, color);
-		ImGui::TextUnformatted(
-			("[" + std::to_string(frame.Timings.at(idx)) + " ms] " + labels.at(id)).c_str()
-		);
+		ImGui::TextUnformatted((indent + "[" + timings + "] " + labels.at(event.Id)).c_str());
 		ImGui::PopStyleColor();
 	}
 }
 
+void Profiler::DrawFlameGraph(FrameRing& frames, std::vector<std::string>& labels,
+	                          const ImU32* color_palette, int palette_size)
+{
+	auto& frame = GetFrame(frames, s_SelectedFrame);
+
+	if (!frame.Complete || frame.Events.empty())
+	{
+		ImGui::TextUnformatted("No data for the selected frame");
+		return;
+	}
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+	auto ImToGlm = [](ImVec2 v) {return glm::vec2(v.x, v.y); };
+
+	const glm::vec2 start = ImToGlm(ImGui::GetCursorScreenPos());
+	const float graph_width = ImGui::GetContentRegionAvail().x;
+	const float row_height = ImGui::GetTextLineHeightWithSpacing();
+
+	//Horizontal axis spans all scopes of the frame
+	double frame_begin = frame.Events[0].Start, frame_end = frame.Events[0].Start;
+	int max_depth = 0;
+
+	for (auto& event : frame.Events)
+	{
+		frame_begin = std::min(frame_begin, event.Start);
+		frame_end = std::max(frame_end, event.Start + double(event.Timing));
+		max_depth = std::max(max_depth, int(event.Depth));
+	}
+
+	const double scale = graph_width / std::max(frame_end - frame_begin, 1e-6);
+
+	const glm::vec2 mouse = ImToGlm(ImGui::GetMousePos());
+	const ProfilerEvent* hovered = nullptr;
+
+	for (auto& event : frame.Events)
+	{
+		const float x = float(scale * (event.Start - frame_begin));
+		const float width = std::max(float(scale * event.Timing), 1.0f);
+
+		const glm::vec2 margin{ 1.0f, 1.0f };
+
+		const glm::vec2 min_point = start + glm::vec2(x, event.Depth * row_height);
+		const glm::vec2 max_point = min_point + glm::vec2(width, row_height) - margin;
+
+		const ImU32 color = color_palette[event.Id % palette_size];
+
+		drawList->AddRectFilled(ImVec2(min_point.x, min_point.y), ImVec2(max_point.x, max_point.y), color);
+
+		//Label is clipped to the block
+		drawList->PushClipRect(ImVec2(min_point.x, min_point.y), ImVec2(max_point.x, max_point.y), true);
+		drawList->AddText(ImVec2(min_point.x + 2.0f, min_point.y), IM_COL32_WHITE, labels[event.Id].c_str());
+		drawList->PopClipRect();
+
+		const bool inside = (mouse.x >= min_point.x) && (mouse.x < max_point.x)
+			             && (mouse.y >= min_point.y) && (mouse.y < max_point.y);
+
+		if (inside)
+			hovered = &event;
+	}
+
+	ImGui::Dummy(ImVec2(graph_width, (max_depth + 1) * row_height));
+
+	if (hovered != nullptr && ImGui::IsItemHovered())
+	{
+		ImGui::SetTooltip("%s\nTotal: %.3f ms\nSelf: %.3f ms", labels[hovered->Id].c_str(),
+			hovered->Timing, hovered->SelfTime);
+	}
+}
+
+void Profiler::DrawTopScopes(FrameRing& frames, std::vector<std::string>& labels,
+	                         const std::string& title)
+{
+	struct ScopeTotals {
+		uint32_t Id;
+		float Self = 0.0f, Total = 0.0f;
+		int Calls = 0;
+	};
+
+	std::vector<ScopeTotals> totals(labels.size());
+
+	for (size_t id = 0; id < totals.size(); id++)
+		totals[id].Id = id;
+
+	int num_frames = 0;
+
+	for (auto& frame : frames)
+	{
+		if (!frame.Complete) continue;
+
+		num_frames++;
+
+		for (auto& event : frame.Events)
+		{
+			auto& scope = totals[event.Id];
+
+			scope.Self += event.SelfTime;
+			scope.Total += event.Timing;
+			scope.Calls++;
+		}
+	}
+
+	std::sort(totals.begin(), totals.end(),
+		[](const ScopeTotals& lhs, const ScopeTotals& rhs) {return lhs.Self > rhs.Self; });
+
+	ImGui::TextUnformatted(title.c_str());
+
+	if (num_frames == 0) return;
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+
+	if (ImGui::BeginTable(title.c_str(), 4, flags))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Self [ms]");
+		ImGui::TableSetupColumn("Total [ms]");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableHeadersRow();
+
+		const float inv_frames = 1.0f / float(num_frames);
+
+		for (int idx = 0; idx < std::min(s_NumTopScopes, int(totals.size())); idx++)
+		{
+			auto& scope = totals[idx];
+
+			if (scope.Calls == 0) break;
+
+			//All values are averaged per frame
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(labels[scope.Id].c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", inv_frames * scope.Self);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", inv_frames * scope.Total);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", inv_frames * scope.Calls);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+void Profiler::DrawScopeStats(std::vector<ScopeStats>& stats, std::vector<std::string>& labels,
+	                          const std::string& title)
+{
+	ImGui::TextUnformatted(title.c_str());
+
+	enum Column { Scope, Frames, Mean, Min, Max, P50, P95, P99, NumColumns };
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg
+		                        | ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable;
+
+	if (!ImGui::BeginTable(title.c_str(), int(NumColumns), flags))
+		return;
+
+	const ImGuiTableColumnFlags numeric = ImGuiTableColumnFlags_PreferSortDescending;
+
+	ImGui::TableSetupColumn("Scope");
+	ImGui::TableSetupColumn("Frames", numeric);
+	ImGui::TableSetupColumn("Mean [ms]", numeric | ImGuiTableColumnFlags_DefaultSort);
+	ImGui::TableSetupColumn("Min [ms]", numeric);
+	ImGui::TableSetupColumn("Max [ms]", numeric);
+	ImGui::TableSetupColumn("p50 [ms]", numeric);
+	ImGui::TableSetupColumn("p95 [ms]", numeric);
+	ImGui::TableSetupColumn("p99 [ms]", numeric);
+	ImGui::TableHeadersRow();
+
+	std::vector<uint32_t> order;
+
+	for (uint32_t id = 0; id < stats.size(); id++)
+	{
+		if (stats[id].Count > 0)
+			order.push_back(id);
+	}
+
+	//Stats change every frame, so rows are sorted on every draw
+	const ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs();
+
+	if (sort_specs != nullptr && sort_specs->SpecsCount > 0)
+	{
+		const int column = sort_specs->Specs[0].ColumnIndex;
+		const bool ascending = (sort_specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending);
+
+		auto Key = [&stats](uint32_t id, int column) -> double
+		{
+			auto& scope = stats[id];
+
+			switch (column)
+			{
+			case Frames: return double(scope.Count);
+			case Min:    return scope.Min;
+			case Max:    return scope.Max;
+			case P50:    return scope.P50.Get();
+			case P95:    return scope.P95.Get();
+			case P99:    return scope.P99.Get();
+			default:     return scope.Mean;
+			}
+		};
+
+		std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs)
+		{
+			if (column == Scope)
+				return ascending ? (labels[lhs] < labels[rhs]) : (labels[lhs] > labels[rhs]);
+
+			return ascending ? (Key(lhs, column) < Key(rhs, column)) : (Key(lhs, column) > Key(rhs, column));
+		});
+	}
+
+	for (uint32_t id : order)
+	{
+		auto& scope = stats[id];
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(labels[id].c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", (unsigned long long)scope.Count);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.Mean);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.Min);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.Max);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.P50.Get());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.P95.Get());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", scope.P99.Get());
+	}
+
+	ImGui::EndTable();
+}
+
+void Profiler::DrawHistogram(const FrameHistogram& histogram, const std::string& title)
+{
+	const float range = FrameHistogram::NumBins * FrameHistogram::BinWidth;
+	const std::string overlay = title + " (0 - " + std::to_string(int(range)) + " ms)";
+
+	ImGui::PlotHistogram(("###" + title).c_str(), histogram.Bins.data(), FrameHistogram::NumBins, 0,
+		                 overlay.c_str(), 0.0f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 80.0f));
+}
+
 void Profiler::OnImGui(bool& open)
 {
 	ImGui::Begin("Profiler", &open);
 
+#ifndef LOFI_PROFILER
+	ImGui::TextUnformatted("Profiler scopes were compiled out of this build (LOFI_PROFILER is not defined).");
+#endif
+
 	const int palette_size = 6;
 	const ImU32 color_palette[palette_size]{
 		//https://flatuicolors.com/palette/defo
@@ -219,7 +922,7 @@ void Profiler::OnImGui(bool& open)
 
 	const float legend_width = 250.0f, min_graph_width = 200.0f, min_graph_height = 150.0f;
 	const float graph_width = std::max(min_graph_width, ImGui::GetContentRegionAvail().x - legend_width);
-	const float graph_height = std::max(min_graph_height, 0.5f * ImGui::GetContentRegionAvail().y);
+	const float graph_height = std::max(min_graph_height, 0.35f * ImGui::GetContentRegionAvail().y);
 
 	ImGui::BeginChild("CPU Timing", ImVec2(graph_width, graph_height), true);
 	DrawGraph(s_CPUFrames, color_palette, palette_size);
@@ -227,7 +930,7 @@ void Profiler::OnImGui(bool& open)
 
 	ImGui::SameLine();
 
-	ImGui::BeginChild("CPU Legend", ImVec2(0.0f, graph_height), false);
+	ImGui::BeginChild("CPU Legend", ImVec2(0.0f, graph_height), false, ImGuiWindowFlags_HorizontalScrollbar);
 	DrawLegend(s_CPUFrames, s_CPUEventLabels, "CPU TIMINGS", color_palette, palette_size);
 	ImGui::EndChild();
 
@@ -237,7 +940,7 @@ void Profiler::OnImGui(bool& open)
 
 	ImGui::SameLine();
 
-	ImGui::BeginChild("GPU Legend", ImVec2(0.0f, graph_height), false);
+	ImGui::BeginChild("GPU Legend", ImVec2(0.0f, graph_height), false, ImGuiWindowFlags_HorizontalScrollbar);
 	DrawLegend(s_GPUFrames, s_GPUEventLabels, "GPU TIMINGS", color_palette, palette_size);
 	ImGui::EndChild();
 
@@ -247,15 +950,75 @@ void Profiler::OnImGui(bool& open)
 	ImGuiUtils::ColSliderFloat("Max Height [ms]", &s_MaxHeight, 1.0f, 34.0f);
 	ImGui::Columns(1, "###col");
 
+	if (s_DroppedEvents > 0)
+		ImGui::Text("Dropped events (frame capacity exceeded): %zu", s_DroppedEvents);
+
+	if (ImGui::CollapsingHeader("Flame graph"))
+	{
+		ImGui::TextUnformatted("CPU");
+		DrawFlameGraph(s_CPUFrames, s_CPUEventLabels, color_palette, palette_size);
+
+		ImGui::TextUnformatted("GPU");
+		DrawFlameGraph(s_GPUFrames, s_GPUEventLabels, color_palette, palette_size);
+	}
+
+	if (ImGui::CollapsingHeader("Top scopes by self time"))
+	{
+		ImGui::Columns(2, "###col");
+		ImGuiUtils::ColSliderInt("Number of scopes", &s_NumTopScopes, 1, 32);
+		ImGui::Columns(1, "###col");
+
+		DrawTopScopes(s_CPUFrames, s_CPUEventLabels, "CPU (average per frame)");
+		DrawTopScopes(s_GPUFrames, s_GPUEventLabels, "GPU (average per frame)");
+	}
+
+	if (ImGui::CollapsingHeader("Scope statistics"))
+	{
+		if (ImGui::Button("Reset statistics"))
+			ResetStats();
+
+		//Frame time is the sum of top level scopes
+		DrawHistogram(s_CPUHistogram, "CPU frame time");
+		DrawHistogram(s_GPUHistogram, "GPU frame time");
+
+		DrawScopeStats(s_CPUStats, s_CPUEventLabels, "CPU (per frame, over all frames since reset)");
+		DrawScopeStats(s_GPUStats, s_GPUEventLabels, "GPU (per frame, over all frames since reset)");
+	}
+
+	ImGuiUtils::Separator();
+
+	//-----Trace capture
+	const size_t max_path_length = 256;
+	static std::string trace_path = s_TracePath;
+	trace_path.resize(max_path_length);
+
+	const ImGuiInputTextFlags flags = IsCapturing() ? ImGuiInputTextFlags_ReadOnly : 0;
+	ImGui::InputText("Trace file", trace_path.data(), max_path_length, flags);
+
+	if (!IsCapturing())
+	{
+		if (ImGui::Button("Start capture"))
+			StartCapture(trace_path.c_str());
+	}
+
+	else
+	{
+		if (ImGui::Button("Stop capture"))
+			StopCapture();
+
+		ImGui::SameLine();
+		ImGui::Text("Capturing to %s", s_TracePath.c_str());
+	}
+
 	ImGui::End();
 }
 
 
-ProfilerCPUEvent::ProfilerCPUEvent(const std::string& name)
-	: m_Start(std::chrono::high_resolution_clock::now())
-	, m_ID(Profiler::GetCPUEventID(name))
+ProfilerCPUEvent::ProfilerCPUEvent(uint32_t id)
+	: m_Frame(Profiler::GetFrameIndex())
+	, m_Start(std::chrono::high_resolution_clock::now())
 {
-
+	m_Slot = Profiler::BeginCpuEvent(id, Profiler::GetTimestamp(m_Start));
 }
 
 ProfilerCPUEvent::~ProfilerCPUEvent()
@@ -265,19 +1028,17 @@ ProfilerCPUEvent::~ProfilerCPUEvent()
 	const auto current = high_resolution_clock::now();
 	const float time_ms = duration_cast<nanoseconds>(current - m_Start).count() * 1e-6;
 
-	Profiler::SubmitCpuEvent(m_ID, time_ms);
+	Profiler::EndCpuEvent(m_Frame, m_Slot, time_ms);
 }
 
 
-ProfilerGPUEvent::ProfilerGPUEvent(const std::string& name)
-	: m_ID(Profiler::GetGPUEventID(name))
+ProfilerGPUEvent::ProfilerGPUEvent(uint32_t id)
+	: m_Frame(Profiler::GetFrameIndex())
 {
-	glBeginQuery(GL_TIME_ELAPSED, Profiler::GetBackbufferQueryID(m_ID));
+	m_Slot = Profiler::BeginGpuEvent(id);
 }
 
 ProfilerGPUEvent::~ProfilerGPUEvent()
 {
-	glEndQuery(GL_TIME_ELAPSED);
-
-	Profiler::SubmitGpuEvent(m_ID);
+	Profiler::EndGpuEvent(m_Frame, m_Slot);
 }
@@ -7,72 +7,214 @@
 
 #include <string>
 #include <vector>
-#include <deque>
+#include <array>
 #include <chrono>
+#include <fstream>
+#include <cstdint>
 
 #include "imgui.h"
 
+#include "ProfilerStats.h"
+
+//Scopes should be profiled using the macros below. Name of the scope
+//is interned once per call site, so entering a scope doesn't allocate
+//and doesn't search through the labels. If LOFI_PROFILER is not defined
+//(release builds by default) the macros compile to nothing.
+#define LOFI_CONCAT_IMPL(a, b) a##b
+#define LOFI_CONCAT(a, b) LOFI_CONCAT_IMPL(a, b)
+
+#ifdef LOFI_PROFILER
+	#define LOFI_PROFILE_CPU(name) \
+		static const uint32_t LOFI_CONCAT(lofi_profile_id_, __LINE__) = Profiler::GetCPUEventID(name); \
+		ProfilerCPUEvent LOFI_CONCAT(lofi_profile_event_, __LINE__)(LOFI_CONCAT(lofi_profile_id_, __LINE__))
+
+	#define LOFI_PROFILE_GPU(name) \
+		static const uint32_t LOFI_CONCAT(lofi_profile_id_, __LINE__) = Profiler::GetGPUEventID(name); \
+		ProfilerGPUEvent LOFI_CONCAT(lofi_profile_event_, __LINE__)(LOFI_CONCAT(lofi_profile_id_, __LINE__))
+#else
+	#define LOFI_PROFILE_CPU(name) ((void)0)
+	#define LOFI_PROFILE_GPU(name) ((void)0)
+#endif
+
+//Start is in ms since profiler epoch
+struct ProfilerEvent {
+	double Start;
+	float Timing, SelfTime;
+	uint32_t Id;
+	int32_t Depth, Parent;
+};
+
+//Events are kept in order of scope beginnings, so parents always precede their children.
+//Storage is reserved once, so recording a frame doesn't allocate.
 struct FrameData {
-	std::vector<float> Timings;
-	std::vector<size_t> Ids;
+	std::vector<ProfilerEvent> Events;
+
+	size_t Frame = 0;
+
+	//Set once all timings are known (cpu - at frame end, gpu - after query readback)
+	bool Complete = false;
+
+	void Reset(size_t frame);
+
+	//Reserves a slot for an event, returns its index or -1 if the frame is full
+	int AddEvent(uint32_t id, double start, int depth, int parent);
+	//Fills in total time of the event and subtracts it from parent's self time
+	void SetTiming(int slot, float time);
+};
 
-	FrameData();
+//Named values tracked over time (e.g. memory usage), one series per subsystem
+struct CounterTrack {
+	std::string Name;
+	std::vector<std::pair<std::string, double>> Series;
+
+	//Set when some value changed since it was last written to the trace
+	bool Dirty = true;
+};
+
+//Timestamp queries issued during a single frame. Each gpu event
+//takes a begin/end pair, so nested and repeated scopes are fine.
+struct GPUQueryPool {
+	std::vector<unsigned int> Queries;
+	size_t Used = 0;
+	//Query issued last in the frame (end of the outermost scope, not of the last begun one),
+	//all others are available once it is
+	size_t LastIssued = 0;
+
+	size_t Frame = 0;
+	bool Pending = false;
 };
 
 class Profiler {
 public:
-	static size_t GetCPUEventID(const std::string& name);
-	static size_t GetGPUEventID(const std::string& name);
+	static uint32_t GetCPUEventID(const std::string& name);
+	static uint32_t GetGPUEventID(const std::string& name);
 
-	static unsigned int GetFrontbufferQueryID(size_t id);
-	static unsigned int GetBackbufferQueryID(size_t id);
+	static size_t GetFrameIndex() { return s_FrameIndex; }
 
 	static void NextFrame();
 	static void SwapBuffers();
 
-	static void SubmitCpuEvent(size_t idx, float time);
-	static void SubmitGpuEvent(size_t idx);
+	//Begin functions return slot of the event in current frame, or -1 if it is not recorded.
+	//Scopes are expected to begin and end within the same frame.
+	static int BeginCpuEvent(uint32_t idx, double start);
+	static void EndCpuEvent(size_t frame, int slot, float time);
+
+	static int BeginGpuEvent(uint32_t idx);
+	static void EndGpuEvent(size_t frame, int slot);
+
+	//Time in ms since the profiler epoch
+	static double GetTimestamp(std::chrono::high_resolution_clock::time_point time);
+
+	//Capture streams all events to a Chrome trace (chrome://tracing, Perfetto) json file
+	static void StartCapture(const std::string& filepath);
+	static void StopCapture();
+	static bool IsCapturing() { return s_TraceFile.is_open(); }
+
+	//Counters end up as counter tracks in trace captures, written only when values change
+	static void SetCounter(const std::string& track, const std::string& series, double value);
+
+	//Rolling per scope statistics, accumulated over all completed frames since the last reset
+	static void ResetStats();
+	static void WriteStats(const std::string& filepath);
 
 	static void OnInit();
 	static void OnImGui(bool& open);
 
+	static const int s_NumFrames = 48;
+
+	//Frames are stored in a ring, frame with index i lives in slot i % s_NumFrames
+	using FrameRing = std::array<FrameData, s_NumFrames>;
+
 private:
-	static void DrawGraph(std::deque<FrameData>& frames, const ImU32* color_palette, int palette_size);
-	static void DrawLegend(std::deque<FrameData>& frames, std::vector<std::string>& labels,
+	//Frames ordered from oldest (0) to the current one (s_NumFrames - 1)
+	static FrameData& GetFrame(FrameRing& frames, int idx);
+	static FrameData& CurrentFrame(FrameRing& frames);
+
+	//Reads back finished query pools. If blocking is set,
+	//waits for all pending pools instead of polling
+	static void ResolveQueryPools(bool blocking);
+	static void ResolveQueryPool(GPUQueryPool& pool);
+	static void CalibrateGPUClock();
+
+	//Called once per completed frame, each scope gets one sample (sum of its calls)
+	static void AccumulateStats(const FrameData& frame, std::vector<ScopeStats>& stats,
+		                        FrameHistogram& histogram, size_t num_labels);
+
+	static void WriteTraceFrame(const FrameData& frame, const std::vector<std::string>& labels, int tid);
+	static void WriteTraceStats();
+	static void WriteTraceCounters();
+
+	static void DrawGraph(FrameRing& frames, const ImU32* color_palette, int palette_size);
+	static void DrawLegend(FrameRing& frames, std::vector<std::string>& labels,
 		                   const std::string& title, const ImU32* color_palette, int palette_size);
+	static void DrawFlameGraph(FrameRing& frames, std::vector<std::string>& labels,
+		                       const ImU32* color_palette, int palette_size);
+	static void DrawTopScopes(FrameRing& frames, std::vector<std::string>& labels,
+		                      const std::string& title);
+	static void DrawScopeStats(std::vector<ScopeStats>& stats, std::vector<std::string>& labels,
+		                       const std::string& title);
+	static void DrawHistogram(const FrameHistogram& histogram, const std::string& title);
 
-	static const int s_NumFrames = 48;
+	static const int s_MaxEventsPerFrame = 512;
+	static const int s_MaxScopeDepth = 64;
 
 	static int s_SelectedFrame;
 	static bool s_StopProfiling;
 	static float s_MaxHeight;
+	static int s_NumTopScopes;
 
-	static std::deque<FrameData> s_CPUFrames, s_GPUFrames;
+	static FrameRing s_CPUFrames, s_GPUFrames;
 	static std::vector<std::string> s_CPUEventLabels, s_GPUEventLabels;
 
-	static const int s_MaxGPUQueries = 32;
+	static std::vector<ScopeStats> s_CPUStats, s_GPUStats;
+	static FrameHistogram s_CPUHistogram, s_GPUHistogram;
+
+	static std::vector<CounterTrack> s_Counters;
+
+	//Per scope time of the frame being accumulated
+	static std::vector<float> s_ScopeSums;
 
-	static std::vector<unsigned int> s_QueryIDs1, s_QueryIDs2;
-	static std::vector<unsigned int> *s_FrontBuffer, *s_BackBuffer;
+	//Index 0 means that no frame was started yet
+	static size_t s_FrameIndex;
+	static size_t s_DroppedEvents;
+	static std::chrono::high_resolution_clock::time_point s_Epoch;
+
+	//Slots of currently open scopes
+	static std::vector<int> s_CPUScopeStack, s_GPUScopeStack;
+
+	static std::ofstream s_TraceFile;
+	static std::string s_TracePath;
+
+	//Results are read back with a latency of up to s_NumQueryPools-1 frames
+	static const int s_NumQueryPools = 4;
+	static const int s_InitialPoolSize = 64;
+
+	static std::array<GPUQueryPool, s_NumQueryPools> s_QueryPools;
+	static size_t s_CurrentPool;
+
+	//Offset converting gpu timestamps to profiler epoch [ms]
+	static double s_GPUTimeOffset;
 };
 
 
 class ProfilerCPUEvent {
 public:
-	ProfilerCPUEvent(const std::string& name);
+	explicit ProfilerCPUEvent(uint32_t id);
 	~ProfilerCPUEvent();
 
 private:
-	size_t m_ID;
+	size_t m_Frame;
+	int m_Slot;
 
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
 };
 
 class ProfilerGPUEvent {
 public:
-	ProfilerGPUEvent(const std::string& name);
+	explicit ProfilerGPUEvent(uint32_t id);
 	~ProfilerGPUEvent();
 
 private:
-	size_t m_ID;
-};
\ No newline at end of file
+	size_t m_Frame;
+	int m_Slot;
+};
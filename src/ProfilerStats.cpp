@@ -0,0 +1,165 @@
+#include "ProfilerStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+P2Quantile::P2Quantile(double p)
+	: m_P(p)
+{
+
+}
+
+void P2Quantile::Reset()
+{
+	m_Count = 0;
+}
+
+void P2Quantile::Add(double x)
+{
+	//First five samples initialize the markers
+	if (m_Count < 5)
+	{
+		m_Heights[m_Count++] = x;
+
+		if (m_Count == 5)
+		{
+			std::sort(m_Heights.begin(), m_Heights.end());
+
+			m_Positions  = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+			m_Desired    = { 1.0, 1.0 + 2.0 * m_P, 1.0 + 4.0 * m_P, 3.0 + 2.0 * m_P, 5.0 };
+			m_Increments = { 0.0, 0.5 * m_P, m_P, 0.5 * (1.0 + m_P), 1.0 };
+		}
+
+		return;
+	}
+
+	//Find cell containing x, extending extremal markers if needed
+	int k = 0;
+
+	if (x < m_Heights[0])
+	{
+		m_Heights[0] = x;
+		k = 0;
+	}
+
+	else if (x >= m_Heights[4])
+	{
+		m_Heights[4] = x;
+		k = 3;
+	}
+
+	else
+	{
+		while (x >= m_Heights[k + 1])
+			k++;
+	}
+
+	for (int i = k + 1; i < 5; i++)
+		m_Positions[i] += 1.0;
+
+	for (int i = 0; i < 5; i++)
+		m_Desired[i] += m_Increments[i];
+
+	//Adjust heights of the middle markers
+	for (int i = 1; i < 4; i++)
+	{
+		const double d = m_Desired[i] - m_Positions[i];
+
+		const bool move_right = (d >= 1.0) && (m_Positions[i + 1] - m_Positions[i] > 1.0);
+		const bool move_left = (d <= -1.0) && (m_Positions[i - 1] - m_Positions[i] < -1.0);
+
+		if (move_right || move_left)
+		{
+			const int sign = (d >= 0.0) ? 1 : -1;
+
+			const double candidate = Parabolic(i, sign);
+
+			if (m_Heights[i - 1] < candidate && candidate < m_Heights[i + 1])
+				m_Heights[i] = candidate;
+			else
+				m_Heights[i] = Linear(i, sign);
+
+			m_Positions[i] += sign;
+		}
+	}
+
+	m_Count++;
+}
+
+double P2Quantile::Get() const
+{
+	if (m_Count == 0)
+		return 0.0;
+
+	//Not enough samples for the markers, use the exact quantile
+	if (m_Count < 5)
+	{
+		std::array<double, 5> sorted = m_Heights;
+		std::sort(sorted.begin(), sorted.begin() + m_Count);
+
+		const size_t idx = size_t(std::round(m_P * double(m_Count - 1)));
+		return sorted[idx];
+	}
+
+	return m_Heights[2];
+}
+
+double P2Quantile::Parabolic(int i, double d) const
+{
+	const auto& q = m_Heights;
+	const auto& n = m_Positions;
+
+	return q[i] + d / (n[i + 1] - n[i - 1]) * (
+		(n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i])
+	  + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1])
+	);
+}
+
+double P2Quantile::Linear(int i, int d) const
+{
+	const auto& q = m_Heights;
+	const auto& n = m_Positions;
+
+	return q[i] + double(d) * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+}
+
+void ScopeStats::Add(float time)
+{
+	if (Count == 0)
+	{
+		Min = time;
+		Max = time;
+	}
+
+	Count++;
+	Mean += (double(time) - Mean) / double(Count);
+	Min = std::min(Min, time);
+	Max = std::max(Max, time);
+
+	P50.Add(time);
+	P95.Add(time);
+	P99.Add(time);
+}
+
+void ScopeStats::Reset()
+{
+	Count = 0;
+	Mean = 0.0;
+	Min = 0.0f;
+	Max = 0.0f;
+
+	P50.Reset();
+	P95.Reset();
+	P99.Reset();
+}
+
+void FrameHistogram::Add(float time)
+{
+	const int bin = std::clamp(int(time / BinWidth), 0, NumBins - 1);
+	Bins[bin] += 1.0f;
+}
+
+void FrameHistogram::Reset()
+{
+	Bins.fill(0.0f);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+//Streaming quantile estimate with constant memory, using the P-square algorithm:
+//R. Jain, I. Chlamtac, "The P2 algorithm for dynamic calculation of quantiles
+//and histograms without storing observations", Communications of the ACM, 1985
+class P2Quantile {
+public:
+	explicit P2Quantile(double p);
+
+	void Add(double x);
+	double Get() const;
+
+	void Reset();
+
+private:
+	double Parabolic(int i, double d) const;
+	double Linear(int i, int d) const;
+
+	double m_P;
+	uint64_t m_Count = 0;
+
+	//Marker heights, actual and desired positions, desired position increments
+	std::array<double, 5> m_Heights{}, m_Positions{}, m_Desired{}, m_Increments{};
+};
+
+//Rolling statistics of a single profiler scope, one sample per frame
+struct ScopeStats {
+	uint64_t Count = 0;
+	double Mean = 0.0;
+	float Min = 0.0f, Max = 0.0f;
+
+	P2Quantile P50{ 0.5 }, P95{ 0.95 }, P99{ 0.99 };
+
+	void Add(float time);
+	void Reset();
+};
+
+//Frame time histogram with fixed bins, times over the range land in the last bin
+struct FrameHistogram {
+	static constexpr int NumBins = 68;
+	static constexpr float BinWidth = 0.5f; //[ms]
+
+	std::array<float, NumBins> Bins{};
+
+	void Add(float time);
+	void Reset();
+};
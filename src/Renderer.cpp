@@ -22,13 +22,14 @@ Renderer::Renderer(unsigned int width, unsigned int height)
     , m_TerrainRenderer(m_ResourceManager, m_Camera, m_Map, m_Material, m_SkyRenderer)
     , m_GrassRenderer(m_ResourceManager, m_Camera, m_Map, m_Material, m_SkyRenderer)
 {
-    m_Serializer.RegisterLoadCallback("Terrain Editor",
-        std::bind(&MapGenerator::OnDeserialize, &m_Map, std::placeholders::_1)
-    );
+    //Sculpt layer is stored in a file next to the world
+    m_Serializer.RegisterLoadCallback("Terrain Editor", [this](nlohmann::ordered_json& input) {
+        m_Map.OnDeserialize(input, m_Serializer.getWorldPath());
+    });
 
-    m_Serializer.RegisterSaveCallback("Terrain Editor",
-        std::bind(&MapGenerator::OnSerialize, &m_Map, std::placeholders::_1)
-    );
+    m_Serializer.RegisterSaveCallback("Terrain Editor", [this](nlohmann::ordered_json& output) {
+        m_Map.OnSerialize(output, m_Serializer.getWorldPath());
+    });
 
     m_Serializer.RegisterLoadCallback("Material Editor",
         std::bind(&MaterialGenerator::OnDeserialize, &m_Material, std::placeholders::_1)
@@ -37,16 +38,29 @@ Renderer::Renderer(unsigned int width, unsigned int height)
     m_Serializer.RegisterSaveCallback("Material Editor", 
         std::bind(&MaterialGenerator::OnSerialize, &m_Material, std::placeholders::_1)
     );
+
+    m_ResourceManager.RegisterBufferSource("Uniforms", [this]() {
+        return m_FrameBuffer.getMemoryUsage() + m_MapBuffer.getMemoryUsage();
+    });
 }
 
 Renderer::~Renderer() {}
 
 void Renderer::Init(StartSettings settings) {
-    m_TerrainRenderer.Init(settings.Subdivisions, settings.LodLevels);
+    //Shaders requested by the constructors compile while the rest is initialized
+    m_ResourceManager.SubmitShaderBuilds();
+
+    m_TerrainRenderer.Init(settings.Subdivisions, settings.LodLevels, settings.GeometryMode);
+    m_TerrainRenderer.setOcclusionCulling(settings.OcclusionCulling);
     m_Map.Init(settings.HeightRes, settings.ShadowRes, settings.WrapType);
+    m_Map.setCpuProcedures(settings.CpuProcedures);
+
+    if (settings.Unbounded)
+        m_Map.InitHeightStack(settings.HeightStackRes, settings.LodLevels, m_TerrainRenderer.getClipmapExtent());
+
     m_Material.Init(settings.MaterialRes);
 
-    m_GrassRenderer.Init();
+    m_GrassRenderer.Init(settings.GeometryMode);
 
     glEnable(GL_DEPTH_TEST);
     //Depth function to allow sky with maximal depth (1.0)
@@ -62,8 +76,16 @@ void Renderer::Init(StartSettings settings) {
     //Seamless cubemaps
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+    //Includes procedure shaders registered by the subrenderers
+    m_ResourceManager.FinishShaderBuilds();
+
+    //Displacement and map shaders read scales from the map block
+    m_SkyRenderer.UpdateSunColor();
+    UpdateSharedUniforms();
+
     //Update Maps
     m_Map.Update(m_SkyRenderer.getSunDir());
+    m_Map.UpdateHeightStack(m_Camera.getPos());
 
     //Update Material
     m_Material.Update();
@@ -73,10 +95,14 @@ void Renderer::Init(StartSettings settings) {
 }
 
 void Renderer::OnUpdate(float deltatime) {
-    ProfilerCPUEvent we("Renderer::OnUpdate");
+    LOFI_PROFILE_CPU("Renderer::OnUpdate");
+
+    //Brush aims at the center of the screen
+    if (m_Sculpting)
+        m_Map.Sculpt(m_Camera.getPos(), m_Camera.getFront(), deltatime, m_TerrainRenderer.DoShadows());
 
     if (m_Map.GeometryShouldUpdate())
-        m_TerrainRenderer.RequestFullUpdate();
+        m_TerrainRenderer.RequestRegionUpdate(m_Map.getHeightUpdateRect());
 
     if (m_SkyRenderer.SunDirChanged() && m_TerrainRenderer.DoShadows())
         m_Map.RequestShadowUpdate();
@@ -85,8 +111,14 @@ void Renderer::OnUpdate(float deltatime) {
 
     m_Camera.Update(m_Aspect, deltatime);
 
+    m_SkyRenderer.UpdateSunColor();
+    UpdateSharedUniforms();
+
     m_Map.Update(m_SkyRenderer.getSunDir());
 
+    if (m_Map.UpdateHeightStack(m_Camera.getPos()))
+        m_TerrainRenderer.RequestFullUpdate();
+
     m_GrassRenderer.OnUpdate(deltatime);
 
     m_SkyRenderer.Update(m_TerrainRenderer.DoFog());
@@ -94,8 +126,31 @@ void Renderer::OnUpdate(float deltatime) {
     m_TerrainRenderer.Update();
 }
 
+void Renderer::UpdateSharedUniforms() {
+    const FrustumExtents extents = m_Camera.getFrustumExtents();
+
+    FrameUniforms frame;
+    frame.ViewProj    = m_Camera.getViewProjMatrix();
+    frame.CameraPos   = glm::vec4(m_Camera.getPos(), 1.0f);
+    frame.CameraFront = glm::vec4(m_Camera.getFront(), 0.0f);
+    frame.BotLeft     = glm::vec4(extents.BottomLeft, 0.0f);
+    frame.BotRight    = glm::vec4(extents.BottomRight, 0.0f);
+    frame.TopLeft     = glm::vec4(extents.TopLeft, 0.0f);
+    frame.TopRight    = glm::vec4(extents.TopRight, 0.0f);
+    frame.SunDir      = glm::vec4(m_SkyRenderer.getSunDir(), 0.0f);
+    frame.SunCol      = glm::vec4(m_SkyRenderer.getSunCol(), 0.0f);
+
+    m_FrameBuffer.Update(&frame);
+
+    MapUniforms map{};
+    map.ScaleXZ = m_Map.getScaleXZ();
+    map.ScaleY  = m_Map.getScaleY();
+
+    m_MapBuffer.Update(&map);
+}
+
 void Renderer::OnRender() {
-    ProfilerCPUEvent we("Renderer::OnRender");
+    LOFI_PROFILE_CPU("Renderer::OnRender");
 
     const float scale_y  = m_Map.getScaleY();
 
@@ -115,7 +170,7 @@ void Renderer::OnRender() {
 }
 
 void Renderer::OnImGuiRender() {
-    ProfilerCPUEvent we("Renderer::OnImGuiRender");
+    LOFI_PROFILE_CPU("Renderer::OnImGuiRender");
 
     //-----Menu bar
     if (ImGui::BeginMainMenuBar()) {
@@ -214,6 +269,18 @@ void Renderer::OnImGuiRender() {
         Profiler::OnImGui(m_ShowProfiler);
 }
 
+void Renderer::LoadWorld(const std::filesystem::path& path) {
+    m_Serializer.LoadFromFile(path);
+}
+
+void Renderer::SetCameraPose(const glm::vec3& pos, float yaw, float pitch) {
+    m_Camera.QueuePose(pos, yaw, pitch);
+}
+
+float Renderer::ValidateCpuProcedures() {
+    return m_Map.ValidateCpuProcedures();
+}
+
 void Renderer::OnWindowResize(unsigned int width, unsigned int height) {
     m_WindowWidth = width;
     m_WindowHeight = height;
@@ -237,7 +304,15 @@ void Renderer::OnMouseMoved(float x, float y) {
 }
 
 void Renderer::OnMousePressed(int button, int mods) {
-    //std::cout << button << mods << '\n';
+    if (button == LOFI_MOUSE_BUTTON_LEFT && !ImGui::GetIO().WantCaptureMouse)
+        m_Sculpting = true;
+}
+
+void Renderer::OnMouseReleased(int button, int mods) {
+    if (button == LOFI_MOUSE_BUTTON_LEFT) {
+        m_Sculpting = false;
+        m_Map.EndStroke();
+    }
 }
 
 void Renderer::RestartMouse() {
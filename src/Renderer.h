@@ -10,9 +10,25 @@
 #include "Camera.h"
 #include "Serializer.h"
 #include "ResourceManager.h"
+#include "UniformBuffer.h"
 
 #include "glad/glad.h"
 
+//Contents of the FrameData block from res/shaders/frame.glsl (std140, so vec3 take 16 bytes)
+struct FrameUniforms {
+    glm::mat4 ViewProj;
+    glm::vec4 CameraPos, CameraFront;
+    //Frustum extents, see PerspectiveCamera::getFrustumExtents
+    glm::vec4 BotLeft, BotRight, TopLeft, TopRight;
+    glm::vec4 SunDir, SunCol;
+};
+
+//Contents of the MapData block from res/shaders/frame.glsl
+struct MapUniforms {
+    float ScaleXZ, ScaleY;
+    float Padding[2];
+};
+
 class Renderer {
 public:
     Renderer(unsigned int width, unsigned int height);
@@ -24,7 +40,14 @@ public:
         int HeightRes = 4096;
         int ShadowRes = 2048;
         int MaterialRes = 1024;
-        int WrapType = GL_CLAMP_TO_BORDER;
+        int WrapType = GL_REPEAT;
+        ClipmapMode GeometryMode = ClipmapMode::Displaced;
+        bool OcclusionCulling = false;
+        //Terrain heights come from a heightmap stack following the camera
+        bool Unbounded = false;
+        int HeightStackRes = 1024;
+        //Heightmap procedures run on the cpu (see CpuProcedures.h)
+        bool CpuProcedures = false;
     };
 
     void InitImGuiIniHandler();
@@ -34,16 +57,28 @@ public:
     void OnRender();
     void OnImGuiRender();
 
+    //Used by the headless benchmark, world is loaded after Init
+    void LoadWorld(const std::filesystem::path& path);
+    void SetCameraPose(const glm::vec3& pos, float yaw, float pitch);
+    //See MapGenerator::ValidateCpuProcedures
+    float ValidateCpuProcedures();
+
     void OnWindowResize(unsigned int width, unsigned int height);
     void OnKeyPressed(int keycode, bool repeat);
     void OnKeyReleased(int keycode);
     void OnMouseMoved(float x, float y);
     void OnMousePressed(int button, int mods);
+    void OnMouseReleased(int button, int mods);
     void RestartMouse();
 private:
+    //Fills the per-frame/per-map uniform blocks, after camera, sun and scales are final for the frame
+    void UpdateSharedUniforms();
 
     bool m_Wireframe = false;
 
+    //Left mouse button is held down outside of ImGui windows
+    bool m_Sculpting = false;
+
     //Show menu window flags
     //To-do: In practice using this is somewhat ugly, 
     // may switch to map<string, bool> or something like that
@@ -69,4 +104,7 @@ private:
     TerrainRenderer m_TerrainRenderer;
     GrassRenderer m_GrassRenderer;
     SkyRenderer m_SkyRenderer;
+
+    UniformRingBuffer m_FrameBuffer{ 1, sizeof(FrameUniforms) };
+    UniformRingBuffer m_MapBuffer{ 2, sizeof(MapUniforms) };
 };
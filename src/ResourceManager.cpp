@@ -5,6 +5,10 @@
 #include "imgui.h"
 #include "ImGuiUtils.h"
 
+#include "Profiler.h"
+
+#include <algorithm>
+
 ResourceManager::ResourceManager()
 	: m_Tex2DPrevShader("res/shaders/debug/texture2d_preview.glsl")
 	, m_CubePrevShader("res/shaders/debug/cubemap_preview.glsl")
@@ -30,39 +34,151 @@ std::shared_ptr<ComputeShader> ResourceManager::RequestComputeShader(const std::
 	return std::dynamic_pointer_cast<ComputeShader>(m_ShaderCache.back());
 }
 
+std::vector<Shader*> ResourceManager::getShaders()
+{
+	std::vector<Shader*> shaders{ &m_Tex2DPrevShader, &m_CubePrevShader, &m_3DPrevShader };
+
+	for (auto& shader : m_ShaderCache)
+		shaders.push_back(shader.get());
+
+	return shaders;
+}
+
+void ResourceManager::SubmitShaderBuilds()
+{
+	for (auto shader : getShaders())
+	{
+		if (shader->IsBuildPending())
+			shader->SubmitBuild(true);
+	}
+}
+
+void ResourceManager::FinishShaderBuilds()
+{
+	//Everything is submitted before the first status query, so that the driver can compile in parallel
+	SubmitShaderBuilds();
+
+	for (auto shader : getShaders())
+	{
+		if (shader->IsBuildPending())
+			shader->FinishBuild();
+	}
+}
+
 void ResourceManager::ReloadShaders()
 {
+	//Reloading is meant for edited shaders, so embedded sources aren't used from now on
+	SetEmbeddedShaderSources(false);
 	m_ReloadShaders = true;
 }
 
-std::shared_ptr<Texture2D> ResourceManager::RequestTexture2D()
+void ResourceManager::UpdateShaderReload()
+{
+	bool complete = true;
+
+	for (auto& shader : m_ShaderCache)
+	{
+		//Shaders without a linked program finish on their own when bound
+		if (shader->IsBuildPending())
+			complete &= shader->SubmitBuild(false);
+	}
+
+	if (!complete)
+		return;
+
+	for (auto& shader : m_ShaderCache)
+	{
+		if (shader->IsBuildPending())
+			complete &= shader->IsBuildComplete();
+	}
+
+	if (!complete)
+		return;
+
+	for (auto& shader : m_ShaderCache)
+	{
+		if (shader->IsBuildPending())
+			shader->FinishBuild();
+	}
+
+	m_ShaderGeneration++;
+	m_ReloadingShaders = false;
+}
+
+std::shared_ptr<Texture2D> ResourceManager::RequestTexture2D(const std::string& subsystem)
 {
 	m_Texture2DCache.push_back(std::make_shared<Texture2D>());
+	m_MemoryChanged = true;
+	m_TextureTags.emplace_back(subsystem, m_Texture2DCache.back());
 	return m_Texture2DCache.back();
 }
 
-std::shared_ptr<Texture3D> ResourceManager::RequestTexture3D()
+std::shared_ptr<Texture3D> ResourceManager::RequestTexture3D(const std::string& subsystem)
 {
 	m_Texture3DCache.push_back(std::make_shared<Texture3D>());
+	m_MemoryChanged = true;
+	m_TextureTags.emplace_back(subsystem, m_Texture3DCache.back());
 	return m_Texture3DCache.back();
 }
 
-std::shared_ptr<TextureArray> ResourceManager::RequestTextureArray()
+std::shared_ptr<TextureArray> ResourceManager::RequestTextureArray(const std::string& subsystem)
 {
 	m_TextureArrayCache.push_back(std::make_shared<TextureArray>());
+	m_MemoryChanged = true;
+	m_TextureTags.emplace_back(subsystem, m_TextureArrayCache.back());
 	return m_TextureArrayCache.back();
 }
 
-std::shared_ptr<Cubemap> ResourceManager::RequestCubemap()
+std::shared_ptr<Cubemap> ResourceManager::RequestCubemap(const std::string& subsystem)
 {
 	m_CubemapCache.push_back(std::make_shared<Cubemap>());
+	m_MemoryChanged = true;
+	m_TextureTags.emplace_back(subsystem, m_CubemapCache.back());
 	return m_CubemapCache.back();
 }
 
+void ResourceManager::RegisterBufferSource(const std::string& subsystem, std::function<size_t()> source)
+{
+	m_BufferSources.emplace_back(subsystem, std::move(source));
+	m_MemoryChanged = true;
+}
+
+std::vector<MemoryUsage> ResourceManager::GetMemoryUsage() const
+{
+	std::vector<MemoryUsage> usage;
+
+	auto GetEntry = [&usage](const std::string& subsystem) -> MemoryUsage&
+	{
+		auto it = std::find_if(usage.begin(), usage.end(),
+			[&subsystem](const MemoryUsage& entry) {return entry.Subsystem == subsystem; });
+
+		if (it != usage.end())
+			return *it;
+
+		usage.push_back(MemoryUsage{ subsystem });
+		return usage.back();
+	};
+
+	for (const auto& [subsystem, texture] : m_TextureTags)
+	{
+		if (auto ptr = texture.lock())
+			GetEntry(subsystem).TextureBytes += ptr->getMemoryUsage();
+	}
+
+	for (const auto& [subsystem, source] : m_BufferSources)
+		GetEntry(subsystem).BufferBytes += source();
+
+	GetEntry("Texture Browser").TextureBytes += m_PreviewTexture.getMemoryUsage();
+
+	return usage;
+}
+
 void ResourceManager::DrawTextureBrowser(bool& open)
 {
 	ImGui::Begin("Texture Browser", &open);
 
+	DrawMemoryUsage();
+
 	std::shared_ptr<Texture> tmp_ptr;
 
 	static int tex_id = 0, tex_arr_id = 0, cube_id = 0, tex3d_id = 0;
@@ -88,6 +204,8 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 
 			ImGuiUtils::ColSliderInt("Texture ID", &tex_id, 0, max_id);
 
+			//Cache may have shrunk since the last frame
+			tex_id = std::min(tex_id, max_id);
 			tmp_ptr = m_Texture2DCache.at(tex_id);
 			break;
 		}
@@ -98,6 +216,8 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 			ImGuiUtils::ColSliderInt("Texture ID", &tex_arr_id, 0, max_id);
 			ImGuiUtils::ColSliderInt("Texture layer", &arr_layer, 0, 8);
 
+			//Cache may have shrunk since the last frame
+			tex_arr_id = std::min(tex_arr_id, max_id);
 			tmp_ptr = m_TextureArrayCache.at(tex_arr_id);
 			break;
 		}
@@ -115,6 +235,8 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 
 			ImGuiUtils::Combo("Selected side", side_names, cube_side);
 
+			//Cache may have shrunk since the last frame
+			cube_id = std::min(cube_id, max_id);
 			tmp_ptr = m_CubemapCache.at(cube_id);
 			break;
 		}
@@ -125,6 +247,8 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 			ImGuiUtils::ColSliderInt("Texture ID", &tex3d_id, 0, max_id);
 			ImGuiUtils::ColSliderFloat("Depth", &depth_3d, 0.0, 1.0);
 
+			//Cache may have shrunk since the last frame
+			tex3d_id = std::min(tex3d_id, max_id);
 			tmp_ptr = m_Texture3DCache.at(tex3d_id);
 			break;
 		}
@@ -150,6 +274,9 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 
 	ImGui::Columns(1, "###col");
 
+	if (tmp_ptr)
+		ImGui::Text("Selected texture: %.2f MiB", double(tmp_ptr->getMemoryUsage()) / (1024.0 * 1024.0));
+
 	ImGui::BeginChild("#Texture browser display", ImVec2(0.0f, 0.0f), true, ImGuiWindowFlags_HorizontalScrollbar);
 
 	const auto avail_region = ImGui::GetContentRegionAvail();
@@ -186,18 +313,72 @@ void ResourceManager::DrawTextureBrowser(bool& open)
 	}
 }
 
+void ResourceManager::DrawMemoryUsage()
+{
+	if (!ImGui::CollapsingHeader("Memory usage"))
+		return;
+
+	const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+
+	if (!ImGui::BeginTable("Memory usage", 4, flags))
+		return;
+
+	auto ToMiB = [](size_t bytes) {return double(bytes) / (1024.0 * 1024.0); };
+
+	auto DrawRow = [&ToMiB](const std::string& name, size_t textures, size_t buffers)
+	{
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", ToMiB(textures));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", ToMiB(buffers));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", ToMiB(textures + buffers));
+	};
+
+	ImGui::TableSetupColumn("Subsystem");
+	ImGui::TableSetupColumn("Textures [MiB]");
+	ImGui::TableSetupColumn("Buffers [MiB]");
+	ImGui::TableSetupColumn("Total [MiB]");
+	ImGui::TableHeadersRow();
+
+	size_t total_textures = 0, total_buffers = 0;
+
+	for (const auto& entry : GetMemoryUsage())
+	{
+		DrawRow(entry.Subsystem, entry.TextureBytes, entry.BufferBytes);
+
+		total_textures += entry.TextureBytes;
+		total_buffers += entry.BufferBytes;
+	}
+
+	DrawRow("Total", total_textures, total_buffers);
+
+	ImGui::EndTable();
+}
+
 void ResourceManager::OnUpdate()
 {
+	ReleaseUnusedTextures();
+	UpdateMemoryCounters();
+
 	if (m_ReloadShaders)
 	{
+		//Previous programs stay in use until all new ones are linked
 		for (auto& shader : m_ShaderCache)
 		{
-			shader->Reload();
+			shader->StartBuild();
 		}
 
 		m_ReloadShaders = false;
+		m_ReloadingShaders = true;
 	}
 
+	if (m_ReloadingShaders)
+		UpdateShaderReload();
+
 	if (m_UpdatePreview)
 	{
 		UpdatePreview();
@@ -205,6 +386,54 @@ void ResourceManager::OnUpdate()
 	}
 }
 
+//Textures of removed owners (e.g. stages of deleted procedure instances) would otherwise live forever
+void ResourceManager::ReleaseUnusedTextures()
+{
+	auto Release = [this](auto& cache)
+	{
+		auto it = std::remove_if(cache.begin(), cache.end(),
+			[](const auto& texture) {return texture.use_count() == 1; });
+
+		if (it != cache.end())
+			m_MemoryChanged = true;
+
+		cache.erase(it, cache.end());
+	};
+
+	Release(m_Texture2DCache);
+	Release(m_TextureArrayCache);
+	Release(m_CubemapCache);
+	Release(m_Texture3DCache);
+
+	m_TextureTags.erase(std::remove_if(m_TextureTags.begin(), m_TextureTags.end(),
+		[](const auto& entry) {return entry.second.expired(); }), m_TextureTags.end());
+}
+
+//Totals are forwarded to the profiler, so that they end up in captures. Counters keep their
+//values, so they are only recomputed once textures or buffer sizes change.
+void ResourceManager::UpdateMemoryCounters()
+{
+	size_t buffer_bytes = 0;
+
+	for (const auto& [subsystem, source] : m_BufferSources)
+		buffer_bytes += source();
+
+	if (!m_MemoryChanged && m_TextureAllocations == Texture::getAllocationCount() && m_BufferBytes == buffer_bytes)
+		return;
+
+	m_MemoryChanged = false;
+	m_TextureAllocations = Texture::getAllocationCount();
+	m_BufferBytes = buffer_bytes;
+
+	static const std::string track = "GPU memory [MiB]";
+
+	for (const auto& entry : GetMemoryUsage())
+	{
+		const double mib = double(entry.TextureBytes + entry.BufferBytes) / (1024.0 * 1024.0);
+		Profiler::SetCounter(track, entry.Subsystem, mib);
+	}
+}
+
 void ResourceManager::UpdatePreview()
 {
 	m_PreviewTexture.BindImage(0, 0);
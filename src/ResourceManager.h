@@ -4,6 +4,13 @@
 #include "Texture.h"
 
 #include <memory>
+#include <functional>
+
+//Gpu memory of a single subsystem, in bytes
+struct MemoryUsage {
+	std::string Subsystem;
+	size_t TextureBytes = 0, BufferBytes = 0;
+};
 
 class ResourceManager {
 public:
@@ -12,12 +19,29 @@ public:
 	std::shared_ptr<VertFragShader> RequestVertFragShader(const std::string& v_path, const std::string& f_path);
 	std::shared_ptr<ComputeShader>  RequestComputeShader(const std::string& path);
 
-	std::shared_ptr<Texture2D>    RequestTexture2D();
-	std::shared_ptr<Texture3D>    RequestTexture3D();
-	std::shared_ptr<TextureArray> RequestTextureArray();
-	std::shared_ptr<Cubemap>      RequestCubemap();
+	//Subsystem tag is only used for memory accounting. Textures no longer referenced
+	//outside of the manager are released in OnUpdate.
+	std::shared_ptr<Texture2D>    RequestTexture2D(const std::string& subsystem = "Other");
+	std::shared_ptr<Texture3D>    RequestTexture3D(const std::string& subsystem = "Other");
+	std::shared_ptr<TextureArray> RequestTextureArray(const std::string& subsystem = "Other");
+	std::shared_ptr<Cubemap>      RequestCubemap(const std::string& subsystem = "Other");
+
+	//Buffers aren't owned by the manager, so their owners report sizes (in bytes) through a callback.
+	//Owner has to outlive the manager's last GetMemoryUsage call.
+	void RegisterBufferSource(const std::string& subsystem, std::function<size_t()> source);
+
+	//Totals per subsystem, in order of first registration
+	std::vector<MemoryUsage> GetMemoryUsage() const;
+
+	//Shaders are built asynchronously (see Shader). Submit starts compiling all requested shaders,
+	//Finish also waits until they are linked, shaders not finished this way are finished on first use
+	void SubmitShaderBuilds();
+	void FinishShaderBuilds();
 
+	//New programs are swapped in once all of them are linked, without blocking the frame
 	void ReloadShaders();
+	//Incremented by every reload, so that owners of shaders generated at runtime can regenerate them
+	size_t getShaderGeneration() const { return m_ShaderGeneration; }
 	void DrawTextureBrowser(bool& open);
 	void OnUpdate();
 
@@ -35,7 +59,13 @@ public:
 	}
 
 private:
+	void UpdateShaderReload();
+	std::vector<Shader*> getShaders();
+
 	void UpdatePreview();
+	void DrawMemoryUsage();
+	void ReleaseUnusedTextures();
+	void UpdateMemoryCounters();
 
 	std::vector<std::shared_ptr<Shader>> m_ShaderCache;
 
@@ -44,7 +74,15 @@ private:
 	std::vector<std::shared_ptr<Cubemap>>      m_CubemapCache;
 	std::vector<std::shared_ptr<Texture3D>>    m_Texture3DCache;
 
-	bool m_ReloadShaders = false, m_UpdatePreview = false;
+	std::vector<std::pair<std::string, std::weak_ptr<Texture>>>  m_TextureTags;
+	std::vector<std::pair<std::string, std::function<size_t()>>>  m_BufferSources;
+
+	//State of the last totals forwarded to the profiler
+	bool m_MemoryChanged = true;
+	size_t m_TextureAllocations = 0, m_BufferBytes = 0;
+
+	bool m_ReloadShaders = false, m_ReloadingShaders = false, m_UpdatePreview = false;
+	size_t m_ShaderGeneration = 0;
 
 	enum class PreviewType {
 		Texture2D, TextureArray, Cubemap, Texture3D
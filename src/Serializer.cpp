@@ -187,7 +187,10 @@ void Serializer::RenderFileBrowser(float lower_margin)
 
 void Serializer::Serialize()
 {
-    ProfilerCPUEvent we("Serializer::Serialize");
+    LOFI_PROFILE_CPU("Serializer::Serialize");
+
+    //Name may be padded with nulls (see m_MaxNameLength)
+    m_WorldPath = m_CurrentPath / m_Filename.c_str();
 
     nlohmann::ordered_json json;
 
@@ -205,23 +208,39 @@ void Serializer::Serialize()
     output << json.dump(indent);
 }
 
-void Serializer::Deserialize()
+void Serializer::LoadFromFile(const std::filesystem::path& path)
 {
-    ProfilerCPUEvent we("Serializer::Deserialize");
+    std::ifstream input(path);
 
+    if (!input)
+        throw std::runtime_error("Could not open world file:\n" + path.string());
+
+    m_WorldPath = path;
+    Deserialize(input);
+}
+
+void Serializer::Deserialize()
+{
     auto path = m_CurrentPath / m_Filename;
 
     std::ifstream input(path);
 
     if (input)
     {
-        auto json = nlohmann::ordered_json::parse(input);
-
-        for (auto& [key, value] : json.items())
-        {
-            if (m_LoadCallbacks.count(key))
-                m_LoadCallbacks[key](value); 
-        }
+        m_WorldPath = m_CurrentPath / m_Filename.c_str();
+        Deserialize(input);
     }
+}
+
+void Serializer::Deserialize(std::ifstream& input)
+{
+    LOFI_PROFILE_CPU("Serializer::Deserialize");
+
+    auto json = nlohmann::ordered_json::parse(input);
 
+    for (auto& [key, value] : json.items())
+    {
+        if (m_LoadCallbacks.count(key))
+            m_LoadCallbacks[key](value); 
+    }
 }
\ No newline at end of file
@@ -15,11 +15,18 @@ public:
 	void TriggerSave();
 	void TriggerLoad();
 
+	//Loads a world file directly, bypassing the popup.
+	//Throws std::runtime_error if file can't be opened
+	void LoadFromFile(const std::filesystem::path& path);
+
 	void OnImGui();
 
 	void RegisterLoadCallback(const std::string& token, std::function<void(nlohmann::ordered_json&)> callback);
 	void RegisterSaveCallback(const std::string& token, std::function<void(nlohmann::ordered_json&)> callback);
 
+	//World file currently being saved/loaded, for callbacks storing data next to it
+	const std::filesystem::path& getWorldPath() const { return m_WorldPath; }
+
 private:
 	void LoadPopup();
 	void SavePopup();
@@ -28,8 +35,9 @@ private:
 
 	void Serialize();
 	void Deserialize();
+	void Deserialize(std::ifstream& input);
 
-	std::filesystem::path m_CurrentPath;
+	std::filesystem::path m_CurrentPath, m_WorldPath;
 
 	bool m_LoadDialogOpen, m_SaveDialogOpen;
 	bool m_LoadToBeOpened, m_SaveToBeOpened;
@@ -2,73 +2,220 @@
 
 #include "glad/glad.h"
 
+#ifdef LOFI_EMBED_SHADERS
+#include "EmbeddedShaders.h"
+#endif
+
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <algorithm>
+#include <iomanip>
+#include <future>
+#include <chrono>
+#include <mutex>
+#include <atomic>
 
 #include <iostream>
 
-void Shader::Bind()
+//=====Parallel compilation=============================================
+
+//From GL_KHR_parallel_shader_compile (same values in the ARB version)
+#define LOFI_MAX_SHADER_COMPILER_THREADS 0x91B0
+#define LOFI_COMPLETION_STATUS 0x91B1
+
+typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+bool g_ParallelCompile = false;
+
+bool extensionSupported(const std::string& name)
 {
-    glUseProgram(m_ID);
+    int num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+    for (int i = 0; i < num_extensions; i++)
+    {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+
+        if (extension && name == extension)
+            return true;
+    }
+
+    return false;
 }
 
-void Shader::Reload() 
+void InitParallelShaderCompile(void* (*loader)(const char* name))
 {
-    //Release GL handle
-    glDeleteProgram(m_ID);
+    PFNMAXSHADERCOMPILERTHREADSPROC max_threads = nullptr;
+
+    if (extensionSupported("GL_KHR_parallel_shader_compile"))
+        max_threads = reinterpret_cast<PFNMAXSHADERCOMPILERTHREADSPROC>(loader("glMaxShaderCompilerThreadsKHR"));
+
+    else if (extensionSupported("GL_ARB_parallel_shader_compile"))
+        max_threads = reinterpret_cast<PFNMAXSHADERCOMPILERTHREADSPROC>(loader("glMaxShaderCompilerThreadsARB"));
 
-    //Reset member variables
-    m_ID = 0;
-    m_UniformCache.clear();
+    if (max_threads == nullptr)
+        return;
+
+    //Let the driver pick the number of threads
+    max_threads(0xFFFFFFFF);
+    g_ParallelCompile = true;
+}
+
+//=====Program binary cache=============================================
+
+std::filesystem::path g_ShaderCacheDirectory{ "shader_cache" };
+
+void SetShaderCacheDirectory(const std::string& directory)
+{
+    g_ShaderCacheDirectory = directory;
+}
 
-    //Rebuild
-    Build();
+bool programBinariesSupported()
+{
+    int num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+    return !g_ShaderCacheDirectory.empty() && num_formats > 0;
 }
 
-unsigned int Shader::getUniformLocation(const std::string& name)
+//Hash of the expanded sources of all stages, binaries are only valid for the driver that produced them
+std::string programCacheKey(const std::vector<std::string>& sources)
 {
-    auto search_res = std::find_if(
-        m_UniformCache.begin(), m_UniformCache.end(),
-        [&name](const std::pair<std::string, unsigned int> element)
+    static const std::string driver = []()
+    {
+        std::string res;
+
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
         {
-            return element.first == name;
+            const char* str = reinterpret_cast<const char*>(glGetString(name));
+            res += std::string(str ? str : "") + "\n";
         }
-    );
 
-    if (search_res != m_UniformCache.end())
-        return search_res->second;
+        return res;
+    }();
 
-    const unsigned int location = glGetUniformLocation(m_ID, name.c_str());
-    m_UniformCache.push_back(std::make_pair(name, location));
-    return location;
+    //64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+
+    auto Feed = [&hash](const std::string& str)
+    {
+        for (unsigned char c : str)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+
+        //Separator, so that moving text between stages changes the key
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+    };
+
+    Feed(driver);
+
+    for (const auto& source : sources)
+        Feed(source);
+
+    std::ostringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
 }
 
-//Program type is assumed to be gl enum: {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER}
-void compileShaderCode(const std::string& source, unsigned int& id, int program_type)
+//Returns 0 if there is no binary for the key or the driver rejected it
+unsigned int loadProgramBinary(const std::string& key)
 {
-    const char* source_c = source.c_str();
+    if (!programBinariesSupported())
+        return 0;
+
+    const auto filepath = g_ShaderCacheDirectory / (key + ".bin");
+
+    std::ifstream input{ filepath, std::ios::binary };
 
+    if (!input)
+        return 0;
+
+    GLenum format = 0;
+    input.read(reinterpret_cast<char*>(&format), sizeof(format));
+
+    std::vector<char> binary{ std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+    input.close();
+
+    int num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+    std::vector<int> formats(num_formats);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+    const bool known_format = std::find(formats.begin(), formats.end(), int(format)) != formats.end();
+
+    unsigned int id = 0;
     int success = 0;
-    char info_log[512];
 
-    id = glCreateShader(program_type);
+    if (known_format && !binary.empty())
+    {
+        id = glCreateProgram();
+        glProgramBinary(id, format, binary.data(), int(binary.size()));
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+    }
+
+    //Driver update or corrupted file, program will be rebuilt and saved again
+    if (!success)
+    {
+        if (id != 0)
+            glDeleteProgram(id);
+
+        std::error_code ec;
+        std::filesystem::remove(filepath, ec);
+
+        return 0;
+    }
+
+    return id;
+}
+
+void saveProgramBinary(unsigned int id, const std::string& key)
+{
+    if (!programBinariesSupported())
+        return;
+
+    int length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
 
-    glShaderSource(id, 1, &source_c, NULL);
-    glCompileShader(id);
+    if (length <= 0)
+        return;
+
+    GLenum format = 0;
+    std::vector<char> binary(length);
+    glGetProgramBinary(id, length, nullptr, &format, binary.data());
 
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    std::error_code ec;
+    std::filesystem::create_directories(g_ShaderCacheDirectory, ec);
+
+    //Written under a temporary name, so that an interrupted write is never loaded
+    const auto filepath = g_ShaderCacheDirectory / (key + ".bin");
+    const auto tmp_path = g_ShaderCacheDirectory / (key + ".tmp");
 
-    if (!success) 
     {
-        glGetShaderInfoLog(id, 512, NULL, info_log);
-        glDeleteShader(id);
+        std::ofstream output{ tmp_path, std::ios::binary };
+
+        if (!output)
+        {
+            std::cerr << "Shader Cache Error: Could not write to " << tmp_path.string() << '\n';
+            return;
+        }
 
-        throw std::runtime_error(info_log);
+        output.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        output.write(binary.data(), binary.size());
     }
+
+    std::filesystem::rename(tmp_path, filepath, ec);
+
+    if (ec)
+        std::filesystem::remove(tmp_path, ec);
 }
 
+//======================================================================
+
 std::string loadSource(std::filesystem::path filepath, bool recursive_call = false)
 {
     const std::string include_token{"#include"};
@@ -111,129 +258,435 @@ std::string loadSource(std::filesystem::path filepath, bool recursive_call = fal
     return full_source;
 }
 
-void VertFragShader::Build()
+//Read from worker threads, see loadStages
+std::atomic<bool> g_EmbeddedSources{ true };
+
+void SetEmbeddedShaderSources(bool enabled)
+{
+    g_EmbeddedSources = enabled;
+}
+
+#ifdef LOFI_EMBED_SHADERS
+//Null if the file wasn't embedded
+const std::string* findEmbeddedSource(const std::string& filepath)
+{
+    static const std::unordered_map<std::string, std::string> sources = []() {
+        std::unordered_map<std::string, std::string> res;
+
+        for (auto shader = g_EmbeddedShaders; shader->Path != nullptr; shader++)
+        {
+            std::string& source = res[shader->Path];
+
+            for (auto chunk = shader->Chunks; *chunk != nullptr; chunk++)
+                source += *chunk;
+        }
+
+        return res;
+    }();
+
+    const std::string key = std::filesystem::path(filepath).lexically_normal().generic_string();
+
+    auto it = sources.find(key);
+    return (it != sources.end()) ? &it->second : nullptr;
+}
+#endif
+
+std::string LoadShaderSource(const std::string& filepath)
 {
-    //Get source
+#ifdef LOFI_EMBED_SHADERS
+    if (g_EmbeddedSources)
+    {
+        if (auto source = findEmbeddedSource(filepath))
+            return *source;
+    }
+#endif
+
     std::filesystem::path current_path{ std::filesystem::current_path() };
+    return loadSource(current_path / filepath);
+}
+
+//=====Asynchronous building============================================
 
-    std::string vert_code = loadSource(current_path / m_VertPath);
-    std::string frag_code = loadSource(current_path / m_FragPath);
+struct PendingBuild {
+    std::future<std::vector<ShaderStage>> Loading;
+    std::vector<ShaderStage> Stages;
+    std::exception_ptr Error;
 
-    //Compile shaders
-    unsigned int vert_id = 0, frag_id = 0;
+    std::string CacheKey;
+    unsigned int Program = 0;
+    std::vector<unsigned int> StageIDs;
 
-    try 
+    bool Submitted = false, FromCache = false;
+
+    ~PendingBuild()
     {
-        compileShaderCode(vert_code, vert_id, GL_VERTEX_SHADER);
+        if (Loading.valid())
+            Loading.wait();
+
+        for (auto id : StageIDs)
+            glDeleteShader(id);
+
+        glDeleteProgram(Program);
     }
+};
 
-    catch (const std::runtime_error& e) 
+//Doesn't touch gl state, so it may run on any thread
+std::vector<ShaderStage> loadStages(std::vector<ShaderStage> stages)
+{
+    for (auto& stage : stages)
     {
-        std::cerr << "Vertex Shader compilation failed: \n"
-                  << "filepath: " << m_VertPath << '\n'
-                  << e.what() << '\n';
-        return;
+        if (stage.Source.empty())
+            stage.Source = LoadShaderSource(stage.Path);
+    }
+
+    return stages;
+}
+
+std::string stageName(unsigned int type)
+{
+    switch (type)
+    {
+        case GL_VERTEX_SHADER:   return "Vertex Shader";
+        case GL_FRAGMENT_SHADER: return "Fragment Shader";
+        case GL_COMPUTE_SHADER:  return "Compute Shader";
     }
 
-    try 
+    return "Shader";
+}
+
+Shader::~Shader() {}
+
+void Shader::Bind()
+{
+    //Never linked yet, so there is nothing else to use
+    if (m_ID == 0 && m_Build)
+        FinishBuild();
+
+    glUseProgram(m_ID);
+}
+
+void Shader::Reload() 
+{
+    StartBuild();
+    FinishBuild();
+}
+
+bool Shader::IsValid()
+{
+    if (m_Build)
+        FinishBuild();
+
+    return m_ID != 0;
+}
+
+void Shader::StartBuild()
+{
+    //Replaces (and waits for) a build that is still in progress
+    m_Build = std::make_unique<PendingBuild>();
+    m_Build->Loading = std::async(std::launch::async, loadStages, m_Stages);
+}
+
+bool Shader::SubmitBuild(bool wait)
+{
+    auto& build = *m_Build;
+
+    if (build.Submitted)
+        return true;
+
+    if (!wait && build.Loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    build.Submitted = true;
+
+    try
     {
-        compileShaderCode(frag_code, frag_id, GL_FRAGMENT_SHADER);
+        build.Stages = build.Loading.get();
     }
 
-    catch (const std::runtime_error& e) 
+    catch (...)
     {
-        std::cerr << "Fragment Shader compilation failed: \n"
-                  << "filepath: " << m_FragPath << '\n'
-                  << e.what() << '\n';
-        return;
+        build.Error = std::current_exception();
+        return true;
     }
 
-    //Link program
-    m_ID = glCreateProgram();
+    std::vector<std::string> sources;
 
-    glAttachShader(m_ID, vert_id);
-    glAttachShader(m_ID, frag_id);
-    glLinkProgram(m_ID);
+    for (const auto& stage : build.Stages)
+        sources.push_back(stage.Source);
 
-    int success = 0;
-    char info_log[512];
+    build.CacheKey = programCacheKey(sources);
+    build.Program = loadProgramBinary(build.CacheKey);
 
-    glGetProgramiv(m_ID, GL_LINK_STATUS, &success);
+    if (build.Program != 0)
+    {
+        build.FromCache = true;
+        return true;
+    }
 
-    if (!success) 
+    //Only submits the work, status is queried in FinishBuild
+    for (const auto& stage : build.Stages)
     {
-        glGetProgramInfoLog(m_ID, 512, NULL, info_log);
+        const char* source_c = stage.Source.c_str();
 
-        std::cerr << "Error: Shader program linking failed: \n"
-                  << "filepaths: " << m_VertPath << ", " << m_FragPath << '\n'
-                  << info_log << '\n';
+        const unsigned int id = glCreateShader(stage.Type);
+        glShaderSource(id, 1, &source_c, NULL);
+        glCompileShader(id);
+
+        build.StageIDs.push_back(id);
     }
 
-    glDeleteShader(vert_id);
-    glDeleteShader(frag_id);
+    build.Program = glCreateProgram();
+
+    for (auto id : build.StageIDs)
+        glAttachShader(build.Program, id);
+
+    glProgramParameteri(build.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(build.Program);
+
+    return true;
 }
 
-VertFragShader::VertFragShader(const std::string& vert_path, const std::string& frag_path) 
-    : m_VertPath(vert_path), m_FragPath(frag_path)
+bool Shader::IsBuildComplete() const
 {
-    Build();
+    if (!m_Build->Submitted)
+        return false;
+
+    //Without the extension there is no way to tell, so FinishBuild will block
+    if (m_Build->Program == 0 || m_Build->FromCache || !g_ParallelCompile)
+        return true;
+
+    int complete = 0;
+    glGetProgramiv(m_Build->Program, LOFI_COMPLETION_STATUS, &complete);
+
+    return complete;
 }
 
-VertFragShader::~VertFragShader() 
+void Shader::FinishBuild()
 {
+    SubmitBuild(true);
+
+    auto build = std::move(m_Build);
+
+    if (build->Error)
+    {
+        //Missing files at startup are fatal, same as before building was asynchronous
+        if (m_ID == 0)
+            std::rethrow_exception(build->Error);
+
+        try
+        {
+            std::rethrow_exception(build->Error);
+        }
+
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: Loading shader sources failed: \n" << e.what() << '\n';
+        }
+
+        return;
+    }
+
+    bool success = build->FromCache;
+
+    if (!success)
+    {
+        int status = 0;
+        char info_log[512];
+
+        success = true;
+
+        for (size_t i = 0; i < build->StageIDs.size(); i++)
+        {
+            glGetShaderiv(build->StageIDs[i], GL_COMPILE_STATUS, &status);
+
+            if (!status)
+            {
+                glGetShaderInfoLog(build->StageIDs[i], 512, NULL, info_log);
+
+                std::cerr << stageName(build->Stages[i].Type) << " compilation failed: \n"
+                          << "filepath: " << build->Stages[i].Path << '\n'
+                          << info_log << '\n';
+
+                success = false;
+            }
+        }
+
+        if (success)
+        {
+            glGetProgramiv(build->Program, GL_LINK_STATUS, &status);
+
+            if (!status)
+            {
+                glGetProgramInfoLog(build->Program, 512, NULL, info_log);
+
+                std::cerr << "Error: Shader program linking failed: \n" << "filepaths:";
+
+                for (const auto& stage : build->Stages)
+                    std::cerr << ' ' << stage.Path;
+
+                std::cerr << '\n' << info_log << '\n';
+
+                success = false;
+            }
+        }
+
+        if (success)
+            saveProgramBinary(build->Program, build->CacheKey);
+    }
+
+    //Previous program (if any) stays in use
+    if (!success)
+        return;
+
     glDeleteProgram(m_ID);
+
+    m_ID = build->Program;
+    build->Program = 0;
+
+    BuildUniformTable();
+
+    OnBuilt(build->Stages);
 }
 
-void ComputeShader::Build() 
+//=====Uniform locations================================================
+
+struct UniformNames {
+    std::mutex Mutex;
+    std::unordered_map<std::string, unsigned int> IDs;
+    std::vector<std::string> Names;
+};
+
+//Function local, so that handles may be constructed during static initialization
+UniformNames& getUniformNames()
 {
-    //Get source
-    std::filesystem::path current_path{ std::filesystem::current_path() };
-    std::string compute_code = loadSource(current_path / m_ComputePath);
+    static UniformNames names;
+    return names;
+}
 
-    //Initialize local sizes
-    RetrieveLocalSizes(compute_code);
+unsigned int InternUniformName(const std::string& name)
+{
+    auto& names = getUniformNames();
+    std::lock_guard<std::mutex> lock(names.Mutex);
 
-    //Compile shader
-    unsigned int compute_id = 0;
+    auto [it, inserted] = names.IDs.emplace(name, unsigned(names.Names.size()));
 
-    try 
-    {
-        compileShaderCode(compute_code, compute_id, GL_COMPUTE_SHADER);
-    }
+    if (inserted)
+        names.Names.push_back(name);
+
+    return it->second;
+}
+
+//Location marking ids which weren't looked up since the last link
+const int g_UnresolvedLocation = -2;
+
+void Shader::BuildUniformTable()
+{
+    m_UniformTable.clear();
+    m_HandleLocations.clear();
+
+    int count = 0, max_length = 0;
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::vector<char> name_c(max_length + 1);
 
-    catch (const std::runtime_error& e) 
+    for (int i = 0; i < count; i++)
     {
-        std::cerr << "Compute Shader compilation failed: \n"
-                  << "filepath: " << m_ComputePath << '\n'
-                  << e.what() << '\n';
-        return;
+        int length = 0;
+        glGetActiveUniformName(m_ID, i, max_length + 1, &length, name_c.data());
+
+        const std::string name(name_c.data(), length);
+        const int location = glGetUniformLocation(m_ID, name_c.data());
+
+        //Members of uniform blocks have no location
+        if (location < 0)
+            continue;
+
+        m_UniformTable[name] = location;
+
+        //Arrays are reported as their first element
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            m_UniformTable[name.substr(0, name.size() - 3)] = location;
     }
+}
 
-    //Link program
-    m_ID = glCreateProgram();
-    glAttachShader(m_ID, compute_id);
-    glLinkProgram(m_ID);
+int Shader::getUniformLocation(const std::string& name)
+{
+    auto it = m_UniformTable.find(name);
 
-    int success = 0;
-    char info_log[512];
+    if (it != m_UniformTable.end())
+        return it->second;
 
-    glGetProgramiv(m_ID, GL_LINK_STATUS, &success);
-    
-    if (!success) 
+    //Inactive uniforms and array elements other than the first
+    const int location = glGetUniformLocation(m_ID, name.c_str());
+    m_UniformTable[name] = location;
+    return location;
+}
+
+int Shader::getUniformLocation(unsigned int id)
+{
+    if (id >= m_HandleLocations.size())
+        m_HandleLocations.resize(id + 1, g_UnresolvedLocation);
+
+    if (m_HandleLocations[id] == g_UnresolvedLocation)
     {
-        glGetProgramInfoLog(m_ID, 512, NULL, info_log);
-        std::cerr << "Error: Shader program linking failed: \n"
-                  << "filepath: " << m_ComputePath << '\n'
-                  << info_log << '\n';
+        auto& names = getUniformNames();
+        std::string name;
+
+        {
+            std::lock_guard<std::mutex> lock(names.Mutex);
+            name = names.Names[id];
+        }
+
+        m_HandleLocations[id] = getUniformLocation(name);
     }
 
-    glDeleteShader(compute_id);
+    return m_HandleLocations[id];
+}
+
+int Shader::getBlockMemberOffset(const std::string& name)
+{
+    const char* name_c = name.c_str();
+
+    unsigned int index = GL_INVALID_INDEX;
+    glGetUniformIndices(m_ID, 1, &name_c, &index);
+
+    if (index == GL_INVALID_INDEX)
+        return -1;
+
+    int offset = -1;
+    glGetActiveUniformsiv(m_ID, 1, &index, GL_UNIFORM_OFFSET, &offset);
+
+    return offset;
+}
+
+VertFragShader::VertFragShader(const std::string& vert_path, const std::string& frag_path) 
+{
+    m_Stages.push_back(ShaderStage{ GL_VERTEX_SHADER, vert_path, "" });
+    m_Stages.push_back(ShaderStage{ GL_FRAGMENT_SHADER, frag_path, "" });
+
+    StartBuild();
+}
+
+VertFragShader::~VertFragShader() 
+{
+    glDeleteProgram(m_ID);
 }
 
 ComputeShader::ComputeShader(const std::string& compute_path) 
     : m_ComputePath(compute_path)
 {
-    Build();
+    m_Stages.push_back(ShaderStage{ GL_COMPUTE_SHADER, compute_path, "" });
+
+    StartBuild();
+}
+
+ComputeShader::ComputeShader(const std::string& name, const std::string& source)
+    : m_ComputePath(name)
+{
+    m_Stages.push_back(ShaderStage{ GL_COMPUTE_SHADER, name, source });
+
+    StartBuild();
 }
 
 ComputeShader::~ComputeShader() 
@@ -241,6 +694,12 @@ ComputeShader::~ComputeShader()
     glDeleteProgram(m_ID);
 }
 
+void ComputeShader::OnBuilt(const std::vector<ShaderStage>& stages)
+{
+    //Initialize local sizes
+    RetrieveLocalSizes(stages.front().Source);
+}
+
 void ComputeShader::Dispatch(uint32_t size_x, uint32_t size_y, uint32_t size_z)
 {
     //We need to take ceilings of the divisions here since for example 33 invocations with 
@@ -311,83 +770,121 @@ void ComputeShader::RetrieveLocalSizes(const std::string& source_code)
 //=====Uniform setting==================================================
 
 void Shader::setUniform1i(const std::string& name, int x) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform1i(location, x);
 }
 
 void Shader::setUniform2i(const std::string& name, int x, int y) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform2i(location, x, y);
 }
 
 void Shader::setUniform3i(const std::string& name, int x, int y, int z) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform3i(location, x, y, z);
 }
 
 void Shader::setUniform4i(const std::string& name, int x, int y, int z, int w) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform4i(location, x, y, z, w);
 }
 
 void Shader::setUniform1f(const std::string& name, float x) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform1f(location, x);
 }
 
 void Shader::setUniform2f(const std::string& name, float x, float y) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform2f(location, x, y);
 }
 
 void Shader::setUniform3f(const std::string& name, float x, float y, float z) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform3f(location, x, y, z);
 }
 
 void Shader::setUniform4f(const std::string& name, float x, float y, float z, float w) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform4f(location, x, y, z, w);
 }
 
 void Shader::setUniformMatrix4fv(const std::string& name, float data[16]) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniformMatrix4fv(location, 1, GL_FALSE, data);
 }
 
 //=====GLM overrides===================================================
 
 void Shader::setUniform2i(const std::string& name, glm::ivec2 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform2i(location, v.x, v.y);
 }
 
 void Shader::setUniform3i(const std::string& name, glm::ivec3 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform3i(location, v.x, v.y, v.z);
 }
 
 void Shader::setUniform4i(const std::string& name, glm::ivec4 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform4i(location, v.x, v.y, v.z, v.w);
 }
 
 void Shader::setUniform2f(const std::string& name, glm::vec2 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform2f(location, v.x, v.y);
 }
 
 void Shader::setUniform3f(const std::string& name, glm::vec3 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform3f(location, v.x, v.y, v.z);
 }
 
 void Shader::setUniform4f(const std::string& name, glm::vec4 v) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniform4f(location, v.x, v.y, v.z, v.w);
 }
 
 void Shader::setUniformMatrix4fv(const std::string& name, glm::mat4 mat) {
-    const unsigned int location = getUniformLocation(name.c_str());
+    const int location = getUniformLocation(name);
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
-}
\ No newline at end of file
+}
+
+//=====Handle overrides================================================
+
+void Shader::setUniform(const Uniform<int>& u, int x) {
+    glUniform1i(getUniformLocation(u.getID()), x);
+}
+
+void Shader::setUniform(const Uniform<float>& u, float x) {
+    glUniform1f(getUniformLocation(u.getID()), x);
+}
+
+void Shader::setUniform(const Uniform<glm::ivec2>& u, glm::ivec2 v) {
+    glUniform2i(getUniformLocation(u.getID()), v.x, v.y);
+}
+
+void Shader::setUniform(const Uniform<glm::ivec3>& u, glm::ivec3 v) {
+    glUniform3i(getUniformLocation(u.getID()), v.x, v.y, v.z);
+}
+
+void Shader::setUniform(const Uniform<glm::ivec4>& u, glm::ivec4 v) {
+    glUniform4i(getUniformLocation(u.getID()), v.x, v.y, v.z, v.w);
+}
+
+void Shader::setUniform(const Uniform<glm::vec2>& u, glm::vec2 v) {
+    glUniform2f(getUniformLocation(u.getID()), v.x, v.y);
+}
+
+void Shader::setUniform(const Uniform<glm::vec3>& u, glm::vec3 v) {
+    glUniform3f(getUniformLocation(u.getID()), v.x, v.y, v.z);
+}
+
+void Shader::setUniform(const Uniform<glm::vec4>& u, glm::vec4 v) {
+    glUniform4f(getUniformLocation(u.getID()), v.x, v.y, v.z, v.w);
+}
+
+void Shader::setUniform(const Uniform<glm::mat4>& u, glm::mat4 mat) {
+    glUniformMatrix4fv(getUniformLocation(u.getID()), 1, GL_FALSE, glm::value_ptr(mat));
+}
@@ -6,12 +6,76 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <unordered_map>
 
+//Reads shader source (path relative to the working directory), resolving #include directives.
+//Sources under res/shaders are taken from the executable if they were embedded at build time.
+std::string LoadShaderSource(const std::string& filepath);
+
+//Disabling embedded sources makes LoadShaderSource read all files from disk, so that edited shaders
+//can be hot reloaded. Has no effect in builds without LOFI_EMBED_SHADERS (always read from disk).
+void SetEmbeddedShaderSources(bool enabled);
+
+//Linked programs are saved to (and loaded from) this directory, keyed by a hash of their expanded sources
+//and the driver, so that unchanged shaders aren't recompiled on the next start. Empty path disables the cache.
+void SetShaderCacheDirectory(const std::string& directory);
+
+//Lets the driver compile on multiple threads if it supports GL_KHR/ARB_parallel_shader_compile
+//(not part of the glad loader), loader is the same function glad was initialized with
+void InitParallelShaderCompile(void* (*loader)(const char* name));
+
+//Type is gl enum: {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER}.
+//Empty source is read from the path, otherwise path is only used in error messages
+struct ShaderStage {
+    unsigned int Type;
+    std::string Path, Source;
+};
+
+struct PendingBuild;
+
+//Id of a uniform name, shared by all shaders
+unsigned int InternUniformName(const std::string& name);
+
+//Typed handle of a uniform, valid for every shader (and across reloads). Shaders resolve it into
+//a location once per linked program, so setting uniforms through handles involves no string operations.
+template <typename T>
+class Uniform {
+public:
+    explicit Uniform(const std::string& name) : m_ID(InternUniformName(name)) {}
+
+    unsigned int getID() const { return m_ID; }
+
+private:
+    unsigned int m_ID;
+};
+
+//Programs are built asynchronously: sources are read (and includes resolved) on a worker thread,
+//compilation and linking are then submitted without querying their status, so that the driver can
+//work on many programs at once. Until the first build is finished, Bind() finishes it; after that
+//the previous program stays in use until FinishBuild() swaps in the new one.
 class Shader{
 public:
+    virtual ~Shader();
+
     void Bind();
+    //Rebuilds synchronously, keeps the old program if the build fails
     void Reload();
 
+    //Starts reading the sources on a worker thread
+    void StartBuild();
+    //Compiles and links, returns false if the sources aren't loaded yet (and wait is false)
+    bool SubmitBuild(bool wait);
+    //True if FinishBuild won't wait for the driver
+    bool IsBuildComplete() const;
+    //Checks the result and swaps in the new program
+    void FinishBuild();
+
+    bool IsBuildPending() const { return m_Build != nullptr; }
+
+    //False if compilation failed, finishes a pending build
+    bool IsValid();
+
     //Basic uniform setting functions
     void setUniform1i(const std::string& name, int x);
     void setUniform2i(const std::string& name, int x, int y);
@@ -31,29 +95,51 @@ public:
     void setUniform3f(const std::string& name, glm::vec3 v);
     void setUniform4f(const std::string& name, glm::vec4 v);
     void setUniformMatrix4fv(const std::string& name, glm::mat4 mat);
+
+    //Overrides using handles
+    void setUniform(const Uniform<int>& u, int x);
+    void setUniform(const Uniform<float>& u, float x);
+    void setUniform(const Uniform<glm::ivec2>& u, glm::ivec2 v);
+    void setUniform(const Uniform<glm::ivec3>& u, glm::ivec3 v);
+    void setUniform(const Uniform<glm::ivec4>& u, glm::ivec4 v);
+    void setUniform(const Uniform<glm::vec2>& u, glm::vec2 v);
+    void setUniform(const Uniform<glm::vec3>& u, glm::vec3 v);
+    void setUniform(const Uniform<glm::vec4>& u, glm::vec4 v);
+    void setUniform(const Uniform<glm::mat4>& u, glm::mat4 mat);
+
+    //Byte offset of a uniform block member, -1 if it isn't active
+    int getBlockMemberOffset(const std::string& name);
 protected:
-    virtual void Build() = 0;
+    //Called with the loaded stages once a new program is swapped in
+    virtual void OnBuilt(const std::vector<ShaderStage>& stages) {}
 
     unsigned int m_ID = 0;
 
-    unsigned int getUniformLocation(const std::string& name);
-    std::vector<std::pair<std::string, unsigned int>> m_UniformCache;
+    int getUniformLocation(const std::string& name);
+    int getUniformLocation(unsigned int id);
+
+    //Introspects active uniforms of a newly linked program
+    void BuildUniformTable();
+
+    std::unordered_map<std::string, int> m_UniformTable;
+    //Indexed by interned name ids
+    std::vector<int> m_HandleLocations;
+
+    std::vector<ShaderStage> m_Stages;
+    std::unique_ptr<PendingBuild> m_Build;
 };
 
 class VertFragShader : public Shader {
 public:
     VertFragShader(const std::string& vert_path, const std::string& frag_path);
     ~VertFragShader();
-
-private:
-    void Build() override;
-
-    std::string m_VertPath, m_FragPath;
 };
 
 class ComputeShader : public Shader {
 public:
     ComputeShader(const std::string& compute_path);
+    //Builds from source generated at runtime, name is only used in error messages
+    ComputeShader(const std::string& name, const std::string& source);
     ~ComputeShader();
 
     //Parameters are total numbers of invocations needed.
@@ -61,7 +147,7 @@ public:
     void Dispatch(uint32_t size_x, uint32_t size_y, uint32_t size_z);
 
 private:
-    void Build() override;
+    void OnBuilt(const std::vector<ShaderStage>& stages) override;
 
     void RetrieveLocalSizes(const std::string& source_code);
 
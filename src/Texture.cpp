@@ -4,10 +4,57 @@
 #include "imgui.h"
 
 #include <cstddef>
+#include <iostream>
+#include <algorithm>
 
 Texture::~Texture() {}
 
+size_t Texture::s_AllocationCount = 0;
+
+size_t BytesPerTexel(int internal_format) {
+    switch (internal_format) {
+        case GL_R8:                 return 1;
+        case GL_RG8:                return 2;
+        case GL_R16:                return 2;
+        case GL_R16F:               return 2;
+        case GL_RGB8:               return 3;
+        case GL_RGBA8:              return 4;
+        case GL_RG16:               return 4;
+        case GL_RG16F:              return 4;
+        case GL_R32F:               return 4;
+        case GL_R11F_G11F_B10F:     return 4;
+        case GL_RGB10_A2:           return 4;
+        case GL_DEPTH24_STENCIL8:   return 4;
+        case GL_RGB16F:             return 6;
+        case GL_RGBA16:             return 8;
+        case GL_RGBA16F:            return 8;
+        case GL_RG32F:              return 8;
+        case GL_RGB32F:             return 12;
+        case GL_RGBA32F:            return 16;
+        default:                    return 4;
+    }
+}
+
+//Number of levels in a full mip chain
+int FullMipCount(int res_x, int res_y) {
+    int levels = 1, res = std::max(res_x, res_y);
+    while (res >>= 1) ++levels;
+    return levels;
+}
+
+//Texels of the first 'levels' mips of a 2d image
+size_t MipChainTexels(int res_x, int res_y, int levels) {
+    size_t texels = 0;
+
+    for (int level = 0; level < levels; level++)
+        texels += size_t(std::max(1, res_x >> level)) * size_t(std::max(1, res_y >> level));
+
+    return texels;
+}
+
+//Previous texture (if any) is deleted, zero ids are ignored by gl
 void InitTex2D(unsigned int& id, Texture2DSpec spec) {
+    glDeleteTextures(1, &id);
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
 
@@ -25,6 +72,7 @@ void InitTex2D(unsigned int& id, Texture2DSpec spec) {
 }
 
 void InitTex3D(unsigned int& id, Texture3DSpec spec) {
+    glDeleteTextures(1, &id);
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_3D, id);
 
@@ -42,9 +90,15 @@ void InitTex3D(unsigned int& id, Texture3DSpec spec) {
         glTexParameterfv(GL_TEXTURE_3D, GL_TEXTURE_BORDER_COLOR, spec.Border);
 }
 
+Texture2D::~Texture2D() {
+    glDeleteTextures(1, &m_ID);
+}
+
 void Texture2D::Initialize(Texture2DSpec spec) {
     InitTex2D(m_ID, spec);
     m_Spec = spec;
+    m_HasMips = false;
+    s_AllocationCount++;
 }
 
 void Texture2D::Bind(int id) const {
@@ -63,10 +117,57 @@ void Texture2D::AttachToFramebuffer() {
         GL_TEXTURE_2D, m_ID, 0);
 }
 
+void Texture2D::Clear(float r, float g, float b, float a) {
+    const float color[4] = { r, g, b, a };
+
+    glClearTexImage(m_ID, 0, GL_RGBA, GL_FLOAT, color);
+}
+
+void Texture2D::CopyTo(Texture2D& target, int x, int y, int width, int height) const {
+    glCopyImageSubData(m_ID, GL_TEXTURE_2D, 0, x, y, 0,
+                       target.m_ID, GL_TEXTURE_2D, 0, x, y, 0,
+                       width, height, 1);
+}
+
+void Texture2D::SetData(const float* data, int row_length, int x, int y, int width, int height) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glTextureSubImage2D(m_ID, 0, x, y, width, height, GL_RED, GL_FLOAT, data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+std::vector<float> Texture2D::GetData() const {
+    std::vector<float> data(size_t(m_Spec.ResolutionX) * size_t(m_Spec.ResolutionY));
+
+    glGetTextureImage(m_ID, 0, GL_RED, GL_FLOAT, GLsizei(data.size() * sizeof(float)), data.data());
+
+    return data;
+}
+
+void Texture2D::GenerateMips() {
+    Bind();
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    if (!m_HasMips)
+        s_AllocationCount++;
+
+    m_HasMips = true;
+}
+
+size_t Texture2D::getMemoryUsage() const {
+    const int levels = m_HasMips ? FullMipCount(m_Spec.ResolutionX, m_Spec.ResolutionY) : 1;
+
+    return BytesPerTexel(m_Spec.InternalFormat)
+         * MipChainTexels(m_Spec.ResolutionX, m_Spec.ResolutionY, levels);
+}
+
 void Texture2D::DrawToImGui(float width, float height) {
     ImGui::Image((void*)(intptr_t)m_ID, ImVec2(width, height));
 }
 
+TextureArray::~TextureArray() {
+    glDeleteTextures(GLsizei(m_TextureViews.size()), m_TextureViews.data());
+    glDeleteTextures(1, &m_ID);
+}
 
 void TextureArray::Initialize(Texture2DSpec spec, int layers) {
 
@@ -78,6 +179,11 @@ void TextureArray::Initialize(Texture2DSpec spec, int layers) {
 
     int mips = log2(spec.ResolutionX);
 
+    //Views have to go first, they reference the storage of m_ID
+    glDeleteTextures(GLsizei(m_TextureViews.size()), m_TextureViews.data());
+    glDeleteTextures(1, &m_ID);
+    m_TextureViews.clear();
+
     glGenTextures(1, &m_ID);
     glBindTexture(GL_TEXTURE_2D_ARRAY, m_ID);
 
@@ -104,6 +210,8 @@ void TextureArray::Initialize(Texture2DSpec spec, int layers) {
 
     m_Spec = spec;
     m_Layers = layers;
+    m_Mips = mips;
+    s_AllocationCount++;
 }
 
 void TextureArray::Bind(int id) const {
@@ -122,14 +230,30 @@ void TextureArray::BindImage(int id, int layer, int mip) const {
     glBindImageTexture(id, m_ID, mip, GL_FALSE, layer, GL_READ_WRITE, format);
 }
 
+void TextureArray::GenerateMips() {
+    Bind();
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+size_t TextureArray::getMemoryUsage() const {
+    return BytesPerTexel(m_Spec.InternalFormat) * size_t(m_Layers)
+         * MipChainTexels(m_Spec.ResolutionX, m_Spec.ResolutionY, m_Mips);
+}
+
 FramebufferTexture::FramebufferTexture() {}
 
 FramebufferTexture::~FramebufferTexture() {
     glDeleteFramebuffers(1, &m_FBO);
+    glDeleteRenderbuffers(1, &m_DepthRBO);
+    glDeleteTextures(1, &m_ID);
 }
 
-void FramebufferTexture::Initialize(Texture2DSpec spec) {
+void FramebufferTexture::Initialize(Texture2DSpec spec, bool with_depth) {
     //Initialize FBO:
+    glDeleteFramebuffers(1, &m_FBO);
+    glDeleteRenderbuffers(1, &m_DepthRBO);
+    m_DepthRBO = 0;
+
     glGenFramebuffers(1, &m_FBO);
     glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
 
@@ -140,6 +264,19 @@ void FramebufferTexture::Initialize(Texture2DSpec spec) {
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
         GL_TEXTURE_2D, m_ID, 0);
 
+    if (with_depth) {
+        glGenRenderbuffers(1, &m_DepthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+            spec.ResolutionX, spec.ResolutionY);
+
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+            GL_RENDERBUFFER, m_DepthRBO);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Framebuffer Error: Framebuffer is not complete\n";
+
     m_Spec = spec;
 }
 
@@ -152,9 +289,20 @@ void FramebufferTexture::BindTex(int id) {
     glBindTexture(GL_TEXTURE_2D, m_ID);
 }
 
+Texture3D::~Texture3D() {
+    glDeleteTextures(1, &m_ID);
+}
+
 void Texture3D::Initialize(Texture3DSpec spec) {
     InitTex3D(m_ID, spec);
     m_Spec = spec;
+    s_AllocationCount++;
+}
+
+//3d textures aren't mipmapped anywhere, so only the base level is counted
+size_t Texture3D::getMemoryUsage() const {
+    return BytesPerTexel(m_Spec.InternalFormat)
+         * size_t(m_Spec.ResolutionX) * size_t(m_Spec.ResolutionY) * size_t(m_Spec.ResolutionZ);
 }
 
 void Texture3D::Bind(int id) const {
@@ -168,7 +316,12 @@ void Texture3D::BindImage(int id, int mip) const {
     glBindImageTexture(id, m_ID, mip, GL_TRUE, 0, GL_READ_WRITE, format);
 }
 
+Cubemap::~Cubemap() {
+    glDeleteTextures(1, &m_ID);
+}
+
 void Cubemap::Initialize(CubemapSpec spec) {
+    glDeleteTextures(1, &m_ID);
     glGenTextures(1, &m_ID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
 
@@ -186,6 +339,25 @@ void Cubemap::Initialize(CubemapSpec spec) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
     m_Spec = spec;
+    m_HasMips = false;
+    s_AllocationCount++;
+}
+
+void Cubemap::GenerateMips() {
+    Bind();
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    if (!m_HasMips)
+        s_AllocationCount++;
+
+    m_HasMips = true;
+}
+
+size_t Cubemap::getMemoryUsage() const {
+    const int res = m_Spec.Resolution;
+    const int levels = m_HasMips ? FullMipCount(res, res) : 1;
+
+    return 6 * BytesPerTexel(m_Spec.InternalFormat) * MipChainTexels(res, res, levels);
 }
 
 void Cubemap::Bind(int id) const {
@@ -1,12 +1,30 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 
+//Textures own their gl objects, which are deleted on destruction and on reinitialization
 class Texture {
 public:
+    Texture() = default;
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
     virtual ~Texture() = 0;
+
+    //Estimated gpu memory in bytes, computed from the spec and allocated mip levels
+    virtual size_t getMemoryUsage() const = 0;
+
+    //Incremented whenever storage of some texture is (re)allocated, so that memory
+    //accounting can skip frames in which nothing changed
+    static size_t getAllocationCount() { return s_AllocationCount; }
+
+protected:
+    static size_t s_AllocationCount;
 };
 
+//Bytes per texel of a sized internal format, 4 for unknown formats
+size_t BytesPerTexel(int internal_format);
+
 struct Texture2DSpec {
     int ResolutionX;
     int ResolutionY;
@@ -22,21 +40,42 @@ struct Texture2DSpec {
 
 class Texture2D : public Texture {
 public:
+    ~Texture2D() override;
+
     void Initialize(Texture2DSpec spec);
     void Bind(int id = 0) const;
     void BindImage(int id, int mip) const;
     void AttachToFramebuffer();
 
+    //Sets all texels of the base level to (r, g, b, a)
+    void Clear(float r, float g, float b, float a);
+
+    //Copies a rectangle of the base level into the same place of target, formats must match
+    void CopyTo(Texture2D& target, int x, int y, int width, int height) const;
+
+    //Uploads single channel float data to a rectangle of the base level, data points to
+    //its first texel and rows are row_length values apart
+    void SetData(const float* data, int row_length, int x, int y, int width, int height);
+    //Reads back the first channel of the base level, in row major order
+    std::vector<float> GetData() const;
+
+    //Allocates/updates the full mip chain
+    void GenerateMips();
+
     void DrawToImGui(float width, float height);
 
     const Texture2DSpec& getSpec() { return m_Spec; }
+    bool hasMips() const { return m_HasMips; }
+    size_t getMemoryUsage() const override;
 private:
-    unsigned int m_ID;
-    Texture2DSpec m_Spec;
+    unsigned int m_ID = 0;
+    Texture2DSpec m_Spec{};
+    bool m_HasMips = false;
 };
 
 class TextureArray : public Texture {
 public:
+    ~TextureArray() override;
 
     void Initialize(Texture2DSpec spec, int layers);
 
@@ -44,13 +83,17 @@ public:
     void BindLayer(int id, int layer) const;
     void BindImage(int id, int layer, int mip) const;
 
+    //Mip levels are allocated upfront (immutable storage), this only updates them
+    void GenerateMips();
+
     const Texture2DSpec& getSpec() { return m_Spec; }
     int getLayers() { return m_Layers; }
+    size_t getMemoryUsage() const override;
 
 private:
-    unsigned int m_ID;
-    int m_Layers;
-    Texture2DSpec m_Spec;
+    unsigned int m_ID = 0;
+    int m_Layers = 0, m_Mips = 0;
+    Texture2DSpec m_Spec{};
 
     std::vector<unsigned int> m_TextureViews;
 };
@@ -60,14 +103,15 @@ public:
     FramebufferTexture();
     ~FramebufferTexture();
 
-    void Initialize(Texture2DSpec spec);
+    //Optional depth renderbuffer is needed when rendering 3d scenes offscreen
+    void Initialize(Texture2DSpec spec, bool with_depth = false);
     void BindFBO();
     void BindTex(int id = 0);
 
     const Texture2DSpec& getSpec() { return m_Spec; }
 private:
-    unsigned int m_FBO, m_ID;
-    Texture2DSpec m_Spec;
+    unsigned int m_FBO = 0, m_ID = 0, m_DepthRBO = 0;
+    Texture2DSpec m_Spec{};
 };
 
 struct Texture3DSpec {
@@ -86,14 +130,17 @@ struct Texture3DSpec {
 
 class Texture3D : public Texture {
 public:
+    ~Texture3D() override;
+
     void Initialize(Texture3DSpec spec);
     void Bind(int id = 0) const;
     void BindImage(int id, int mip) const;
 
     const Texture3DSpec& getSpec() { return m_Spec; }
+    size_t getMemoryUsage() const override;
 private:
-    unsigned int m_ID;
-    Texture3DSpec m_Spec;
+    unsigned int m_ID = 0;
+    Texture3DSpec m_Spec{};
 };
 
 struct CubemapSpec {
@@ -109,12 +156,19 @@ struct CubemapSpec {
 
 class Cubemap : public Texture {
 public:
+    ~Cubemap() override;
+
     void Initialize(CubemapSpec spec);
     void Bind(int id = 0) const;
     void BindImage(int id, int mip) const;
 
+    //Allocates/updates the full mip chain
+    void GenerateMips();
+
     const CubemapSpec& getSpec() { return m_Spec; }
+    size_t getMemoryUsage() const override;
 private:
-    unsigned int m_ID;
-    CubemapSpec m_Spec;
+    unsigned int m_ID = 0;
+    CubemapSpec m_Spec{};
+    bool m_HasMips = false;
 };
\ No newline at end of file
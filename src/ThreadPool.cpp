@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    //Hardware concurrency may be unknown (0)
+    threads = std::max(threads, 1u);
+
+    for (unsigned int i = 0; i < threads - 1; i++)
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+
+    m_WakeCondition.notify_all();
+
+    for (auto& worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func) {
+    if (count == 0)
+        return;
+
+    std::lock_guard<std::mutex> call_lock(m_CallMutex);
+
+    {
+        //Workers woken up late by the previous call may still be reading the job state
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCondition.wait(lock, [this]() { return m_Active == 0; });
+
+        m_Func = &func;
+        m_Count = count;
+        m_Finished = 0;
+        m_Next = 0;
+        m_Generation++;
+    }
+
+    m_WakeCondition.notify_all();
+
+    RunJobs();
+
+    //Workers may still be inside RunJobs even if all jobs are done,
+    //so the job state can only change once none of them is active
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() { return m_Finished == m_Count && m_Active == 0; });
+
+    m_Func = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+    size_t generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCondition.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+
+            if (m_Stop)
+                return;
+
+            generation = m_Generation;
+            m_Active++;
+        }
+
+        RunJobs();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Active--;
+        }
+
+        m_DoneCondition.notify_all();
+    }
+}
+
+void ThreadPool::RunJobs() {
+    size_t done = 0;
+
+    for (size_t i = m_Next++; i < m_Count; i = m_Next++) {
+        (*m_Func)(i);
+        done++;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Finished += done;
+
+    if (m_Finished == m_Count)
+        m_DoneCondition.notify_all();
+}
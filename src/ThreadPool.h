@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//Fixed set of worker threads running indexed jobs. Jobs are taken in order,
+//but may finish in any, so results shouldn't depend on which thread runs a job.
+class ThreadPool {
+public:
+    //Calling thread also runs jobs, so there are threads - 1 workers
+    ThreadPool(unsigned int threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    //Calls func(i) for all i in [0, count), returns once all calls are done
+    void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    unsigned int getThreadCount() const { return unsigned(m_Workers.size()) + 1; }
+
+private:
+    void WorkerLoop();
+    void RunJobs();
+
+    std::vector<std::thread> m_Workers;
+
+    //Serializes ParallelFor calls from different threads
+    std::mutex m_CallMutex;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition, m_DoneCondition;
+
+    const std::function<void(size_t)>* m_Func = nullptr;
+    size_t m_Count = 0, m_Finished = 0;
+    std::atomic<size_t> m_Next{0};
+
+    //Incremented with every ParallelFor call, workers wake up when it changes
+    size_t m_Generation = 0;
+    unsigned int m_Active = 0;
+    bool m_Stop = false;
+};
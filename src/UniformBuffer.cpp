@@ -0,0 +1,71 @@
+#include "UniformBuffer.h"
+
+#include "glad/glad.h"
+
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+UniformRingBuffer::UniformRingBuffer(uint32_t binding, size_t size, uint32_t frames)
+    : m_Binding(binding), m_Size(size), m_Frames(frames), m_Fences(frames, nullptr)
+{
+    //Bound ranges have to start at multiples of the offset alignment
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    const size_t align = size_t(std::max(alignment, 1));
+    m_Stride = ((m_Size + align - 1) / align) * align;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &m_ID);
+    glNamedBufferStorage(m_ID, m_Stride * m_Frames, nullptr, flags);
+
+    m_Mapped = static_cast<char*>(glMapNamedBufferRange(m_ID, 0, m_Stride * m_Frames, flags));
+
+    if (m_Mapped == nullptr)
+        std::cerr << "Uniform Buffer Error: Failed to map buffer for binding " << m_Binding << '\n';
+}
+
+UniformRingBuffer::~UniformRingBuffer()
+{
+    for (auto fence : m_Fences) {
+        if (fence != nullptr)
+            glDeleteSync(static_cast<GLsync>(fence));
+    }
+
+    if (m_Mapped != nullptr)
+        glUnmapNamedBuffer(m_ID);
+
+    glDeleteBuffers(1, &m_ID);
+}
+
+void UniformRingBuffer::Update(const void* data)
+{
+    if (m_Mapped == nullptr)
+        return;
+
+    //Everything reading the current segment was issued since the last update
+    if (m_Written) {
+        m_Fences[m_Current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_Current = (m_Current + 1) % m_Frames;
+    }
+
+    if (auto fence = static_cast<GLsync>(m_Fences[m_Current])) {
+        //Only waits if the gpu is more than m_Frames - 1 frames behind
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, 0, 1000000000);
+
+        glDeleteSync(fence);
+        m_Fences[m_Current] = nullptr;
+    }
+
+    const size_t offset = m_Current * m_Stride;
+
+    std::memcpy(m_Mapped + offset, data, m_Size);
+    glBindBufferRange(GL_UNIFORM_BUFFER, m_Binding, m_ID, offset, m_Size);
+
+    m_Written = true;
+}
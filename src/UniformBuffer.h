@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Uniform buffer updated (at most) once per frame. Storage is persistently mapped and split into
+//one segment per frame in flight, so writing new data never stalls on draws still reading the previous
+//ones. Data is bound to a fixed binding point, matching the layout(binding = ...) of the block in glsl.
+class UniformRingBuffer {
+public:
+    UniformRingBuffer(uint32_t binding, size_t size, uint32_t frames = 3);
+    ~UniformRingBuffer();
+
+    UniformRingBuffer(const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+    //Copies size bytes into the next segment and binds it
+    void Update(const void* data);
+
+    size_t getMemoryUsage() const { return m_Stride * m_Frames; }
+
+private:
+    uint32_t m_ID = 0;
+    uint32_t m_Binding;
+
+    size_t m_Size, m_Stride;
+    uint32_t m_Frames;
+
+    char* m_Mapped = nullptr;
+
+    //Fence placed when a segment is left, segment is reused only after it is signaled
+    std::vector<void*> m_Fences;
+    uint32_t m_Current = 0;
+    bool m_Written = false;
+};
@@ -1,26 +1,31 @@
 #include "Window.h"
 
+#include "Shader.h"
+
 #include "glad/glad.h"
 
 #include <iostream>
 
-Window::Window(const std::string& title, unsigned int width, unsigned int height) {
+Window::Window(const std::string& title, unsigned int width, unsigned int height, bool visible) {
     m_WindowData.Title  = title;
     m_WindowData.Width  = width;
     m_WindowData.Height = height;
 
-    //Initialize GLFW:
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    //Immediately set error callback:
+    //Set error callback first, so that init errors get reported too:
     glfwSetErrorCallback([](int code, const char* message) {
         std::cerr << "Glfw Error: \n" << "Code: " << code
             << "Message: " << message << '\n';
         });
 
+    //Initialize GLFW:
+    if (!glfwInit())
+        throw std::runtime_error("Failed to initialize glfw!");
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
     //Try to create a window
     m_Window = glfwCreateWindow(m_WindowData.Width, m_WindowData.Height,
                                 m_WindowData.Title.c_str(), NULL, NULL);
@@ -34,6 +39,8 @@ Window::Window(const std::string& title, unsigned int width, unsigned int height
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
         throw std::runtime_error("Failed to initialize glad!");
 
+    InitParallelShaderCompile((GLADloadproc)glfwGetProcAddress);
+
     //Set user pointer:
     glfwSetWindowUserPointer(m_Window, &m_WindowData);
 
@@ -117,8 +124,8 @@ Window::Window(const std::string& title, unsigned int width, unsigned int height
             }
         });
 
-    //Enable vsync
-    glfwSwapInterval(1);
+    //Enable vsync, unless hidden. Offscreen frames shouldn't be throttled
+    glfwSwapInterval(visible ? 1 : 0);
     
     //Set initial viewport dimensions
     glViewport(0, 0, m_WindowData.Width, m_WindowData.Height);
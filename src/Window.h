@@ -16,7 +16,8 @@ struct WindowData {
 
 class Window{
 public:
-    Window(const std::string& title, unsigned int width, unsigned int height);
+    //Hidden windows are used by the headless mode, which renders offscreen
+    Window(const std::string& title, unsigned int width, unsigned int height, bool visible = true);
     ~Window();
 
     void OnUpdate();
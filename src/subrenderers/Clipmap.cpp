@@ -6,92 +6,19 @@
 #include <algorithm>
 #include <iostream>
 
-Drawable::~Drawable() 
-{
-    glDeleteVertexArrays(1, &m_VAO);
-    glDeleteBuffers(1, &m_VBO);
-    glDeleteBuffers(1, &m_EBO);
-}
-
-void Drawable::GenGLBuffers()
-{
-    glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_VBO);
-    glGenBuffers(1, &m_EBO);
-
-    glBindVertexArray(m_VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * VertexData.size(), 
-                 &VertexData[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * IndexData.size(),
-                 &IndexData[0], GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-}
-
-void Drawable::BindBufferBase(uint32_t id) const
-{
-    glBindVertexArray(m_VAO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, id, m_VBO);
-}
-
-void Drawable::Draw() const
-{
-    glBindVertexArray(m_VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glDrawElements(GL_TRIANGLES, ElementCount, GL_UNSIGNED_INT, 0);
-}
-
 float ScaleFromLodLevel(uint32_t level)
 {
     const float scale = (level == 0) ? 1.0f : std::pow(2.0f, level - 1);
     return scale;
 }
 
-//N - number of verts per line, L - base side length of the grid
-void GenerateGrid(Drawable& grid,
-                  unsigned int N, float L, int LodLevel,
-                  glm::vec2 global_offset)  
-{
-    //We are treating zeroth level as 2x2 grid instead of 4x4
-    //so the number of vertices needs to be twice as large (-1 is due to overlap)
-    const uint32_t n = (LodLevel == 0) ? 2 * N - 1 : N;
-
-    grid.VertexCount = n * n;
-
-    //Corresponding element counts (1 quad = 2 triangles = 6 indices)
-    grid.ElementCount = (LodLevel == 0) ? 6 * 2*N * 2*N : 6 * N * N;
-
-    //Aliases
-    auto& verts    = grid.VertexData;
-    auto& elements = grid.IndexData;
-
-    //Generate data
-    const float scale = ScaleFromLodLevel(LodLevel);
-
-    //Side length of the entire grid segment
-    const float l = 2.0f * scale * L;
-    //Side length of one quad
-    const float base_offset = L / float(N - 1);
-
-    //Vertex data:
-    for (int i=0; i<n*n; i++)
-    {
-        float origin[2] = {global_offset.x - l/2.0f, global_offset.y - l/2.0f};
-        float offset[2] = {float(i%n)*(l/(n-1)), float(i/n)*(l/(n-1))};
-
-        verts.push_back(origin[0] + offset[0]);
-        verts.push_back(0.0f);
-        verts.push_back(origin[1] + offset[1]);
-        verts.push_back(std::pow(2, LodLevel) * base_offset);
-        //verts.push_back(0.0f);
-    }
+enum class Orientation {
+    Horizontal, Vertical
+};
 
-    //Index data:
+//Triangles of a n x n grid of vertices
+void AppendGridIndices(std::vector<uint32_t>& elements, uint32_t n)
+{
     for (uint32_t i=0; i<n*n; i++)
     {
         uint32_t ix = i%n;
@@ -110,61 +37,9 @@ void GenerateGrid(Drawable& grid,
     }
 }
 
-enum class Orientation {
-    Horizontal, Vertical
-};
-
-//N - number of verts per line, L - base side length of the grid
-void GenerateFill(Drawable& fill, Orientation orientation, 
-                  unsigned int N, float L, int LodLevel) 
+//Triangles of a strip consisting of two lines of n vertices
+void AppendFillIndices(std::vector<uint32_t>& elements, uint32_t n, Orientation orientation)
 {
-    //Number of vertices in one line (-3 because of overlap)
-    const uint32_t n = 4 * N - 3;
-
-    //We are generating a strip consisting of two lines
-    fill.VertexCount = 2 * n;
-    fill.ElementCount = 6 * 4 * N;
-
-    //Aliases
-    auto& verts   = fill.VertexData;
-    auto& elements = fill.IndexData;
-
-    //Generate data
-    const float scale = ScaleFromLodLevel(LodLevel);
-
-    const float l = 4.0f * scale * L;
-    const float base_offset = L/float(N-1);
-
-    //Vertex data:
-    for (uint32_t i=0; i<2*n; i++)
-    {
-        float origin[2] = {-l/2.0f, -l/2.0f};
-        float offset[2] = {float(i%n)*(l/(n-1)), float(i/n)*(l/(n-1))};
-
-        switch (orientation)
-        {
-            case Orientation::Horizontal:
-            {
-                verts.push_back(origin[0] + offset[0]);
-                verts.push_back(0.0f);
-                verts.push_back(origin[1] + offset[1]);
-                verts.push_back(std::pow(2, LodLevel) * base_offset);
-                
-                break;
-            }
-            case Orientation::Vertical:
-            {
-                verts.push_back(origin[1] + offset[1]);
-                verts.push_back(0.0f);
-                verts.push_back(origin[0] + offset[0]);
-                verts.push_back(std::pow(2, LodLevel) * base_offset);
-
-                break;
-            }
-        }
-    }
-
-    //Index data:
     for (uint32_t i=0; i<n; i++)
     {
         uint32_t ix = i%n;
@@ -201,11 +76,127 @@ void GenerateFill(Drawable& fill, Orientation orientation,
     }
 }
 
-void Clipmap::Init(uint32_t subdivisions, uint32_t levels)
+//N - number of verts per line, L - base side length of the grid
+//Vertex/index data is only generated if the clipmap isn't instanced
+void GenerateGrid(Drawable& grid,
+                  unsigned int N, float L, int LodLevel,
+                  glm::vec2 global_offset, bool instanced)  
+{
+    //We are treating zeroth level as 2x2 grid instead of 4x4
+    //so the number of vertices needs to be twice as large (-1 is due to overlap)
+    const uint32_t n = (LodLevel == 0) ? 2 * N - 1 : N;
+
+    grid.VertexCount = n * n;
+    grid.Topology = (LodLevel == 0) ? ClipmapTopology::GridLevel0 : ClipmapTopology::Grid;
+
+    const float scale = ScaleFromLodLevel(LodLevel);
+
+    //Side length of the entire grid segment
+    const float l = 2.0f * scale * L;
+    //Side length of one quad
+    const float base_offset = L / float(N - 1);
+
+    grid.Instance = glm::vec4(
+        global_offset.x - l/2.0f, global_offset.y - l/2.0f,
+        l/(n-1), std::pow(2, LodLevel) * base_offset
+    );
+
+    if (instanced)
+        return;
+
+    //Vertex data:
+    for (uint32_t i=0; i<n*n; i++)
+    {
+        grid.VertexData.push_back(grid.Instance.x + float(i%n) * grid.Instance.z);
+        grid.VertexData.push_back(0.0f);
+        grid.VertexData.push_back(grid.Instance.y + float(i/n) * grid.Instance.z);
+        grid.VertexData.push_back(grid.Instance.w);
+    }
+
+    AppendGridIndices(grid.IndexData, n);
+}
+
+//N - number of verts per line, L - base side length of the grid
+//Vertex/index data is only generated if the clipmap isn't instanced
+void GenerateFill(Drawable& fill, Orientation orientation, 
+                  unsigned int N, float L, int LodLevel, bool instanced) 
+{
+    //Number of vertices in one line (-3 because of overlap)
+    const uint32_t n = 4 * N - 3;
+
+    //We are generating a strip consisting of two lines
+    fill.VertexCount = 2 * n;
+    fill.Topology = (orientation == Orientation::Horizontal) ? ClipmapTopology::FillHorizontal
+                                                             : ClipmapTopology::FillVertical;
+
+    const float scale = ScaleFromLodLevel(LodLevel);
+
+    const float l = 4.0f * scale * L;
+    const float base_offset = L/float(N-1);
+
+    fill.Instance = glm::vec4(-l/2.0f, -l/2.0f, l/(n-1), std::pow(2, LodLevel) * base_offset);
+
+    if (instanced)
+        return;
+
+    //Vertex data:
+    for (uint32_t i=0; i<2*n; i++)
+    {
+        //Vertical fill is the horizontal one with swapped axes
+        const float along = float(i%n) * fill.Instance.z;
+        const float across = float(i/n) * fill.Instance.z;
+
+        const bool horizontal = (orientation == Orientation::Horizontal);
+
+        fill.VertexData.push_back(fill.Instance.x + (horizontal ? along : across));
+        fill.VertexData.push_back(0.0f);
+        fill.VertexData.push_back(fill.Instance.y + (horizontal ? across : along));
+        fill.VertexData.push_back(fill.Instance.w);
+    }
+
+    AppendFillIndices(fill.IndexData, n, orientation);
+}
+
+Clipmap::~Clipmap()
+{
+    ReleaseGLBuffers();
+}
+
+void Clipmap::ReleaseGLBuffers()
+{
+    glDeleteVertexArrays(1, &m_VAO);
+    glDeleteBuffers(1, &m_VBO);
+    glDeleteBuffers(1, &m_EBO);
+    glDeleteBuffers(1, &m_InstanceBuffer);
+    glDeleteBuffers(1, &m_IndirectBuffer);
+    glDeleteBuffers(1, &m_DescriptorBuffer);
+    glDeleteBuffers(1, &m_CullBuffer);
+    glDeleteBuffers(1, &m_CounterBuffer);
+
+    m_VAO = m_VBO = m_EBO = m_InstanceBuffer = m_IndirectBuffer = m_DescriptorBuffer = 0;
+    m_CullBuffer = m_CounterBuffer = 0;
+    m_NumCommands = 0;
+    m_BufferSize = 0;
+}
+
+void Clipmap::Init(uint32_t subdivisions, uint32_t levels, ClipmapMode mode)
 {
     if (subdivisions == 0 || levels == 0)
         return;
 
+    if (levels > s_MaxLevels)
+    {
+        std::cerr << "Clipmap Error: " << levels << " levels requested, clamping to " << s_MaxLevels << '\n';
+        levels = s_MaxLevels;
+    }
+
+    m_Mode = mode;
+    const bool instanced = (m_Mode == ClipmapMode::Instanced);
+
+    ReleaseGLBuffers();
+    m_Grids.clear();
+    m_Fills.clear();
+
     m_BaseOffset = m_BaseSideLength / float(subdivisions);
     m_VertsPerLine = subdivisions + 1;
     m_Levels = levels;
@@ -242,9 +233,7 @@ void Clipmap::Init(uint32_t subdivisions, uint32_t levels)
         {
             m_Grids.emplace_back();
 
-            GenerateGrid(m_Grids.back(), m_VertsPerLine, m_BaseSideLength, level, l * offsets[i]);
-
-            m_Grids.back().GenGLBuffers();
+            GenerateGrid(m_Grids.back(), m_VertsPerLine, m_BaseSideLength, level, l * offsets[i], instanced);
 
             //Bounding box parameters
             const float bb_center_height = 0.45f;
@@ -258,13 +247,371 @@ void Clipmap::Init(uint32_t subdivisions, uint32_t levels)
         }
 
         m_Fills.emplace_back();
-        GenerateFill(m_Fills.back(), Orientation::Horizontal, m_VertsPerLine, m_BaseSideLength, level);
-        m_Fills.back().GenGLBuffers();
+        GenerateFill(m_Fills.back(), Orientation::Horizontal, m_VertsPerLine, m_BaseSideLength, level, instanced);
 
         m_Fills.emplace_back();
-        GenerateFill(m_Fills.back(), Orientation::Vertical, m_VertsPerLine, m_BaseSideLength, level);
-        m_Fills.back().GenGLBuffers();
+        GenerateFill(m_Fills.back(), Orientation::Vertical, m_VertsPerLine, m_BaseSideLength, level, instanced);
     }
+
+    if (instanced)
+        GenInstancedBuffers();
+    else
+        GenGLBuffers();
+
+    GenCullTable();
+}
+
+void Clipmap::GenGLBuffers()
+{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    auto Pack = [&vertices, &indices](Drawable& drawable)
+    {
+        drawable.BaseVertex = vertices.size() / 4;
+        drawable.FirstIndex = indices.size();
+
+        //Counts are taken from the generated data, so that a draw
+        //never reads indices belonging to the next drawable
+        drawable.VertexCount = drawable.VertexData.size() / 4;
+        drawable.ElementCount = drawable.IndexData.size();
+
+        vertices.insert(vertices.end(), drawable.VertexData.begin(), drawable.VertexData.end());
+        indices.insert(indices.end(), drawable.IndexData.begin(), drawable.IndexData.end());
+
+        //Data lives on the gpu from now on
+        drawable.VertexData = std::vector<float>();
+        drawable.IndexData = std::vector<uint32_t>();
+    };
+
+    for (auto& grid : m_Grids)
+        Pack(grid);
+
+    for (auto& fill : m_Fills)
+        Pack(fill);
+
+    const size_t num_drawables = m_Grids.size() + m_Fills.size();
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_EBO);
+    glGenBuffers(1, &m_IndirectBuffer);
+
+    glBindVertexArray(m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(),
+                 vertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(),
+                 indices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+
+    //Written by the culling pass
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * num_drawables,
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    m_BufferSize = sizeof(float) * vertices.size() + sizeof(uint32_t) * indices.size()
+                 + sizeof(DrawElementsIndirectCommand) * num_drawables;
+
+    if (m_Mode == ClipmapMode::Displaced)
+        GenDescriptorTable();
+}
+
+template <typename Func>
+void Clipmap::ForEachDrawableByLevel(Func func) const
+{
+    for (uint32_t level = 0; level < m_Levels; level++)
+    {
+        for (uint32_t i = MaxGridIDUpTo(level); i < MaxGridIDUpTo(level + 1); i++)
+            func(m_Grids[i], level, true);
+
+        for (uint32_t i = MaxFillIDUpTo(level); i < MaxFillIDUpTo(level + 1); i++)
+            func(m_Fills[i], level, false);
+    }
+}
+
+void Clipmap::GenDescriptorTable()
+{
+    std::vector<ClipmapDescriptor> descriptors;
+    descriptors.reserve(m_Grids.size() + m_Fills.size());
+
+    m_MaxVertexCount = 0;
+
+    ForEachDrawableByLevel([this, &descriptors](const Drawable& drawable, uint32_t level, bool)
+    {
+        descriptors.push_back(ClipmapDescriptor{ drawable.BaseVertex, drawable.VertexCount, level, 0 });
+        m_MaxVertexCount = std::max(m_MaxVertexCount, drawable.VertexCount);
+    });
+
+    glGenBuffers(1, &m_DescriptorBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_DescriptorBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClipmapDescriptor) * descriptors.size(),
+                 descriptors.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_BufferSize += sizeof(ClipmapDescriptor) * descriptors.size();
+}
+
+void Clipmap::GenCullTable()
+{
+    std::vector<ClipmapCullEntry> entries;
+    entries.reserve(m_Grids.size() + m_Fills.size());
+
+    const bool instanced = (m_Mode == ClipmapMode::Instanced);
+
+    ForEachDrawableByLevel([this, &entries, instanced](const Drawable& drawable, uint32_t level, bool is_grid)
+    {
+        //Fills cover the whole level, so they are never culled
+        glm::vec4 bounds{ 0.0f, 0.0f, -1.0f, drawable.Instance.w };
+
+        if (is_grid)
+        {
+            const auto& box = static_cast<const DrawableWithBounding&>(drawable).BoundingBox;
+            bounds = glm::vec4(box.Center.x, box.Center.z, box.Extents.x, drawable.Instance.w);
+        }
+
+        //In instanced mode draw parameters come from the topology
+        const Drawable& source = instanced ? m_Topologies[drawable.Topology] : drawable;
+
+        entries.push_back(ClipmapCullEntry{
+            bounds,
+            glm::uvec4(source.ElementCount, source.FirstIndex, source.BaseVertex, drawable.Topology),
+            drawable.Instance
+        });
+    });
+
+    glGenBuffers(1, &m_CullBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CullBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClipmapCullEntry) * entries.size(),
+                 entries.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &m_CounterBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CounterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_BufferSize += sizeof(ClipmapCullEntry) * entries.size() + sizeof(uint32_t);
+}
+
+void Clipmap::GenInstancedBuffers()
+{
+    //Local integer coordinates, 2 per vertex
+    std::vector<uint16_t> coords;
+    std::vector<uint32_t> indices;
+
+    const uint32_t N = m_VertsPerLine;
+
+    auto BeginTopology = [&coords, &indices](Drawable& topology)
+    {
+        topology.BaseVertex = coords.size() / 2;
+        topology.FirstIndex = indices.size();
+    };
+
+    auto EndTopology = [&coords, &indices](Drawable& topology)
+    {
+        topology.VertexCount = coords.size() / 2 - topology.BaseVertex;
+        topology.ElementCount = indices.size() - topology.FirstIndex;
+    };
+
+    //Grids, same layout as in GenerateGrid
+    for (auto topology : { ClipmapTopology::GridLevel0, ClipmapTopology::Grid })
+    {
+        const uint32_t n = (topology == ClipmapTopology::GridLevel0) ? 2 * N - 1 : N;
+
+        BeginTopology(m_Topologies[topology]);
+
+        for (uint32_t i = 0; i < n*n; i++)
+        {
+            coords.push_back(i % n);
+            coords.push_back(i / n);
+        }
+
+        AppendGridIndices(indices, n);
+        EndTopology(m_Topologies[topology]);
+    }
+
+    //Fills, same layout as in GenerateFill
+    for (auto topology : { ClipmapTopology::FillHorizontal, ClipmapTopology::FillVertical })
+    {
+        const uint32_t n = 4 * N - 3;
+        const bool horizontal = (topology == ClipmapTopology::FillHorizontal);
+
+        BeginTopology(m_Topologies[topology]);
+
+        for (uint32_t i = 0; i < 2*n; i++)
+        {
+            coords.push_back(horizontal ? i % n : i / n);
+            coords.push_back(horizontal ? i / n : i % n);
+        }
+
+        AppendFillIndices(indices, n, horizontal ? Orientation::Horizontal : Orientation::Vertical);
+        EndTopology(m_Topologies[topology]);
+    }
+
+    const size_t num_drawables = m_Grids.size() + m_Fills.size();
+
+    //Each topology gets a range of the instance buffer large enough for all of its instances
+    m_Commands.clear();
+    uint32_t base_instance = 0;
+
+    for (uint32_t topology = 0; topology < ClipmapTopology::NumTopologies; topology++)
+    {
+        auto HasTopology = [topology](const Drawable& drawable) { return drawable.Topology == topology; };
+
+        const uint32_t num_instances = std::count_if(m_Grids.begin(), m_Grids.end(), HasTopology)
+                                     + std::count_if(m_Fills.begin(), m_Fills.end(), HasTopology);
+
+        const auto& topo = m_Topologies[topology];
+
+        m_Commands.push_back(DrawElementsIndirectCommand{
+            topo.ElementCount, 0, topo.FirstIndex, int32_t(topo.BaseVertex), base_instance
+        });
+
+        base_instance += num_instances;
+    }
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_EBO);
+    glGenBuffers(1, &m_InstanceBuffer);
+    glGenBuffers(1, &m_IndirectBuffer);
+
+    glBindVertexArray(m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t) * coords.size(),
+                 coords.data(), GL_STATIC_DRAW);
+
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_SHORT, 2*sizeof(uint16_t), (void*)0);
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(),
+                 indices.data(), GL_STATIC_DRAW);
+
+    //Per instance origin.xz, vertex spacing and snap scale, written by the culling pass
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * num_drawables, nullptr, GL_DYNAMIC_DRAW);
+
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * ClipmapTopology::NumTopologies,
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    m_BufferSize = sizeof(uint16_t) * coords.size() + sizeof(uint32_t) * indices.size()
+                 + sizeof(glm::vec4) * num_drawables
+                 + sizeof(DrawElementsIndirectCommand) * ClipmapTopology::NumTopologies;
+}
+
+size_t Clipmap::getMemoryUsage() const
+{
+    return m_BufferSize;
+}
+
+float Clipmap::getExtent() const
+{
+    if (m_Levels == 0)
+        return 0.0f;
+
+    //Outermost ring spans 4 grids, level 0 only 2
+    const float l = ScaleFromLodLevel(m_Levels - 1) * m_BaseSideLength;
+    return (m_Levels == 1) ? 4.0f * l : 8.0f * l;
+}
+
+void Clipmap::Cull(std::shared_ptr<ComputeShader> shader, const Camera& cam, uint32_t levels)
+{
+    levels = std::min(levels, m_Levels);
+
+    const uint32_t num_entries = NumDrawablesUpTo(levels);
+    const bool instanced = (m_Mode == ClipmapMode::Instanced);
+
+    //Reset instance counts/visible command count, commands are appended by the shader
+    if (instanced)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * m_Commands.size(),
+                        m_Commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        m_NumCommands = m_Commands.size();
+    }
+
+    else
+    {
+        //Zeroed commands past the visible ones are empty draws
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+        glClearBufferData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        m_NumCommands = num_entries;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_CounterBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    const Frustum& frustum = cam.getFrustum();
+    const std::array<const Plane*, 6> planes{
+        &frustum.Top, &frustum.Bottom, &frustum.Left, &frustum.Right, &frustum.Near, &frustum.Far
+    };
+
+    //One handle per array element
+    typedef Uniform<glm::vec3> PlaneUniform;
+
+    static const PlaneUniform u_plane_origins[6] = {
+        PlaneUniform("uPlaneOrigins[0]"), PlaneUniform("uPlaneOrigins[1]"), PlaneUniform("uPlaneOrigins[2]"),
+        PlaneUniform("uPlaneOrigins[3]"), PlaneUniform("uPlaneOrigins[4]"), PlaneUniform("uPlaneOrigins[5]")
+    };
+    static const PlaneUniform u_plane_normals[6] = {
+        PlaneUniform("uPlaneNormals[0]"), PlaneUniform("uPlaneNormals[1]"), PlaneUniform("uPlaneNormals[2]"),
+        PlaneUniform("uPlaneNormals[3]"), PlaneUniform("uPlaneNormals[4]"), PlaneUniform("uPlaneNormals[5]")
+    };
+    static const Uniform<int> u_num_entries("uNumEntries"), u_instanced("uInstanced");
+
+    for (size_t i = 0; i < planes.size(); i++)
+    {
+        shader->setUniform(u_plane_origins[i], planes[i]->Origin);
+        shader->setUniform(u_plane_normals[i], planes[i]->Normal);
+    }
+
+    shader->setUniform(u_num_entries, num_entries);
+    shader->setUniform(u_instanced, int(instanced));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_CullBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_IndirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_CounterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_InstanceBuffer);
+
+    shader->Dispatch(num_entries, 1, 1);
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void Clipmap::Draw() const
+{
+    if (m_NumCommands == 0)
+        return;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+
+    glBindVertexArray(m_VAO);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, m_NumCommands, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
 uint32_t Clipmap::NumGridsPerLevel(uint32_t level)
@@ -287,6 +634,11 @@ uint32_t Clipmap::MaxFillIDUpTo(uint32_t level)
     return (level == 0) ? 0 : level * 2;
 }
 
+uint32_t Clipmap::NumDrawablesUpTo(uint32_t level)
+{
+    return MaxGridIDUpTo(level) + MaxFillIDUpTo(level);
+}
+
 bool Clipmap::LevelShouldUpdate(uint32_t level, glm::vec2 curr, glm::vec2 prev) const
 {
     float scale = std::pow(2, level) * m_BaseOffset;
@@ -297,52 +649,52 @@ bool Clipmap::LevelShouldUpdate(uint32_t level, glm::vec2 curr, glm::vec2 prev)
     return (p_offset.x != c_offset.x) || (p_offset.y != c_offset.y);
 }
 
-void Clipmap::RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding)
+void Clipmap::DispatchLevels(ComputeShader& shader, uint32_t binding, uint32_t dirty_levels) const
 {
-    for (const auto& grid : m_Grids)
-    {
-        grid.BindBufferBase(1);
-        shader->Dispatch(grid.VertexCount, 1, 1);
-        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
-    }
+    if (dirty_levels == 0)
+        return;
+
+    //Descriptors are ordered by level, so levels above the highest dirty one can be left out
+    uint32_t highest = 0;
 
-    for (const auto& fill : m_Fills)
+    for (uint32_t level = 0; level < m_Levels; level++)
     {
-        fill.BindBufferBase(1);
-        shader->Dispatch(fill.VertexCount, 1, 1);
-        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        if (dirty_levels & (1u << level))
+            highest = level;
     }
-}
 
-void Clipmap::RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding, glm::vec2 curr, glm::vec2 prev)
-{
-    uint32_t grid_id = 0, fill_id = 0;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_VBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding + 1, m_DescriptorBuffer);
 
-    for (uint32_t level = 0; level < m_Levels; level++)
-    {
-        if (!LevelShouldUpdate(level, curr, prev))
-            continue;
+    static const Uniform<int> u_dirty_levels("uDirtyLevels");
 
-        for (uint32_t i = 0; i < NumGridsPerLevel(level); i++)
-        {
-            auto& grid = m_Grids[grid_id];
+    shader.setUniform(u_dirty_levels, int(dirty_levels));
+    shader.Dispatch(m_MaxVertexCount, NumDrawablesUpTo(highest + 1), 1);
 
-            grid.BindBufferBase(1);
-            shader->Dispatch(grid.VertexCount, 1, 1);
-            glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
 
-            grid_id++;
-        }
+void Clipmap::RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding)
+{
+    if (m_Mode != ClipmapMode::Displaced)
+        return;
 
-        for (uint32_t i = 0; i < NumFillsPerLevel(level); i++)
-        {
-            auto& fill = m_Fills[fill_id];
+    const uint32_t all_levels = (1u << m_Levels) - 1u;
+    DispatchLevels(*shader, binding, all_levels);
+}
 
-            fill.BindBufferBase(1);
-            shader->Dispatch(fill.VertexCount, 1, 1);
-            glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+void Clipmap::RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding, glm::vec2 curr, glm::vec2 prev)
+{
+    if (m_Mode != ClipmapMode::Displaced)
+        return;
 
-            fill_id++;
-        }
+    uint32_t dirty_levels = 0;
+
+    for (uint32_t level = 0; level < m_Levels; level++)
+    {
+        if (LevelShouldUpdate(level, curr, prev))
+            dirty_levels |= (1u << level);
     }
-}
\ No newline at end of file
+
+    DispatchLevels(*shader, binding, dirty_levels);
+}
@@ -10,20 +10,36 @@
 #include "MapGenerator.h"
 
 #include <cstdint>
+#include <array>
 
+//Displaced - every grid/fill has its own vertices, heights are written by a compute pass
+//Sampled   - same static buffers as displaced, heights are sampled from the heightmap in the vertex shader
+//Instanced - grids/fills of the same shape share vertices (local 16-bit coordinates) and
+//            indices, heights are sampled from the heightmap in the vertex shader
+enum class ClipmapMode {
+    Displaced, Sampled, Instanced
+};
+
+//Shapes of the clipmap geometry, shared between instances
+enum ClipmapTopology : uint32_t {
+    GridLevel0, Grid, FillHorizontal, FillVertical, NumTopologies
+};
+
+//Part of the clipmap geometry. Vertex/index data is only kept until it is
+//packed into the clipmap's shared buffers, afterwards the drawable is
+//described by its offsets within them.
 class Drawable{
 public:
-    ~Drawable();
-
-    void GenGLBuffers();
-    void BindBufferBase(uint32_t id = 0) const;
-    void Draw() const;
-    
     std::vector<float> VertexData;
     std::vector<uint32_t> IndexData;
     uint32_t VertexCount = 0, ElementCount = 0;
-protected:
-    uint32_t m_VAO = 0, m_VBO = 0, m_EBO = 0;
+
+    //Offsets into the shared buffers (in vertices/indices)
+    uint32_t BaseVertex = 0, FirstIndex = 0;
+
+    //Origin.xz, vertex spacing and snap scale, vertices are laid out on a regular grid
+    glm::vec4 Instance{ 0.0f };
+    uint32_t Topology = 0;
 };
 
 class DrawableWithBounding : public Drawable {
@@ -31,22 +47,76 @@ public:
     AABB BoundingBox;
 };
 
+//Layout matching the indirect draw command expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    uint32_t Count;
+    uint32_t InstanceCount;
+    uint32_t FirstIndex;
+    int32_t BaseVertex;
+    uint32_t BaseInstance;
+};
+
+//Entry of the culling table read by clipmap_cull.glsl, std430 layout
+struct ClipmapCullEntry {
+    //Center.xz, half side length (negative for drawables that are never culled), snap scale
+    glm::vec4 Bounds;
+    //Element count, first index, base vertex, topology
+    glm::uvec4 Draw;
+    glm::vec4 Instance;
+};
+
+//Entry of the descriptor table read by displace.glsl, std430 layout
+struct ClipmapDescriptor {
+    uint32_t BaseVertex;
+    uint32_t VertexCount;
+    uint32_t Level;
+    uint32_t Padding;
+};
+
 class Clipmap {
 public:
-    void Init(uint32_t subdivisions, uint32_t levels);
+    Clipmap() = default;
+    ~Clipmap();
+
+    //Owns gl buffers, so copying is not allowed
+    Clipmap(const Clipmap&) = delete;
+    Clipmap& operator=(const Clipmap&) = delete;
+
+    void Init(uint32_t subdivisions, uint32_t levels, ClipmapMode mode = ClipmapMode::Displaced);
+
+    ClipmapMode getMode() const { return m_Mode; }
+
+    //Whether vertex shaders need to sample heights (uSampleHeight in clipmap.glsl)
+    bool SamplesHeight() const { return m_Mode != ClipmapMode::Displaced; }
+
+    //Frustum culls grids of the first 'levels' levels on the gpu and writes the indirect
+    //command buffer consumed by all following Draw calls. Caller binds the shader, sets uPos,
+    //uScaleXZ, uScaleY and binds the heightmap (with its max mip chain) as 'heightmap'.
+    //Should be called once per frame, before any drawing.
+    void Cull(std::shared_ptr<ComputeShader> shader, const Camera& cam, uint32_t levels = UINT32_MAX);
+
+    //Draws everything that passed the last culling with a single glMultiDrawElementsIndirect call
+    void Draw() const;
 
     const std::vector<DrawableWithBounding>& getGrids() const { return m_Grids; }
     const std::vector<Drawable>& getFills() const { return m_Fills; }
 
-    //Dispatches the compute shader for all grids/fills of the clipmap
-    //Each time the shader is dispatched with (VertexCount, 1, 1) invocations 
-    //Binding is forwarded as glBindBufferBase argument
+    //Total size of all grid/fill buffers in bytes
+    size_t getMemoryUsage() const;
+
+    //Side length of the square covered by all levels (world units)
+    float getExtent() const;
+
+    //Compute passes only apply to displaced clipmaps, for other modes they are no-ops
+
+    //Runs the compute shader for all grids/fills of the clipmap, with a single dispatch
+    //of (max VertexCount, number of drawables, 1) invocations. Vertex buffer is bound
+    //to 'binding', the descriptor table (ClipmapDescriptor per drawable) to 'binding + 1'.
+    //uDirtyLevels holds a bitmask of levels to be processed.
     void RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding);
 
-    //Conditionally runs the compute shader, for those grids/fill that should be updated
-    //afted a change in the camera position.
-    //Each time the shader is dispatched with (VertexCount, 1, 1) invocations 
-    //Binding is forwarded as glBindBufferBase argument
+    //Same as above, but only levels that should be updated after a change
+    //in the camera position are marked as dirty. Nothing is dispatched if none is.
     void RunCompute(std::shared_ptr<ComputeShader> shader, uint32_t binding, glm::vec2 curr, glm::vec2 prev);
 
     static uint32_t NumGridsPerLevel(uint32_t level);
@@ -54,10 +124,31 @@ public:
 
     static uint32_t MaxGridIDUpTo(uint32_t level);
     static uint32_t MaxFillIDUpTo(uint32_t level);
+    static uint32_t NumDrawablesUpTo(uint32_t level);
     
     bool LevelShouldUpdate(uint32_t level, glm::vec2 curr, glm::vec2 prev) const;
 
+    //Maximal supported number of levels, so that the dirty mask fits in an int uniform
+    static const uint32_t s_MaxLevels = 31;
+
 private:
+    //Packs vertex/index data of all drawables into shared buffers
+    void GenGLBuffers();
+    //Packs one copy of each topology and allocates the per instance buffer
+    void GenInstancedBuffers();
+    void ReleaseGLBuffers();
+
+    //Tables are packed level by level, so that the first levels form a prefix of them
+    void GenDescriptorTable();
+    void GenCullTable();
+
+    template <typename Func>
+    void ForEachDrawableByLevel(Func func) const;
+
+    void DispatchLevels(ComputeShader& shader, uint32_t binding, uint32_t dirty_levels) const;
+
+    ClipmapMode m_Mode = ClipmapMode::Displaced;
+
     float m_BaseSideLength = 4.0f;
     float m_VertsPerLine, m_BaseOffset;
 
@@ -65,4 +156,26 @@ private:
 
     std::vector<DrawableWithBounding> m_Grids;
     std::vector<Drawable> m_Fills;
+
+    //Instanced mode only, offsets of each topology within the shared buffers
+    std::array<Drawable, ClipmapTopology::NumTopologies> m_Topologies;
+
+    //Shared by all grids/fills, vertex buffer also serves as ssbo for the compute passes
+    uint32_t m_VAO = 0, m_VBO = 0, m_EBO = 0, m_InstanceBuffer = 0, m_IndirectBuffer = 0;
+
+    //Displaced mode only, descriptors of all drawables
+    uint32_t m_DescriptorBuffer = 0;
+    uint32_t m_MaxVertexCount = 0;
+
+    //Culling input and the number of visible drawables (non instanced modes)
+    uint32_t m_CullBuffer = 0, m_CounterBuffer = 0;
+
+    size_t m_BufferSize = 0;
+
+    //Instanced mode only, one command per topology with instance count reset before culling.
+    //Each topology owns a fixed range of the instance buffer starting at BaseInstance.
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+
+    //Number of commands written by the last culling pass
+    uint32_t m_NumCommands = 0;
 };
@@ -0,0 +1,438 @@
+#include "CpuProcedures.h"
+
+#include "Erosion.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined(LOFI_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(LOFI_SIMD_SSE4)
+#include <smmintrin.h>
+#endif
+
+//Minimal vector types used by the procedures, float lanes (VecF), uint lanes (VecU) and lane masks.
+//All backends have the same semantics as the corresponding glsl operations on each lane.
+
+#if defined(LOFI_SIMD_AVX2)
+
+constexpr int Lanes = 8;
+
+struct VecF { __m256 v; };
+struct VecU { __m256i v; };
+typedef VecF Mask;
+
+inline VecF SetF(float x) { return { _mm256_set1_ps(x) }; }
+inline VecU SetU(uint32_t x) { return { _mm256_set1_epi32(int(x)) }; }
+inline VecF LoadF(const float* ptr) { return { _mm256_loadu_ps(ptr) }; }
+inline void StoreF(float* ptr, VecF x) { _mm256_storeu_ps(ptr, x.v); }
+inline VecF LaneIndices() { return { _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f) }; }
+
+inline VecF operator+(VecF a, VecF b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline VecF operator-(VecF a, VecF b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline VecF operator*(VecF a, VecF b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline VecF Floor(VecF a) { return { _mm256_floor_ps(a.v) }; }
+inline VecF Sqrt(VecF a) { return { _mm256_sqrt_ps(a.v) }; }
+inline VecF Max(VecF a, VecF b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Mask Less(VecF a, VecF b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline VecF Select(Mask m, VecF a, VecF b) { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+inline VecU operator*(VecU a, VecU b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+inline VecU operator^(VecU a, VecU b) { return { _mm256_xor_si256(a.v, b.v) }; }
+inline VecU operator&(VecU a, VecU b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline VecU operator|(VecU a, VecU b) { return { _mm256_or_si256(a.v, b.v) }; }
+template<int N> inline VecU ShiftRight(VecU a) { return { _mm256_srli_epi32(a.v, N) }; }
+
+inline VecU FloatBitsToUint(VecF a) { return { _mm256_castps_si256(a.v) }; }
+inline VecF UintBitsToFloat(VecU a) { return { _mm256_castsi256_ps(a.v) }; }
+
+#elif defined(LOFI_SIMD_SSE4)
+
+constexpr int Lanes = 4;
+
+struct VecF { __m128 v; };
+struct VecU { __m128i v; };
+typedef VecF Mask;
+
+inline VecF SetF(float x) { return { _mm_set1_ps(x) }; }
+inline VecU SetU(uint32_t x) { return { _mm_set1_epi32(int(x)) }; }
+inline VecF LoadF(const float* ptr) { return { _mm_loadu_ps(ptr) }; }
+inline void StoreF(float* ptr, VecF x) { _mm_storeu_ps(ptr, x.v); }
+inline VecF LaneIndices() { return { _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) }; }
+
+inline VecF operator+(VecF a, VecF b) { return { _mm_add_ps(a.v, b.v) }; }
+inline VecF operator-(VecF a, VecF b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline VecF operator*(VecF a, VecF b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline VecF Floor(VecF a) { return { _mm_floor_ps(a.v) }; }
+inline VecF Sqrt(VecF a) { return { _mm_sqrt_ps(a.v) }; }
+inline VecF Max(VecF a, VecF b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Mask Less(VecF a, VecF b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline VecF Select(Mask m, VecF a, VecF b) { return { _mm_blendv_ps(b.v, a.v, m.v) }; }
+
+inline VecU operator*(VecU a, VecU b) { return { _mm_mullo_epi32(a.v, b.v) }; }
+inline VecU operator^(VecU a, VecU b) { return { _mm_xor_si128(a.v, b.v) }; }
+inline VecU operator&(VecU a, VecU b) { return { _mm_and_si128(a.v, b.v) }; }
+inline VecU operator|(VecU a, VecU b) { return { _mm_or_si128(a.v, b.v) }; }
+template<int N> inline VecU ShiftRight(VecU a) { return { _mm_srli_epi32(a.v, N) }; }
+
+inline VecU FloatBitsToUint(VecF a) { return { _mm_castps_si128(a.v) }; }
+inline VecF UintBitsToFloat(VecU a) { return { _mm_castsi128_ps(a.v) }; }
+
+#else
+
+constexpr int Lanes = 1;
+
+struct VecF { float v; };
+struct VecU { uint32_t v; };
+typedef bool Mask;
+
+inline VecF SetF(float x) { return { x }; }
+inline VecU SetU(uint32_t x) { return { x }; }
+inline VecF LoadF(const float* ptr) { return { *ptr }; }
+inline void StoreF(float* ptr, VecF x) { *ptr = x.v; }
+inline VecF LaneIndices() { return { 0.0f }; }
+
+inline VecF operator+(VecF a, VecF b) { return { a.v + b.v }; }
+inline VecF operator-(VecF a, VecF b) { return { a.v - b.v }; }
+inline VecF operator*(VecF a, VecF b) { return { a.v * b.v }; }
+inline VecF Floor(VecF a) { return { std::floor(a.v) }; }
+inline VecF Sqrt(VecF a) { return { std::sqrt(a.v) }; }
+//Same operand order as the sse/avx max
+inline VecF Max(VecF a, VecF b) { return { a.v > b.v ? a.v : b.v }; }
+inline Mask Less(VecF a, VecF b) { return a.v < b.v; }
+inline VecF Select(Mask m, VecF a, VecF b) { return m ? a : b; }
+
+inline VecU operator*(VecU a, VecU b) { return { a.v * b.v }; }
+inline VecU operator^(VecU a, VecU b) { return { a.v ^ b.v }; }
+inline VecU operator&(VecU a, VecU b) { return { a.v & b.v }; }
+inline VecU operator|(VecU a, VecU b) { return { a.v | b.v }; }
+template<int N> inline VecU ShiftRight(VecU a) { return { a.v >> N }; }
+
+inline VecU FloatBitsToUint(VecF a) { VecU res; std::memcpy(&res.v, &a.v, sizeof(float)); return res; }
+inline VecF UintBitsToFloat(VecU a) { VecF res; std::memcpy(&res.v, &a.v, sizeof(float)); return res; }
+
+#endif
+
+//Functions without SIMD counterparts (e.g. pow) run lane by lane
+template<typename Func>
+VecF PerLane(VecF x, Func func) {
+    float values[Lanes];
+    StoreF(values, x);
+
+    for (int i = 0; i < Lanes; i++)
+        values[i] = func(values[i]);
+
+    return LoadF(values);
+}
+
+//===========================================================================
+//Region traversal
+
+ThreadPool& GetThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+//Calls func(x, y, prev) for chunks of Lanes texels in rows of the region, where x, y hold global texel
+//coordinates of the lanes and prev the current heights, the result replaces them. Chunks only
+//depend on their own texels, so the result doesn't depend on tiling or the number of threads.
+template<typename Func>
+void ForEachChunk(std::vector<float>& heights, int res, const DispatchRegion& region, Func func) {
+    const int tile_size = 64;
+
+    const int tiles_x = (region.Size.x + tile_size - 1) / tile_size;
+    const int tiles_y = (region.Size.y + tile_size - 1) / tile_size;
+
+    GetThreadPool().ParallelFor(size_t(tiles_x) * size_t(tiles_y), [&](size_t tile) {
+        const int x0 = region.Offset.x + int(tile % tiles_x) * tile_size;
+        const int y0 = region.Offset.y + int(tile / tiles_x) * tile_size;
+
+        const int x1 = std::min(x0 + tile_size, region.Offset.x + region.Size.x);
+        const int y1 = std::min(y0 + tile_size, region.Offset.y + region.Size.y);
+
+        for (int y = y0; y < y1; y++) {
+            float* row = heights.data() + size_t(y) * size_t(res);
+
+            for (int x = x0; x < x1; x += Lanes) {
+                //Last chunk of a row may be partial
+                const int count = std::min(Lanes, x1 - x);
+
+                float values[Lanes] = {};
+                std::copy(row + x, row + x + count, values);
+
+                const VecF xs = SetF(float(x)) + LaneIndices();
+                const VecF ys = SetF(float(y));
+
+                StoreF(values, func(xs, ys, LoadF(values)));
+                std::copy(values, values + count, row + x);
+            }
+        }
+    });
+}
+
+//Mirrors terrain/procedure.glsl and the blend modes shared by fbm/voronoi
+
+enum BlendMode {
+    BlendAverage = 0, BlendAdd = 1, BlendSubtract = 2
+};
+
+VecF Blend(VecF prev, VecF h, int mode, float weight) {
+    const VecF w = SetF(weight);
+
+    switch (mode) {
+        case BlendAverage:  return prev * (SetF(1.0f) - w) + h * w;
+        case BlendAdd:      return prev + w * h;
+        case BlendSubtract: return prev - w * h;
+    }
+
+    return h;
+}
+
+//===========================================================================
+//terrain/fbm.glsl
+
+VecU MurmurHash12(VecU x, VecU y) {
+    const VecU M = SetU(0x5bd1e995u);
+    VecU h = SetU(1190494759u);
+
+    x = x * M; y = y * M;
+    x = x ^ ShiftRight<24>(x); y = y ^ ShiftRight<24>(y);
+    x = x * M; y = y * M;
+
+    h = h * M; h = h ^ x; h = h * M; h = h ^ y;
+    h = h ^ ShiftRight<13>(h); h = h * M; h = h ^ ShiftRight<15>(h);
+
+    return h;
+}
+
+VecF Hash(VecF x, VecF y) {
+    const VecU h = MurmurHash12(FloatBitsToUint(x), FloatBitsToUint(y));
+    return UintBitsToFloat((h & SetU(0x007fffffu)) | SetU(0x3f800000u)) - SetF(1.0f);
+}
+
+VecF Noise(VecF px, VecF py) {
+    const VecF idx = Floor(px), idy = Floor(py);
+    VecF ux = px - idx, uy = py - idy;
+
+    //Offsets are added even if zero, since that changes the bits of -0.0
+    const VecF zero = SetF(0.0f), one = SetF(1.0f);
+
+    const VecF a = Hash(idx + zero, idy + zero);
+    const VecF b = Hash(idx + one,  idy + zero);
+    const VecF c = Hash(idx + zero, idy + one);
+    const VecF d = Hash(idx + one,  idy + one);
+
+    auto fade = [](VecF u) {
+        return u * u * u * (u * (SetF(6.0f) * u - SetF(15.0f)) + SetF(10.0f));
+    };
+
+    ux = fade(ux);
+    uy = fade(uy);
+
+    const VecF k0 = a;
+    const VecF k1 = b - a;
+    const VecF k2 = c - a;
+    const VecF k3 = a - b - c + d;
+
+    return k0 + k1 * ux + k2 * uy + k3 * ux * uy;
+}
+
+VecF Fbm(VecF px, VecF py, int octaves, float roughness) {
+    const float scale_y = 1.0f;
+    const float scale_xz = 0.5f;
+
+    //Matrices are indexed [column][row], as in glsl
+    const float rot[2][2] = { {0.8f, 0.6f}, {-0.6f, 0.8f} };
+
+    px = px * SetF(scale_xz);
+    py = py * SetF(scale_xz);
+
+    VecF res = SetF(0.0f);
+    float M[2][2] = { {1.0f, 0.0f}, {0.0f, 1.0f} };
+
+    float A = 1.0f, a = 1.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        //Same as a*M*p, matrix is scaled first
+        const VecF qx = SetF(a * M[0][0]) * px + SetF(a * M[1][0]) * py;
+        const VecF qy = SetF(a * M[0][1]) * px + SetF(a * M[1][1]) * py;
+
+        res = res + SetF(A) * Noise(qx, qy);
+
+        a *= 2.0f;
+        A *= roughness;
+
+        //M *= rot
+        float product[2][2];
+
+        for (int c = 0; c < 2; c++) {
+            for (int r = 0; r < 2; r++)
+                product[c][r] = M[0][r] * rot[c][0] + M[1][r] * rot[c][1];
+        }
+
+        std::memcpy(M, product, sizeof(M));
+    }
+
+    return SetF(scale_y) * res;
+}
+
+//===========================================================================
+//terrain/voronoi.glsl
+
+void MurmurHash22(VecU x, VecU y, VecU& hx, VecU& hy) {
+    const VecU M = SetU(0x5bd1e995u);
+    hx = SetU(1190494759u);
+    hy = SetU(2147483647u);
+
+    x = x * M; y = y * M;
+    x = x ^ ShiftRight<24>(x); y = y ^ ShiftRight<24>(y);
+    x = x * M; y = y * M;
+
+    hx = hx * M; hy = hy * M;
+    hx = hx ^ x; hy = hy ^ x;
+    hx = hx * M; hy = hy * M;
+    hx = hx ^ y; hy = hy ^ y;
+    hx = hx ^ ShiftRight<13>(hx); hy = hy ^ ShiftRight<13>(hy);
+    hx = hx * M; hy = hy * M;
+    hx = hx ^ ShiftRight<15>(hx); hy = hy ^ ShiftRight<15>(hy);
+}
+
+void Hash22(VecF x, VecF y, VecF& rx, VecF& ry) {
+    VecU hx, hy;
+    MurmurHash22(FloatBitsToUint(x), FloatBitsToUint(y), hx, hy);
+
+    const VecU mantissa = SetU(0x007fffffu), one = SetU(0x3f800000u);
+
+    rx = UintBitsToFloat((hx & mantissa) | one) - SetF(1.0f);
+    ry = UintBitsToFloat((hy & mantissa) | one) - SetF(1.0f);
+}
+
+//Returns sqrt of the two smallest squared distances
+void Voronoi(VecF x, VecF y, float randomness, VecF& f1, VecF& f2) {
+    const VecF px = Floor(x), py = Floor(y);
+
+    VecF res_x = SetF(2.25f), res_y = SetF(2.25f);
+
+    for (int i = -1; i <= 1; i++) {
+        for (int j = -1; j <= 1; j++) {
+            const VecF vx = px + SetF(float(i));
+            const VecF vy = py + SetF(float(j));
+
+            VecF hx, hy;
+            Hash22(vx, vy, hx, hy);
+
+            const VecF rx = vx + SetF(randomness) * hx;
+            const VecF ry = vy + SetF(randomness) * hy;
+
+            const VecF dx = x - rx, dy = y - ry;
+            const VecF d2 = dx * dx + dy * dy;
+
+            //If d2 < res.x both move, else if d2 < res.y only the second one changes
+            const Mask first = Less(d2, res_x);
+
+            res_y = Select(first, res_x, Select(Less(d2, res_y), d2, res_y));
+            res_x = Select(first, d2, res_x);
+        }
+    }
+
+    f1 = Sqrt(res_x);
+    f2 = Sqrt(res_y);
+}
+
+//===========================================================================
+
+void ConstValueCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                   const Procedure& procedure, const std::vector<InstanceData>& data)
+{
+    const float value = procedure.getValue<float>(data, "uValue");
+
+    ForEachChunk(heights, res, region, [&](VecF x, VecF y, VecF prev) {
+        return SetF(value);
+    });
+}
+
+void FbmCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+            const Procedure& procedure, const std::vector<InstanceData>& data)
+{
+    const int octaves = procedure.getValue<int>(data, "uOctaves");
+    const float scale = procedure.getValue<float>(data, "uScale");
+    const float roughness = procedure.getValue<float>(data, "uRoughness");
+    const int blend_mode = procedure.getValue<int>(data, "uBlendMode");
+    const float weight = procedure.getValue<float>(data, "uWeight");
+
+    ForEachChunk(heights, res, region, [&](VecF x, VecF y, VecF prev) {
+        const VecF u = x * SetF(region.TexelSize), v = y * SetF(region.TexelSize);
+
+        const VecF h = Fbm(SetF(scale) * u, SetF(scale) * v, octaves, roughness);
+
+        return Blend(prev, h, blend_mode, weight);
+    });
+}
+
+void VoronoiCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                const Procedure& procedure, const std::vector<InstanceData>& data)
+{
+    enum VoronoiType {
+        VoronoiF1 = 0, VoronoiF2 = 1, VoronoiF2F1 = 2
+    };
+
+    const float scale = procedure.getValue<float>(data, "uScale");
+    const float randomness = procedure.getValue<float>(data, "uRandomness");
+    const int type = procedure.getValue<int>(data, "uVoronoiType");
+    const int blend_mode = procedure.getValue<int>(data, "uBlendMode");
+    const float weight = procedure.getValue<float>(data, "uWeight");
+
+    ForEachChunk(heights, res, region, [&](VecF x, VecF y, VecF prev) {
+        const VecF u = x * SetF(region.TexelSize), v = y * SetF(region.TexelSize);
+
+        VecF f1, f2;
+        Voronoi(SetF(scale) * u, SetF(scale) * v, randomness, f1, f2);
+
+        VecF h = SetF(0.0f);
+
+        switch (type) {
+            case VoronoiF1:   h = f1;      break;
+            case VoronoiF2:   h = f2;      break;
+            case VoronoiF2F1: h = f2 - f1; break;
+        }
+
+        return Blend(prev, h, blend_mode, weight);
+    });
+}
+
+void CurvesCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+               const Procedure& procedure, const std::vector<InstanceData>& data)
+{
+    const float exponent = procedure.getValue<float>(data, "uExponent");
+
+    ForEachChunk(heights, res, region, [&](VecF x, VecF y, VecF prev) {
+        return PerLane(prev, [exponent](float h) { return std::pow(h, exponent); });
+    });
+}
+
+void RadialCutoffCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                     const Procedure& procedure, const std::vector<InstanceData>& data)
+{
+    const float bias = procedure.getValue<float>(data, "uBias");
+    const float slope = procedure.getValue<float>(data, "uSlope");
+
+    ForEachChunk(heights, res, region, [&](VecF x, VecF y, VecF prev) {
+        const VecF du = x * SetF(region.TexelSize) - SetF(0.5f);
+        const VecF dv = y * SetF(region.TexelSize) - SetF(0.5f);
+
+        const VecF hoffset = SetF(bias) + SetF(slope) * (du * du + dv * dv);
+
+        return Max(prev - hoffset, SetF(0.0f));
+    });
+}
+
+void ErosionCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                const Procedure& procedure, const std::vector<InstanceData>& data, bool tiling)
+{
+    const auto params = ErosionParams::FromInstance(procedure, data, tiling);
+
+    heights = ErodeReference(heights, res, params);
+}
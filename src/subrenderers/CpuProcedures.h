@@ -0,0 +1,30 @@
+#pragma once
+
+#include "TextureEditor.h"
+
+#include <vector>
+
+//Cpu implementations of the heightmap procedures from res/shaders/terrain, for machines with slow
+//compute and for validating the gpu output. They mirror the shaders operation by operation (hashes are
+//bit exact, floating point results may differ by rounding, e.g. due to fused multiply-adds on the gpu).
+//Rows are vectorized (AVX2 or SSE4.1 depending on LOFI_CPU_SIMD, scalar otherwise) and tiles of the
+//region run on a thread pool. Heights are res x res values in row major order, see CpuProcedure.
+
+void ConstValueCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                   const Procedure& procedure, const std::vector<InstanceData>& data);
+
+void FbmCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+            const Procedure& procedure, const std::vector<InstanceData>& data);
+
+void VoronoiCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                const Procedure& procedure, const std::vector<InstanceData>& data);
+
+void CurvesCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+               const Procedure& procedure, const std::vector<InstanceData>& data);
+
+void RadialCutoffCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                     const Procedure& procedure, const std::vector<InstanceData>& data);
+
+//Runs all iterations at once with ErodeReference, always on the entire map
+void ErosionCpu(std::vector<float>& heights, int res, const DispatchRegion& region,
+                const Procedure& procedure, const std::vector<InstanceData>& data, bool tiling);
@@ -0,0 +1,436 @@
+#include "Erosion.h"
+
+#include "Profiler.h"
+
+#include "glad/glad.h"
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+ErosionParams ErosionParams::FromInstance(const Procedure& procedure, const std::vector<InstanceData>& data, bool tiling) {
+    ErosionParams params;
+
+    params.Iterations    = procedure.getValue<int>(data, "uIterations");
+    params.StepsPerFrame = procedure.getValue<int>(data, "uStepsPerFrame");
+    params.SimLevel      = procedure.getValue<int>(data, "uSimLevel");
+
+    params.Relief      = procedure.getValue<float>(data, "uRelief");
+    params.Rain        = procedure.getValue<float>(data, "uRain");
+    params.Capacity    = procedure.getValue<float>(data, "uCapacity");
+    params.Erosion     = procedure.getValue<float>(data, "uErosion");
+    params.Deposition  = procedure.getValue<float>(data, "uDeposition");
+    params.Evaporation = procedure.getValue<float>(data, "uEvaporation");
+    params.Talus       = procedure.getValue<float>(data, "uTalus");
+    params.Thermal     = procedure.getValue<float>(data, "uThermal");
+
+    params.Tiling = tiling;
+
+    return params;
+}
+
+int ErosionParams::getSimResolution(int res) const {
+    return std::min(1 << SimLevel, res);
+}
+
+void ErosionParams::SetUniforms(Shader& shader) const {
+    static const Uniform<int> u_tiling("uTiling");
+    static const Uniform<float> u_rain("uRain"), u_capacity("uCapacity"), u_erosion("uErosion"),
+        u_deposition("uDeposition"), u_evaporation("uEvaporation"), u_talus("uTalus"), u_thermal("uThermal");
+
+    shader.setUniform(u_tiling, int(Tiling));
+    shader.setUniform(u_rain, Rain);
+    shader.setUniform(u_capacity, Capacity);
+    shader.setUniform(u_erosion, Erosion);
+    shader.setUniform(u_deposition, Deposition);
+    shader.setUniform(u_evaporation, Evaporation);
+    shader.setUniform(u_talus, Talus);
+    shader.setUniform(u_thermal, Thermal);
+}
+
+//===========================================================================
+
+ErosionStage::Resources::Resources(ResourceManager& manager) {
+    InitShader      = manager.RequestComputeShader("res/shaders/terrain/erosion_init.glsl");
+    FluxShader      = manager.RequestComputeShader("res/shaders/terrain/erosion_flux.glsl");
+    WaterShader     = manager.RequestComputeShader("res/shaders/terrain/erosion_water.glsl");
+    TransportShader = manager.RequestComputeShader("res/shaders/terrain/erosion_transport.glsl");
+    ApplyShader     = manager.RequestComputeShader("res/shaders/terrain/erosion_apply.glsl");
+}
+
+ErosionStage::ErosionStage(ResourceManager& manager, std::shared_ptr<const Resources> resources, bool tiling)
+    : m_Tiling(tiling)
+    , m_Resources(std::move(resources))
+{
+    //Textures are allocated with the first run, resized only when the resolution changes
+    //and released by the manager once the stage is gone
+    m_Input    = manager.RequestTexture2D("Erosion");
+    m_State[0] = manager.RequestTexture2D("Erosion");
+    m_State[1] = manager.RequestTexture2D("Erosion");
+    m_Flux[0]  = manager.RequestTexture2D("Erosion");
+    m_Flux[1]  = manager.RequestTexture2D("Erosion");
+    m_Velocity = manager.RequestTexture2D("Erosion");
+}
+
+void ErosionStage::OnStart(const DispatchRegion& region, const Procedure& procedure,
+                           const std::vector<InstanceData>& data)
+{
+    m_Params = ErosionParams::FromInstance(procedure, data, m_Tiling);
+
+    const int res = region.Size.x;
+    const int sim_res = m_Params.getSimResolution(res);
+
+    auto spec = [](int res, int internal_format, int format) {
+        return Texture2DSpec{
+            res, res, internal_format, format,
+            GL_FLOAT, GL_NEAREST, GL_NEAREST,
+            GL_CLAMP_TO_EDGE,
+            {0.0f, 0.0f, 0.0f, 0.0f}
+        };
+    };
+
+    if (res != m_Resolution)
+        m_Input->Initialize(spec(res, GL_R32F, GL_RED));
+
+    if (sim_res != m_SimResolution) {
+        for (int i = 0; i < 2; i++) {
+            m_State[i]->Initialize(spec(sim_res, GL_RGBA32F, GL_RGBA));
+            m_Flux[i]->Initialize(spec(sim_res, GL_RGBA32F, GL_RGBA));
+        }
+
+        m_Velocity->Initialize(spec(sim_res, GL_RG32F, GL_RG));
+    }
+
+    m_Resolution = res;
+    m_SimResolution = sim_res;
+    m_Iteration = 0;
+    m_FluxIndex = 0;
+
+    m_Flux[0]->Clear(0.0f, 0.0f, 0.0f, 0.0f);
+    m_Velocity->Clear(0.0f, 0.0f, 0.0f, 0.0f);
+
+    //Heightmap stays bound to image unit 0
+    m_Input->BindImage(1, 0);
+    m_State[0]->BindImage(2, 0);
+
+    static const Uniform<int> u_resolution("uResolution"), u_sim_resolution("uSimResolution");
+    static const Uniform<float> u_height_scale("uHeightScale");
+
+    auto& init_shader = *m_Resources->InitShader;
+
+    init_shader.Bind();
+    init_shader.setUniform(u_resolution, m_Resolution);
+    init_shader.setUniform(u_sim_resolution, m_SimResolution);
+    init_shader.setUniform(u_height_scale, float(m_SimResolution) * m_Params.Relief);
+
+    init_shader.Dispatch(m_SimResolution, m_SimResolution, 1);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+bool ErosionStage::OnStep(const Procedure& procedure, const std::vector<InstanceData>& data) {
+    LOFI_PROFILE_GPU("Map::Erosion");
+
+    const int steps = std::min(m_Params.StepsPerFrame, m_Params.Iterations - m_Iteration);
+
+    for (int i = 0; i < steps; i++)
+        Step();
+
+    m_Iteration += std::max(steps, 0);
+
+    return m_Iteration >= m_Params.Iterations;
+}
+
+void ErosionStage::Step() {
+    static const Uniform<int> u_sim_resolution("uSimResolution");
+
+    auto dispatch = [this](const std::shared_ptr<ComputeShader>& shader) {
+        shader->Bind();
+        shader->setUniform(u_sim_resolution, m_SimResolution);
+        m_Params.SetUniforms(*shader);
+
+        shader->Dispatch(m_SimResolution, m_SimResolution, 1);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    };
+
+    auto& flux_in  = m_Flux[m_FluxIndex];
+    auto& flux_out = m_Flux[m_FluxIndex ^ 1];
+
+    //Image units 1-5 are used, the heightmap stays bound to unit 0
+    m_State[0]->BindImage(1, 0);
+    flux_in->BindImage(3, 0);
+    flux_out->BindImage(4, 0);
+
+    dispatch(m_Resources->FluxShader);
+
+    m_State[0]->BindImage(1, 0);
+    m_State[1]->BindImage(2, 0);
+    flux_out->BindImage(3, 0);
+    m_Velocity->BindImage(5, 0);
+
+    dispatch(m_Resources->WaterShader);
+
+    m_State[1]->BindImage(1, 0);
+    m_State[0]->BindImage(2, 0);
+    m_Velocity->BindImage(5, 0);
+
+    dispatch(m_Resources->TransportShader);
+
+    m_FluxIndex ^= 1;
+}
+
+void ErosionStage::OnWrite(const DispatchRegion& region) {
+    m_Input->BindImage(1, 0);
+    m_State[0]->BindImage(2, 0);
+
+    static const Uniform<int> u_tiling("uTiling"), u_resolution("uResolution"), u_sim_resolution("uSimResolution");
+    static const Uniform<float> u_height_scale("uHeightScale");
+
+    auto& apply_shader = *m_Resources->ApplyShader;
+
+    apply_shader.Bind();
+    region.SetUniforms(apply_shader);
+    apply_shader.setUniform(u_tiling, int(m_Params.Tiling));
+    apply_shader.setUniform(u_resolution, m_Resolution);
+    apply_shader.setUniform(u_sim_resolution, m_SimResolution);
+    apply_shader.setUniform(u_height_scale, float(m_SimResolution) * m_Params.Relief);
+
+    apply_shader.Dispatch(region.Size.x, region.Size.y, 1);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+//===========================================================================
+//Cpu reference, each loop mirrors one of the erosion_*.glsl passes
+
+namespace {
+
+    const float DT = 0.05f;
+    const float G = 9.81f;
+
+    const int NEIGHBOURS[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+    typedef std::array<float, 4> Vec4;
+
+    struct Grid {
+        int Res;
+        bool Tiling;
+
+        int Wrap(int x) const {
+            if (Tiling)
+                return ((x % Res) + Res) % Res;
+
+            return std::clamp(x, 0, Res - 1);
+        }
+
+        bool Neighbour(int x, int y, int i, int& nx, int& ny) const {
+            nx = x + NEIGHBOURS[i][0];
+            ny = y + NEIGHBOURS[i][1];
+
+            if (Tiling) {
+                nx = Wrap(nx);
+                ny = Wrap(ny);
+                return true;
+            }
+
+            return nx >= 0 && ny >= 0 && nx < Res && ny < Res;
+        }
+
+        size_t Idx(int x, int y) const {
+            return size_t(y) * size_t(Res) + size_t(x);
+        }
+    };
+
+    float Mix(float a, float b, float t) {
+        return a + t * (b - a);
+    }
+
+    float Sign(float x) {
+        return (x > 0.0f) ? 1.0f : ((x < 0.0f) ? -1.0f : 0.0f);
+    }
+
+    //Bilinear interpolation of f(x, y) at pos, same as in the shaders
+    template<typename F>
+    float Bilinear(const Grid& grid, float px, float py, F f) {
+        const float bx = std::floor(px), by = std::floor(py);
+        const float tx = px - bx, ty = py - by;
+        const int x0 = int(bx), y0 = int(by);
+
+        auto at = [&](int x, int y) { return f(grid.Wrap(x), grid.Wrap(y)); };
+
+        return Mix(Mix(at(x0, y0), at(x0 + 1, y0), tx), Mix(at(x0, y0 + 1), at(x0 + 1, y0 + 1), tx), ty);
+    }
+}
+
+std::vector<float> ErodeReference(const std::vector<float>& heights, int res, const ErosionParams& params) {
+    const int sim_res = params.getSimResolution(res);
+    const float height_scale = float(sim_res) * params.Relief;
+
+    const Grid grid{ sim_res, params.Tiling };
+    const size_t count = size_t(sim_res) * size_t(sim_res);
+
+    std::vector<Vec4> state(count), next(count), flux(count, Vec4{}), flux_next(count);
+    std::vector<std::array<float, 2>> velocity(count, { 0.0f, 0.0f });
+
+    //erosion_init.glsl
+    const int k = res / sim_res;
+
+    for (int y = 0; y < sim_res; y++) {
+        for (int x = 0; x < sim_res; x++) {
+            float sum = 0.0f;
+
+            for (int j = 0; j < k; j++)
+                for (int i = 0; i < k; i++)
+                    sum += heights[size_t(k * y + j) * size_t(res) + size_t(k * x + i)];
+
+            const float b = height_scale * sum / float(k * k);
+            state[grid.Idx(x, y)] = { b, 0.0f, 0.0f, b };
+        }
+    }
+
+    for (int it = 0; it < params.Iterations; it++) {
+        //erosion_flux.glsl
+        for (int y = 0; y < sim_res; y++) {
+            for (int x = 0; x < sim_res; x++) {
+                const Vec4& s = state[grid.Idx(x, y)];
+                Vec4 f = flux[grid.Idx(x, y)];
+
+                const float water = s[1] + params.Rain;
+                const float surface = s[0] + water;
+
+                for (int i = 0; i < 4; i++) {
+                    int nx, ny;
+
+                    if (grid.Neighbour(x, y, i, nx, ny)) {
+                        const Vec4& sn = state[grid.Idx(nx, ny)];
+                        const float dh = surface - (sn[0] + sn[1] + params.Rain);
+
+                        f[i] = std::max(0.0f, f[i] + DT * G * dh);
+                    }
+
+                    else {
+                        f[i] = 0.0f;
+                    }
+                }
+
+                const float total = f[0] + f[1] + f[2] + f[3];
+
+                if (total > 0.0f) {
+                    const float fac = std::min(1.0f, water / (total * DT));
+
+                    for (auto& value : f)
+                        value *= fac;
+                }
+
+                flux_next[grid.Idx(x, y)] = f;
+            }
+        }
+
+        //erosion_water.glsl
+        for (int y = 0; y < sim_res; y++) {
+            for (int x = 0; x < sim_res; x++) {
+                const Vec4& s = state[grid.Idx(x, y)];
+                const Vec4& f = flux_next[grid.Idx(x, y)];
+
+                Vec4 fin{ 0.0f, 0.0f, 0.0f, 0.0f };
+                Vec4 bn{ s[0], s[0], s[0], s[0] };
+
+                for (int i = 0; i < 4; i++) {
+                    int nx, ny;
+
+                    if (grid.Neighbour(x, y, i, nx, ny)) {
+                        fin[i] = flux_next[grid.Idx(nx, ny)][i ^ 1];
+                        bn[i] = state[grid.Idx(nx, ny)][0];
+                    }
+                }
+
+                const float d1 = s[1] + params.Rain;
+                const float d2 = std::max(0.0f, d1 + DT * ((fin[0] + fin[1] + fin[2] + fin[3]) - (f[0] + f[1] + f[2] + f[3])));
+
+                const float wx = 0.5f * (fin[0] - f[0] + f[1] - fin[1]);
+                const float wy = 0.5f * (fin[2] - f[2] + f[3] - fin[3]);
+                const float depth = 0.5f * (d1 + d2);
+
+                const float vx = (depth > 1e-4f) ? wx / depth : 0.0f;
+                const float vy = (depth > 1e-4f) ? wy / depth : 0.0f;
+
+                const float gx = 0.5f * (bn[1] - bn[0]);
+                const float gy = 0.5f * (bn[3] - bn[2]);
+                const float g2 = gx * gx + gy * gy;
+                const float sin_tilt = std::max(std::sqrt(g2 / (1.0f + g2)), 0.05f);
+
+                const float capacity = params.Capacity * sin_tilt * std::sqrt(vx * vx + vy * vy) * std::min(d2, 1.0f);
+
+                float b = s[0], sediment = s[2];
+
+                if (capacity > sediment) {
+                    const float amount = params.Erosion * (capacity - sediment);
+                    b -= amount;
+                    sediment += amount;
+                }
+
+                else {
+                    const float amount = params.Deposition * (sediment - capacity);
+                    b += amount;
+                    sediment -= amount;
+                }
+
+                next[grid.Idx(x, y)] = { b, d2, sediment, s[3] };
+                velocity[grid.Idx(x, y)] = { vx, vy };
+            }
+        }
+
+        //erosion_transport.glsl
+        for (int y = 0; y < sim_res; y++) {
+            for (int x = 0; x < sim_res; x++) {
+                const Vec4& s = next[grid.Idx(x, y)];
+                const auto& v = velocity[grid.Idx(x, y)];
+
+                const float sediment = Bilinear(grid, float(x) - DT * v[0], float(y) - DT * v[1],
+                    [&](int sx, int sy) { return next[grid.Idx(sx, sy)][2]; });
+
+                const float water = s[1] * (1.0f - params.Evaporation * DT);
+
+                float delta = 0.0f;
+
+                for (int i = 0; i < 4; i++) {
+                    int nx, ny;
+
+                    if (grid.Neighbour(x, y, i, nx, ny)) {
+                        const float diff = next[grid.Idx(nx, ny)][0] - s[0];
+                        const float excess = std::abs(diff) - params.Talus;
+
+                        if (excess > 0.0f)
+                            delta += Sign(diff) * excess;
+                    }
+                }
+
+                const float b = s[0] + 0.125f * params.Thermal * delta;
+
+                state[grid.Idx(x, y)] = { b, water, sediment, s[3] };
+            }
+        }
+
+        std::swap(flux, flux_next);
+    }
+
+    //erosion_apply.glsl
+    std::vector<float> result(heights.size());
+
+    for (int y = 0; y < res; y++) {
+        for (int x = 0; x < res; x++) {
+            const float scale = float(sim_res) / float(res);
+            const float px = (float(x) + 0.5f) * scale - 0.5f;
+            const float py = (float(y) + 0.5f) * scale - 0.5f;
+
+            const float change = Bilinear(grid, px, py,
+                [&](int sx, int sy) { const Vec4& s = state[grid.Idx(sx, sy)]; return s[0] + s[2] - s[3]; });
+
+            const size_t idx = size_t(y) * size_t(res) + size_t(x);
+            result[idx] = heights[idx] + change / height_scale;
+        }
+    }
+
+    return result;
+}
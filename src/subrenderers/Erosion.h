@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TextureEditor.h"
+#include "Texture.h"
+#include "ResourceManager.h"
+
+#include <vector>
+#include <memory>
+
+//Hydraulic erosion based on the virtual pipe model from:
+//Mei, Decaudin, Hu - "Fast Hydraulic Erosion Simulation and Visualization on GPU" (2007)
+//followed by thermal erosion, which moves material exceeding the talus slope to lower neighbours.
+//Simulation grid has unit spacing and runs at reduced resolution, the heightmap
+//gets the (bilinearly upsampled) height change, so details of the input are kept.
+
+struct ErosionParams {
+    int Iterations = 200;
+    int StepsPerFrame = 8;
+    //Simulation resolution is 2^SimLevel, clamped to the heightmap resolution
+    int SimLevel = 10;
+
+    //Height corresponding to heightmap value 1.0, relative to the map width
+    float Relief = 0.1f;
+
+    //Water added to every texel each step
+    float Rain = 0.01f;
+    float Capacity = 0.05f;
+    float Erosion = 0.3f;
+    float Deposition = 0.3f;
+    float Evaporation = 0.02f;
+
+    //Height difference between neighbours above which material slides, in simulation texels
+    float Talus = 0.7f;
+    //Fraction of the excess moved per step
+    float Thermal = 0.1f;
+
+    bool Tiling = false;
+
+    //Values are read from tasks with matching uniform names (see MapGenerator::Init)
+    static ErosionParams FromInstance(const Procedure& procedure, const std::vector<InstanceData>& data, bool tiling);
+
+    int getSimResolution(int res) const;
+    void SetUniforms(Shader& shader) const;
+};
+
+class ErosionStage : public ProcedureStage {
+public:
+    //Shaders are shared by all erosion instances (see EditorBase::RegisterStage)
+    struct Resources {
+        Resources(ResourceManager& manager);
+
+        std::shared_ptr<ComputeShader> InitShader, FluxShader, WaterShader;
+        std::shared_ptr<ComputeShader> TransportShader, ApplyShader;
+    };
+
+    ErosionStage(ResourceManager& manager, std::shared_ptr<const Resources> resources, bool tiling);
+
+    void OnStart(const DispatchRegion& region, const Procedure& procedure,
+                 const std::vector<InstanceData>& data) override;
+    bool OnStep(const Procedure& procedure, const std::vector<InstanceData>& data) override;
+    void OnWrite(const DispatchRegion& region) override;
+
+private:
+    void Step();
+
+    ErosionParams m_Params;
+    bool m_Tiling;
+
+    int m_Resolution = 0, m_SimResolution = 0;
+    int m_Iteration = 0;
+    int m_FluxIndex = 0;
+
+    std::shared_ptr<const Resources> m_Resources;
+
+    //Full resolution copy of the input
+    std::shared_ptr<Texture2D> m_Input;
+    //State is (terrain, water, sediment, initial terrain), the result is always in m_State[0]
+    std::shared_ptr<Texture2D> m_State[2], m_Flux[2], m_Velocity;
+};
+
+//Deterministic single threaded cpu implementation of the same simulation (same passes, order of
+//operations and boundary handling), for validating the gpu stage. Runs all iterations at once,
+//heights are res x res values in row major order.
+std::vector<float> ErodeReference(const std::vector<float>& heights, int res, const ErosionParams& params);
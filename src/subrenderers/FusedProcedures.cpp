@@ -0,0 +1,274 @@
+#include "FusedProcedures.h"
+
+#include "glad/glad.h"
+
+#include <sstream>
+#include <regex>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+//Part of a procedure shader after the include of procedure.glsl, with other includes resolved.
+//Works on expanded sources (which may be embedded in the executable), so the include is found
+//as the expanded procedure.glsl.
+bool ReadProcedureBody(const std::string& filepath, std::string& body)
+{
+    std::string source, common;
+
+    try {
+        source = LoadShaderSource(filepath);
+        common = LoadShaderSource("res/shaders/terrain/procedure.glsl");
+    }
+
+    catch (const std::exception&) {
+        return false;
+    }
+
+    const auto position = source.find(common);
+
+    if (position == std::string::npos)
+        return false;
+
+    body = source.substr(position + common.size());
+    return true;
+}
+
+//Splits the body into uniform declarations (removed from it) and top level names which need
+//to be unique per instance (functions, constants, defines and uniforms)
+bool ParseProcedureBody(std::string& body, std::vector<std::pair<std::string, std::string>>& uniforms,
+                        std::vector<std::string>& names)
+{
+    const std::regex define_regex{ R"(^\s*#define\s+([A-Za-z_]\w*))" };
+    const std::regex declaration_regex{ R"(^(?:const\s+)?[A-Za-z_]\w*\s+([A-Za-z_]\w*)\s*[(=;])" };
+
+    std::istringstream input{ body };
+    std::string line, kept;
+
+    while (std::getline(input, line)) {
+        std::smatch match;
+
+        std::istringstream tokens{ line };
+        std::string keyword, type, name;
+        tokens >> keyword >> type >> name;
+
+        if (keyword == "uniform") {
+            name = name.substr(0, name.find(';'));
+
+            //Opaque types, arrays and initializers can't go into the parameter block
+            const bool opaque = type.find("sampler") != std::string::npos || type.find("image") != std::string::npos;
+
+            if (opaque || name.find('[') != std::string::npos || line.find('=') != std::string::npos) {
+                std::cerr << "Fused Procedures Error: Unsupported uniform declaration: " << line << '\n';
+                return false;
+            }
+
+            uniforms.emplace_back(type, name);
+            names.push_back(name);
+            continue;
+        }
+
+        if (std::regex_search(line, match, define_regex) || std::regex_search(line, match, declaration_regex))
+            names.push_back(match[1]);
+
+        kept += line + "\n";
+    }
+
+    body = kept;
+    return true;
+}
+
+FusedProcedures::FusedProcedures(ResourceManager& manager)
+    : m_ResourceManager(manager)
+{}
+
+FusedProcedures::~FusedProcedures()
+{
+    if (m_ParameterBuffer != 0)
+        glDeleteBuffers(1, &m_ParameterBuffer);
+}
+
+bool FusedProcedures::Dispatch(const std::unordered_map<std::string, Procedure>& procedures,
+                               const std::vector<ProcedureInstance>& instances,
+                               size_t first, size_t last, const DispatchRegion& region)
+{
+    //Procedure files may have changed
+    if (m_ShaderGeneration != m_ResourceManager.getShaderGeneration()) {
+        m_Kernels.clear();
+        m_ShaderGeneration = m_ResourceManager.getShaderGeneration();
+    }
+
+    std::string layout;
+
+    for (size_t i = first; i < last; i++)
+        layout += instances[i].Name + "\n";
+
+    if (!m_Kernels.count(layout)) {
+        //Every suffix of the stack may be dispatched after a checkpoint,
+        //so the number of layouts grows with editing
+        const size_t max_kernels = 32;
+
+        if (m_Kernels.size() >= max_kernels)
+            m_Kernels.clear();
+
+        m_Kernels.emplace(layout, Generate(procedures, instances, first, last));
+    }
+
+    const auto& kernel = m_Kernels.at(layout);
+
+    if (!kernel.Shader)
+        return false;
+
+    UploadParameters(kernel, instances, first);
+
+    kernel.Shader->Bind();
+    region.SetUniforms(*kernel.Shader);
+
+    kernel.Shader->Dispatch(region.Size.x, region.Size.y, 1);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    return true;
+}
+
+FusedProcedures::Kernel FusedProcedures::Generate(const std::unordered_map<std::string, Procedure>& procedures,
+                                                  const std::vector<ProcedureInstance>& instances,
+                                                  size_t first, size_t last) const
+{
+    Kernel kernel;
+
+    std::string block, functions, calls;
+
+    for (size_t i = first; i < last; i++) {
+        const auto& name = instances[i].Name;
+        const auto& procedure = procedures.at(name);
+
+        const std::string suffix = "_" + std::to_string(i - first);
+
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> uniforms;
+        std::vector<std::string> names;
+
+        if (!ReadProcedureBody(procedure.m_Filepath, body)) {
+            std::cerr << "Fused Procedures Error: " << name << " is not a procedure.glsl procedure\n";
+            return kernel;
+        }
+
+        if (!ParseProcedureBody(body, uniforms, names))
+            return kernel;
+
+        for (const auto& identifier : names)
+            body = std::regex_replace(body, std::regex("\\b" + identifier + "\\b"), identifier + suffix);
+
+        for (const auto& [type, uniform] : uniforms)
+            block += "    " + type + " " + uniform + suffix + ";\n";
+
+        functions += "//" + name + ":\n" + body + "\n";
+        calls += "    height = procedure" + suffix + "(height, uv);\n";
+    }
+
+    std::string source = "#version 450 core\n\n"
+        "layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;\n\n"
+        "layout(r32f, binding = 0) uniform image2D heightmap;\n\n";
+
+    source += LoadShaderSource("res/shaders/terrain/region.glsl") + "\n";
+
+    //Empty blocks aren't allowed
+    if (!block.empty())
+        source += "layout(std140, binding = 0) uniform ProcedureParameters {\n" + block + "};\n\n";
+
+    source += functions;
+
+    source += "void main() {\n"
+        "    if (!inRegion())\n"
+        "        return;\n\n"
+        "    ivec2 texel = getRegionTexel();\n"
+        "    ivec2 texelCoord = getStorageTexel(texel, imageSize(heightmap));\n"
+        "    vec2 uv = getRegionUV(texel);\n\n"
+        "    float height = imageLoad(heightmap, texelCoord).r;\n\n"
+        + calls +
+        "\n    imageStore(heightmap, texelCoord, vec4(height));\n"
+        "}\n";
+
+    std::string shader_name = "fused procedures (";
+
+    for (size_t i = first; i < last; i++)
+        shader_name += instances[i].Name + (i + 1 < last ? ", " : ")");
+
+    kernel.Shader = std::make_unique<ComputeShader>(shader_name, source);
+
+    if (!kernel.Shader->IsValid()) {
+        kernel.Shader.reset();
+        return kernel;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        const std::string suffix = "_" + std::to_string(i - first);
+
+        auto& offsets = kernel.Offsets.emplace_back();
+
+        for (const auto& task : procedures.at(instances[i].Name).m_Tasks) {
+            const int offset = kernel.Shader->getBlockMemberOffset(task->getUniformName() + suffix);
+            offsets.push_back(offset);
+
+            //Largest member (vec3) is padded to 16 bytes
+            if (offset >= 0)
+                kernel.BlockSize = std::max(kernel.BlockSize, size_t(offset) + 16);
+        }
+    }
+
+    return kernel;
+}
+
+void FusedProcedures::UploadParameters(const Kernel& kernel, const std::vector<ProcedureInstance>& instances, size_t first)
+{
+    if (kernel.BlockSize == 0)
+        return;
+
+    m_Parameters.assign(kernel.BlockSize, 0);
+
+    for (size_t i = 0; i < kernel.Offsets.size(); i++) {
+        const auto& data = instances[first + i].Data;
+
+        for (size_t j = 0; j < kernel.Offsets[i].size(); j++) {
+            const int offset = kernel.Offsets[i][j];
+
+            if (offset < 0)
+                continue;
+
+            char* dst = m_Parameters.data() + offset;
+
+            if (auto value = std::get_if<int>(&data[j]))
+                std::memcpy(dst, value, sizeof(int));
+
+            else if (auto value = std::get_if<float>(&data[j]))
+                std::memcpy(dst, value, sizeof(float));
+
+            else if (auto value = std::get_if<glm::vec3>(&data[j]))
+                std::memcpy(dst, glm::value_ptr(*value), 3 * sizeof(float));
+        }
+    }
+
+    if (m_ParameterBuffer == 0)
+        glGenBuffers(1, &m_ParameterBuffer);
+
+    //Stack dispatches run the same parameters many times per frame
+    if (m_Parameters != m_UploadedParameters) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_ParameterBuffer);
+
+        if (m_Parameters.size() > m_BufferSize) {
+            glBufferData(GL_UNIFORM_BUFFER, m_Parameters.size(), m_Parameters.data(), GL_DYNAMIC_DRAW);
+            m_BufferSize = m_Parameters.size();
+        }
+
+        else {
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, m_Parameters.size(), m_Parameters.data());
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        m_UploadedParameters = m_Parameters;
+    }
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_ParameterBuffer);
+}
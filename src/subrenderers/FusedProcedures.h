@@ -0,0 +1,52 @@
+#pragma once
+
+#include "TextureEditor.h"
+#include "ResourceManager.h"
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+//Runs consecutive procedure instances as a single generated compute shader, so the height stays
+//in a register between procedures instead of going through the image after each of them.
+//Procedure shaders have to follow terrain/procedure.glsl: everything after its include is copied
+//once per instance, with top level names suffixed by the instance position and uniforms moved
+//into a std140 block, which is filled from the instance data.
+class FusedProcedures {
+public:
+    FusedProcedures(ResourceManager& manager);
+    ~FusedProcedures();
+
+    //Dispatches instances [first, last), none of which may be a stage. Returns false if the
+    //kernel couldn't be generated, in which case instances have to be dispatched one by one.
+    bool Dispatch(const std::unordered_map<std::string, Procedure>& procedures,
+                  const std::vector<ProcedureInstance>& instances,
+                  size_t first, size_t last, const DispatchRegion& region);
+
+private:
+    struct Kernel {
+        //Null if the kernel couldn't be generated
+        std::unique_ptr<ComputeShader> Shader;
+
+        //Offsets of task uniforms in the parameter block (per instance, per task), -1 if unused
+        std::vector<std::vector<int>> Offsets;
+        size_t BlockSize = 0;
+    };
+
+    Kernel Generate(const std::unordered_map<std::string, Procedure>& procedures,
+                    const std::vector<ProcedureInstance>& instances,
+                    size_t first, size_t last) const;
+
+    void UploadParameters(const Kernel& kernel, const std::vector<ProcedureInstance>& instances, size_t first);
+
+    ResourceManager& m_ResourceManager;
+
+    //Kernels depend only on the procedure names, so they are rebuilt
+    //only if the instances are added, removed or reordered
+    std::unordered_map<std::string, Kernel> m_Kernels;
+    size_t m_ShaderGeneration = 0;
+
+    unsigned int m_ParameterBuffer = 0;
+    size_t m_BufferSize = 0;
+    std::vector<char> m_Parameters, m_UploadedParameters;
+};
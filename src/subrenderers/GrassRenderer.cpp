@@ -20,19 +20,22 @@ GrassRenderer::GrassRenderer(ResourceManager& manager, const PerspectiveCamera&
 	m_RaycastShader = m_ResourceManager.RequestComputeShader("res/shaders/grass/raycast.glsl");
 	m_NoiseGenerator = m_ResourceManager.RequestComputeShader("res/shaders/grass/noise.glsl");
 	m_DisplaceShader = m_ResourceManager.RequestComputeShader("res/shaders/displace.glsl");
+	m_CullShader = m_ResourceManager.RequestComputeShader("res/shaders/clipmap_cull.glsl");
 
 	m_PresentShader = m_ResourceManager.RequestVertFragShader(
 		"res/shaders/grass/present.vert", 
 		"res/shaders/grass/present.frag"
 	);
 
-	m_RaycastResult = m_ResourceManager.RequestTexture3D();
-	m_Noise = m_ResourceManager.RequestTexture2D();
+	m_RaycastResult = m_ResourceManager.RequestTexture3D("Grass");
+	m_Noise = m_ResourceManager.RequestTexture2D("Grass");
+
+	m_ResourceManager.RegisterBufferSource("Grass", [this]() { return m_Clipmap.getMemoryUsage(); });
 }
 
-void GrassRenderer::Init()
+void GrassRenderer::Init(ClipmapMode mode)
 {
-	m_Clipmap.Init(32, 5);
+	m_Clipmap.Init(32, 5, mode);
 
 	m_RaycastResult->Initialize(Texture3DSpec{
 		128, 128, 16,
@@ -60,6 +63,7 @@ void GrassRenderer::OnUpdate(float deltatime)
 	if (m_Time > 1e3) m_Time = 0.0f;
 
 	UpdateGeometry();
+	CullGeometry();
 
 	if ((m_UpdateFlags & Raycast) != None)
 		UpdateRaycast();
@@ -72,7 +76,7 @@ void GrassRenderer::OnUpdate(float deltatime)
 
 void GrassRenderer::UpdateRaycast()
 {
-	ProfilerGPUEvent we("Grass::Raycast");
+	LOFI_PROFILE_GPU("Grass::Raycast");
 
 	auto res_x = m_RaycastResult->getSpec().ResolutionX;
 	auto res_y = m_RaycastResult->getSpec().ResolutionY;
@@ -98,7 +102,7 @@ void GrassRenderer::UpdateRaycast()
 
 void GrassRenderer::UpdateNoise() 
 {
-	ProfilerGPUEvent we("Grass::NoiseGen");
+	LOFI_PROFILE_GPU("Grass::NoiseGen");
 
 	auto res_x = m_Noise->getSpec().ResolutionX;
 	auto res_y = m_Noise->getSpec().ResolutionY;
@@ -113,22 +117,27 @@ void GrassRenderer::UpdateNoise()
 
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 
-	m_Noise->Bind();
-	glGenerateMipmap(GL_TEXTURE_2D);
+	m_Noise->GenerateMips();
 
 	m_ResourceManager.RequestPreviewUpdate(m_Noise);
 }
 
 void GrassRenderer::UpdateGeometry()
 {
+	//Heights are sampled in the vertex shader, no geometry work is needed
+	if (m_Clipmap.SamplesHeight())
+	{
+		m_UpdateAllLevels = false;
+		return;
+	}
+
 	m_Map.BindHeightmap();
 
 	const glm::vec2 curr{ m_Camera.getPos().x, m_Camera.getPos().z };
 
 	m_DisplaceShader->Bind();
 	m_DisplaceShader->setUniform2f("uPos", curr);
-	m_DisplaceShader->setUniform1f("uScaleXZ", m_Map.getScaleXZ());
-	m_DisplaceShader->setUniform1f("uScaleY", m_Map.getScaleY());
+	m_Map.BindHeightStack(*m_DisplaceShader, 1);
 
 	const uint32_t binding_id = 1;
 
@@ -147,6 +156,20 @@ void GrassRenderer::UpdateGeometry()
 	m_UpdateAllLevels = false;
 }
 
+void GrassRenderer::CullGeometry()
+{
+	LOFI_PROFILE_GPU("Grass::Cull");
+
+	m_Map.BindHeightmap(0);
+
+	m_CullShader->Bind();
+	m_CullShader->setUniform1i("heightmap", 0);
+	m_CullShader->setUniform1i("uOcclusion", 0);
+	m_Map.BindHeightStack(*m_CullShader, 2);
+
+	m_Clipmap.Cull(m_CullShader, m_Camera, m_LodLevels);
+}
+
 void GrassRenderer::OnImGui(bool& open)
 {
 	ImGui::Begin(LOFI_ICONS_GRASS "Grass", &open, ImGuiWindowFlags_NoFocusOnAppearing);
@@ -228,17 +251,9 @@ void GrassRenderer::Render()
 	if (!m_RenderGrass) return;
 
 	{
-		ProfilerGPUEvent we("Grass::Prepare");
-
-		const glm::mat4 mvp = m_Camera.getViewProjMatrix();
+		LOFI_PROFILE_GPU("Grass::Prepare");
 
 		m_PresentShader->Bind();
-		m_PresentShader->setUniform1f("uL", m_Map.getScaleXZ());
-		m_PresentShader->setUniform3f("uPos", m_Camera.getPos());
-		m_PresentShader->setUniformMatrix4fv("uMVP", mvp);
-
-		m_PresentShader->setUniform3f("uLightDir", m_Sky.getSunDir());
-		m_PresentShader->setUniform3f("uSunCol", m_Sky.getSunCol());
 		m_PresentShader->setUniform1f("uSunStr", m_SunStr);
 		m_PresentShader->setUniform1f("uSkyDiff", m_SkyDiff);
 		m_PresentShader->setUniform1f("uSkySpec", m_SkySpec);
@@ -275,28 +290,18 @@ void GrassRenderer::Render()
 		m_PresentShader->setUniform1i("irradiance", 4);
 		m_Sky.BindPrefiltered(5);
 		m_PresentShader->setUniform1i("prefiltered", 5);
-	}
-
-	{
-		ProfilerGPUEvent we("Grass::Draw");
-
-		auto scale_y = m_Map.getScaleY();
 
-		for (uint32_t i=0; i<m_Clipmap.MaxGridIDUpTo(m_LodLevels); i++)
-		{
-			const auto& grid = m_Clipmap.getGrids()[i];
+		m_PresentShader->setUniform1i("uInstanced", int(m_Clipmap.getMode() == ClipmapMode::Instanced));
 
-			if (m_Camera.IsInFrustum(grid.BoundingBox, scale_y))
-			{
-				grid.Draw();
-			}
-		}
+		m_PresentShader->setUniform1i("uSampleHeight", int(m_Clipmap.SamplesHeight()));
+		m_Map.BindHeightmap(6);
+		m_PresentShader->setUniform1i("heightmap", 6);
+		m_Map.BindHeightStack(*m_PresentShader, 7);
+	}
 
-		for (uint32_t i = 0; i < m_Clipmap.MaxFillIDUpTo(m_LodLevels); i++)
-		{
-			const auto& fill = m_Clipmap.getFills()[i];
+	{
+		LOFI_PROFILE_GPU("Grass::Draw");
 
-			fill.Draw();
-		}
+		m_Clipmap.Draw();
 	}
 }
\ No newline at end of file
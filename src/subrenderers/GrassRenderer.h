@@ -18,7 +18,7 @@ public:
 		          const MapGenerator& map, const MaterialGenerator& material,
 		          const SkyRenderer& sky);
 
-	void Init();
+	void Init(ClipmapMode mode);
 	void OnUpdate(float deltatime);
 	void OnImGui(bool& open);
 
@@ -28,6 +28,7 @@ private:
 	void UpdateRaycast();
 	void UpdateNoise();
 	void UpdateGeometry();
+	void CullGeometry();
 
 	//===Temporary - those values are doubled in TerrainRenderer=====================
 
@@ -75,6 +76,7 @@ private:
 	std::shared_ptr<ComputeShader> m_RaycastShader;
 	std::shared_ptr<ComputeShader> m_NoiseGenerator;
 	std::shared_ptr<ComputeShader> m_DisplaceShader;
+	std::shared_ptr<ComputeShader> m_CullShader;
 
 	std::shared_ptr<Texture3D> m_RaycastResult;
 	std::shared_ptr<Texture2D> m_Noise;
@@ -1,4 +1,6 @@
 #include "MapGenerator.h"
+#include "Erosion.h"
+#include "CpuProcedures.h"
 
 #include "Profiler.h"
 
@@ -9,6 +11,8 @@
 #include "ImGuiIcons.h"
 
 #include <iostream>
+#include <fstream>
+#include <cmath>
 
 MapGenerator::MapGenerator(ResourceManager& manager)
     : m_ResourceManager(manager)
@@ -18,11 +22,21 @@ MapGenerator::MapGenerator(ResourceManager& manager)
     m_NormalmapShader = m_ResourceManager.RequestComputeShader("res/shaders/terrain/normal.glsl");
     m_ShadowmapShader = m_ResourceManager.RequestComputeShader("res/shaders/terrain/shadow.glsl");
     m_MipShader       = m_ResourceManager.RequestComputeShader("res/shaders/terrain/maximal_mip.glsl");
+    m_AverageMipShader = m_ResourceManager.RequestComputeShader("res/shaders/terrain/average_mip.glsl");
 
-    m_Heightmap   = m_ResourceManager.RequestTexture2D();
-    m_Normalmap   = m_ResourceManager.RequestTexture2D();
-    m_Shadowmap   = m_ResourceManager.RequestTexture2D();
-    m_Materialmap = m_ResourceManager.RequestTexture2D();
+    m_BrushShader       = m_ResourceManager.RequestComputeShader("res/shaders/terrain/brush.glsl");
+    m_PickShader        = m_ResourceManager.RequestComputeShader("res/shaders/terrain/brush_pick.glsl");
+    m_SculptApplyShader = m_ResourceManager.RequestComputeShader("res/shaders/terrain/sculpt_apply.glsl");
+
+    m_Heightmap   = m_ResourceManager.RequestTexture2D("Map");
+    m_Normalmap   = m_ResourceManager.RequestTexture2D("Map");
+    m_Shadowmap   = m_ResourceManager.RequestTexture2D("Map");
+    m_Materialmap = m_ResourceManager.RequestTexture2D("Map");
+    m_SculptLayer = m_ResourceManager.RequestTexture2D("Map");
+}
+
+MapGenerator::~MapGenerator() {
+    glDeleteBuffers(2, m_PickBuffers);
 }
 
 void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
@@ -36,8 +50,7 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
         {0.0f, 0.0f, 0.0f, 0.0f}
     });
 
-    m_Heightmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    m_Heightmap->GenerateMips();
 
     //-----Normal map: 
     m_Normalmap->Initialize(Texture2DSpec{
@@ -48,8 +61,7 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
         {0.5f, 1.0f, 0.5f, 1.0f}
     });
 
-    m_Normalmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    m_Normalmap->GenerateMips();
 
     //-----Shadow map
     m_Shadowmap->Initialize(Texture2DSpec{
@@ -59,8 +71,7 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
         {1.0f, 1.0f, 1.0f, 1.0f}
     });
 
-    m_Shadowmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    m_Shadowmap->GenerateMips();
 
     //--Material map
     m_Materialmap->Initialize(Texture2DSpec{
@@ -70,8 +81,26 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
         {1.0f, 0.0f, 0.0f, 0.0f}
     });
 
-    m_Materialmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    m_Materialmap->GenerateMips();
+
+    //--Sculpt layer, no offsets initially
+    m_SculptLayer->Initialize(Texture2DSpec{
+        height_res, height_res, GL_R32F, GL_RED,
+        GL_FLOAT, GL_NEAREST, GL_NEAREST,
+        GL_CLAMP_TO_EDGE,
+        {0.0f, 0.0f, 0.0f, 0.0f}
+    });
+
+    m_SculptLayer->Clear(0.0f, 0.0f, 0.0f, 0.0f);
+
+    glGenBuffers(2, m_PickBuffers);
+
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_PickBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4), nullptr, GL_DYNAMIC_READ);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
     //-----Setup heightmap editor:
     std::vector<std::string> labels{ "Average", "Add", "Subtract" };
@@ -103,6 +132,37 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
     m_HeightEditor.Attach<SliderFloatTask>("Radial cutoff", "uBias", "Bias", 0.0, 1.0, 0.5);
     m_HeightEditor.Attach<SliderFloatTask>("Radial cutoff", "uSlope", "Slope", 0.0, 10.0, 4.0);
 
+    //Iterative, runs for a number of steps per frame (see Erosion.h)
+    m_HeightEditor.RegisterStage<ErosionStage>("Erosion", wrap_type == GL_REPEAT);
+    m_HeightEditor.Attach<SliderIntTask>("Erosion", "uIterations", "Iterations", 1, 2000, 200);
+    m_HeightEditor.Attach<SliderIntTask>("Erosion", "uStepsPerFrame", "Steps per frame", 1, 64, 8);
+    m_HeightEditor.Attach<SliderIntTask>("Erosion", "uSimLevel", "Resolution (log2)", 8, 12, 10);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uRelief", "Relief", 0.01, 0.5, 0.1);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uRain", "Rain", 0.0, 0.05, 0.01);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uCapacity", "Capacity", 0.0, 1.0, 0.05);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uErosion", "Erosion", 0.0, 1.0, 0.3);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uDeposition", "Deposition", 0.0, 1.0, 0.3);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uEvaporation", "Evaporation", 0.0, 0.5, 0.02);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uTalus", "Talus", 0.0, 4.0, 0.7);
+    m_HeightEditor.Attach<SliderFloatTask>("Erosion", "uThermal", "Thermal", 0.0, 1.0, 0.1);
+
+    //Cpu versions of the procedures, used with setCpuProcedures
+    using namespace std::placeholders;
+
+    m_HeightEditor.AttachCpu("Const Value", ConstValueCpu);
+    m_HeightEditor.AttachCpu("FBM", FbmCpu);
+    m_HeightEditor.AttachCpu("Voronoi", VoronoiCpu);
+    m_HeightEditor.AttachCpu("Curves", CurvesCpu);
+    m_HeightEditor.AttachCpu("Radial cutoff", RadialCutoffCpu);
+    m_HeightEditor.AttachCpu("Erosion", std::bind(ErosionCpu, _1, _2, _3, _4, _5, wrap_type == GL_REPEAT));
+
+    //Editing late procedures resumes from copies of the heightmap after earlier ones
+    const size_t checkpoint_budget = size_t(256) << 20;
+    m_HeightEditor.EnableCheckpoints(m_Heightmap, checkpoint_budget);
+
+    //Runs procedures between stages in a single pass
+    m_HeightEditor.SetFusion(true);
+
     //Initial procedures:
     m_HeightEditor.AddProcedureInstance("Const Value");
     m_HeightEditor.AddProcedureInstance("FBM");
@@ -129,8 +189,10 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
     //Initial procedures:
     m_MaterialEditor.AddProcedureInstance("One material");
 
+    m_Tiling = (wrap_type == GL_REPEAT);
+
     //-----Set update flags
-    m_UpdateFlags = Height | Normal | Shadow | Material;
+    RequestUpdate(Height | Normal | Shadow | Material);
 
     //-----Mipmap related things
     
@@ -160,54 +222,146 @@ void MapGenerator::Init(int height_res, int shadow_res, int wrap_type) {
 }
 
 void MapGenerator::UpdateHeight() {
-    ProfilerGPUEvent we("Map::UpdateHeight");
-
-    const int res = m_Heightmap->getSpec().ResolutionX;
+    LOFI_PROFILE_GPU("Map::UpdateHeight");
 
     m_Heightmap->BindImage(0, 0);
-    m_HeightEditor.OnDispatch(res);
+
+    if (!m_CpuProcedures || !UpdateHeightCpu())
+        m_HeightEditor.OnDispatch(m_HeightRegion);
+
+    ApplySculptLayer(m_HeightRegion);
 
     m_Heightmap->Bind();
 
-    GenMaxMips();
+    GenMaxMips(m_HeightRegion);
 
     m_ResourceManager.RequestPreviewUpdate(m_Heightmap);
 }
 
-void MapGenerator::UpdateNormal() {
-    ProfilerGPUEvent we("Map::UpdateNormal");
+bool MapGenerator::UpdateHeightCpu() {
+    LOFI_PROFILE_CPU("Map::UpdateHeightCpu");
+
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    DispatchRegion region = m_HeightRegion;
+
+    if (!m_HeightEditor.OnDispatchCpu(m_CpuHeights, res, region))
+        return false;
+
+    const float* origin = m_CpuHeights.data() + size_t(region.Offset.y) * size_t(res) + size_t(region.Offset.x);
+    m_Heightmap->SetData(origin, res, region.Offset.x, region.Offset.y, region.Size.x, region.Size.y);
+
+    //Stages changed the entire map
+    if (IsFull(region) && !IsFull(m_HeightRegion)) {
+        m_HeightRegion = region;
+        RequestUpdate(Normal | Material, region);
+    }
+
+    return true;
+}
+
+float MapGenerator::ValidateCpuProcedures() {
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    DispatchRegion region = DispatchRegion::Full(res);
 
-    const int res = m_Normalmap->getSpec().ResolutionX;
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    //Both start from the current content, in case the first procedure reads it
+    std::vector<float> cpu_heights = m_Heightmap->GetData();
+
+    if (!m_HeightEditor.OnDispatchCpu(cpu_heights, res, region))
+        return -1.0f;
+
+    //Stages take multiple dispatches on the gpu
+    m_Heightmap->BindImage(0, 0);
+
+    do {
+        m_HeightEditor.OnDispatch(region);
+    } while (m_HeightEditor.IsPending());
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    const std::vector<float> gpu_heights = m_Heightmap->GetData();
+
+    float max_error = 0.0f;
+
+    for (size_t i = 0; i < gpu_heights.size(); i++) {
+        const float error = std::abs(cpu_heights[i] - gpu_heights[i]);
+
+        //Nan on only one side counts as a mismatch
+        if (std::isnan(error) && std::isnan(cpu_heights[i]) != std::isnan(gpu_heights[i]))
+            return INFINITY;
+
+        if (error > max_error)
+            max_error = error;
+    }
+
+    //Heightmap gets the sculpt layer and mips again
+    RequestUpdate(Height | Normal | Material);
+
+    return max_error;
+}
+
+void MapGenerator::UpdateNormal() {
+    LOFI_PROFILE_GPU("Map::UpdateNormal");
 
     m_Heightmap->Bind();
     m_Normalmap->BindImage(0, 0);
  
     m_NormalmapShader->Bind();
+    m_NormalRegion.SetUniforms(*m_NormalmapShader);
     m_NormalmapShader->setUniform1f("uScaleXZ", m_ScaleXZ);
     m_NormalmapShader->setUniform1f("uScaleY" , m_ScaleY );
 
     m_NormalmapShader->setUniform1i("uAOSamples", m_AOSettings.Samples);
     m_NormalmapShader->setUniform1f("uAOR", m_AOSettings.R);
 
-    m_NormalmapShader->Dispatch(res, res, 1);
+    m_NormalmapShader->Dispatch(m_NormalRegion.Size.x, m_NormalRegion.Size.y, 1);
     
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 
-    m_Normalmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GenAverageMips(*m_Normalmap, m_NormalRegion);
 
     m_ResourceManager.RequestPreviewUpdate(m_Normalmap);
 }
 
 void MapGenerator::UpdateShadow(const glm::vec3& sun_dir) {
-    ProfilerGPUEvent we("Map::UpdateShadow");
+    LOFI_PROFILE_GPU("Map::UpdateShadow");
 
     const int res = m_Shadowmap->getSpec().ResolutionX;
+    const int height_res = m_Heightmap->getSpec().ResolutionX;
+
+    DispatchRegion region = DispatchRegion::Full(res);
+
+    //Sun direction as used in terrain/shadow.glsl
+    const glm::vec3 dir3 = glm::normalize(glm::vec3(m_ScaleY * sun_dir.x, m_ScaleXZ * sun_dir.y, m_ScaleY * sun_dir.z));
+    const float horizontal = dir3.x * dir3.x + dir3.z * dir3.z;
+
+    if (!IsFull(m_ShadowRegion) && dir3.y > 0.0f && horizontal > 0.0f) {
+        const float scale = float(res) / float(height_res);
+
+        glm::vec2 lo = glm::floor(scale * glm::vec2(m_ShadowRegion.Offset));
+        glm::vec2 hi = glm::ceil(scale * glm::vec2(m_ShadowRegion.Offset + m_ShadowRegion.Size));
+
+        //Changed heights only shadow texels lying away from the sun, up to the distance
+        //where sun rays get above all terrain (heights are assumed to stay below 2)
+        const float max_height = 2.0f;
+        const float dist = max_height * float(res) * horizontal / dir3.y;
+        const glm::vec2 away = -dist * glm::normalize(glm::vec2(dir3.x, dir3.z));
+
+        lo = glm::clamp(glm::min(lo, lo + away), glm::vec2(0.0f), glm::vec2(float(res)));
+        hi = glm::clamp(glm::max(hi, hi + away), glm::vec2(0.0f), glm::vec2(float(res)));
+
+        region.Offset = glm::ivec2(lo);
+        region.Size = glm::ivec2(hi) - region.Offset;
+    }
 
     m_Heightmap->Bind();
     m_Shadowmap->BindImage(0, 0);
  
     m_ShadowmapShader->Bind();
+    region.SetUniforms(*m_ShadowmapShader);
     m_ShadowmapShader->setUniform1i("uResolution", res);
     m_ShadowmapShader->setUniform3f("uSunDir", sun_dir);
     m_ShadowmapShader->setUniform1f("uScaleXZ", m_ScaleXZ);
@@ -221,36 +375,34 @@ void MapGenerator::UpdateShadow(const glm::vec3& sun_dir) {
     m_ShadowmapShader->setUniform1i("uSoftShadows", m_ShadowSettings.Soft);
     m_ShadowmapShader->setUniform1f("uSharpness", m_ShadowSettings.Sharpness);
 
-    m_ShadowmapShader->Dispatch(res, res, 1);
+    m_ShadowmapShader->Dispatch(region.Size.x, region.Size.y, 1);
     
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 
-    m_Shadowmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GenAverageMips(*m_Shadowmap, region);
 
     m_ResourceManager.RequestPreviewUpdate(m_Shadowmap);
 }
 
 void MapGenerator::UpdateMaterial() {
-    ProfilerGPUEvent we("Map::UpdateMaterial");
-
-    const int res = m_Materialmap->getSpec().ResolutionX;
+    LOFI_PROFILE_GPU("Map::UpdateMaterial");
 
     m_Heightmap->Bind();
 
     m_Materialmap->BindImage(0, 0);
-    m_MaterialEditor.OnDispatch(res);
+    m_MaterialEditor.OnDispatch(m_MaterialRegion);
 
-    m_Materialmap->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GenAverageMips(*m_Materialmap, m_MaterialRegion);
 
     m_ResourceManager.RequestPreviewUpdate(m_Materialmap);
 }
 
-void MapGenerator::GenMaxMips() {
+void MapGenerator::GenMaxMips(const DispatchRegion& region) {
     if (m_MipLevels == 0) return;
 
-    const int res = m_Heightmap->getSpec().ResolutionX;
+    //Texels of the region in current mip, max is exclusive
+    glm::ivec2 lo = region.Offset;
+    glm::ivec2 hi = region.Offset + region.Size;
 
     for (int i = 0; i < m_MipLevels; i++) {
         m_MipShader->Bind();
@@ -262,18 +414,64 @@ void MapGenerator::GenMaxMips() {
 
         //We don't set uniforms for binding ids since they are set in shader code
 
-        //Number of work groups for compute shader
-        const int size = std::max((res / int(pow(2, i + 1))) / 32, 1);
+        //Footprint of the region in the lower res mip
+        lo = lo / 2;
+        hi = (hi + 1) / 2;
+
+        m_MipShader->setUniform2i("uRegionOffset", lo);
+        m_MipShader->setUniform2i("uRegionSize", hi - lo);
+
+        m_MipShader->Dispatch(hi.x - lo.x, hi.y - lo.y, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+}
+
+void MapGenerator::GenAverageMips(Texture2D& texture, const DispatchRegion& region) {
+    const int res = texture.getSpec().ResolutionX;
+
+    if (!texture.hasMips() || (region.Size.x >= res && region.Size.y >= res)) {
+        texture.GenerateMips();
+        return;
+    }
+
+    static const Uniform<int> u_source_level("uSourceLevel");
+    static const Uniform<glm::ivec2> u_region_offset("uRegionOffset"), u_region_size("uRegionSize");
+
+    //Texels of the region in current mip, max is exclusive
+    glm::ivec2 lo = region.Offset;
+    glm::ivec2 hi = region.Offset + region.Size;
+
+    m_AverageMipShader->Bind();
+    texture.Bind(1);
+
+    for (int level = 0; (res >> level) > 1; level++) {
+        texture.BindImage(0, level + 1);
 
-        glDispatchCompute(size, size, 1);
+        //Footprint of the region in the lower res mip
+        lo = lo / 2;
+        hi = (hi + 1) / 2;
+
+        m_AverageMipShader->setUniform(u_source_level, level);
+        m_AverageMipShader->setUniform(u_region_offset, lo);
+        m_AverageMipShader->setUniform(u_region_size, hi - lo);
+
+        m_AverageMipShader->Dispatch(hi.x - lo.x, hi.y - lo.y, 1);
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
     }
 }
 
 void MapGenerator::Update(const glm::vec3& sun_dir) {
-    if ((m_UpdateFlags & Height) != None)
+    const bool shadows_requested = (m_UpdateFlags & Shadow) != None;
+
+    if ((m_UpdateFlags & Height) != None) {
         UpdateHeight();
 
+        //Procedures changed, stack is regenerated with next camera update.
+        //Local edits (sculpting) and continued stages don't affect the stack
+        if (IsFull(m_HeightRegion) && !m_ContinueStages)
+            m_StackValid = false;
+    }
+
     if ((m_UpdateFlags & Normal) != None)
         UpdateNormal();
 
@@ -284,6 +482,342 @@ void MapGenerator::Update(const glm::vec3& sun_dir) {
         UpdateMaterial();
 
     m_UpdateFlags = None;
+
+    //Unfinished stages (erosion) continue with the next frame,
+    //shadows are updated once, with the final heights
+    if (m_HeightEditor.IsPending()) {
+        RequestUpdate(Height | Normal | Material);
+
+        m_ContinueStages = true;
+        m_DeferredShadows = m_DeferredShadows || shadows_requested;
+    }
+
+    else {
+        m_ContinueStages = false;
+
+        if (m_DeferredShadows) {
+            RequestUpdate(Shadow);
+            m_DeferredShadows = false;
+        }
+    }
+}
+
+void MapGenerator::InitHeightStack(int res, int layers, float extent) {
+    m_HeightStack = m_ResourceManager.RequestTextureArray("Map");
+
+    //Repeat wrapping implements toroidal addressing in samplers
+    m_HeightStack->Initialize(Texture2DSpec{
+        res, res, GL_R32F, GL_RED,
+        GL_FLOAT, GL_LINEAR, GL_LINEAR,
+        GL_REPEAT,
+        {0.0f, 0.0f, 0.0f, 0.0f}
+    }, layers);
+
+    m_StackLayers = layers;
+    m_StackRes = res;
+    m_StackExtent = 1.25f * extent / std::pow(2.0f, float(layers - 1));
+
+    m_StackOrigins.assign(layers, glm::ivec2(0));
+    m_StackValid = false;
+}
+
+bool MapGenerator::UpdateHeightStack(const glm::vec3& cam_pos) {
+    if (m_StackLayers == 0)
+        return false;
+
+    LOFI_PROFILE_GPU("Map::UpdateHeightStack");
+
+    const bool full_update = !m_StackValid || (m_StackScaleXZ != m_ScaleXZ);
+
+    m_StackCenter = glm::vec2(cam_pos.x, cam_pos.z) / m_ScaleXZ + 0.5f;
+
+    bool regenerated = false;
+
+    for (int layer = 0; layer < m_StackLayers; layer++) {
+        const float texel_size = m_StackExtent * std::pow(2.0f, float(layer)) / (m_ScaleXZ * float(m_StackRes));
+
+        const glm::ivec2 prev = m_StackOrigins[layer];
+        const glm::ivec2 curr = glm::ivec2(glm::floor(m_StackCenter / texel_size)) - m_StackRes / 2;
+        const glm::ivec2 delta = curr - prev;
+
+        m_StackOrigins[layer] = curr;
+
+        if (delta == glm::ivec2(0) && !full_update)
+            continue;
+
+        if (full_update || std::abs(delta.x) >= m_StackRes || std::abs(delta.y) >= m_StackRes) {
+            UpdateStackRegion(layer, curr, glm::ivec2(m_StackRes));
+            regenerated = true;
+            continue;
+        }
+
+        //Texels which stay in the layer keep their values, heights depend only on the position
+
+        //Columns exposed by horizontal movement, full height of the layer
+        if (delta.x != 0) {
+            const int x = (delta.x > 0) ? prev.x + m_StackRes : curr.x;
+            UpdateStackRegion(layer, glm::ivec2(x, curr.y), glm::ivec2(std::abs(delta.x), m_StackRes));
+        }
+
+        //Rows exposed by vertical movement, without the columns updated above
+        if (delta.y != 0) {
+            const int y = (delta.y > 0) ? prev.y + m_StackRes : curr.y;
+            const int x = std::max(prev.x, curr.x);
+            UpdateStackRegion(layer, glm::ivec2(x, y), glm::ivec2(m_StackRes - std::abs(delta.x), std::abs(delta.y)));
+        }
+    }
+
+    m_StackScaleXZ = m_ScaleXZ;
+    m_StackValid = true;
+
+    return regenerated;
+}
+
+void MapGenerator::UpdateStackRegion(int layer, glm::ivec2 offset, glm::ivec2 size) {
+    DispatchRegion region;
+    region.Offset = offset;
+    region.Size = size;
+    region.Toroidal = true;
+    region.TexelSize = m_StackExtent * std::pow(2.0f, float(layer)) / (m_ScaleXZ * float(m_StackRes));
+
+    m_HeightStack->BindImage(0, layer, 0);
+    m_HeightEditor.OnDispatch(region);
+}
+
+void MapGenerator::BindHeightStack(Shader& shader, int id) const {
+    static const Uniform<int> u_height_stack_sampler("heightStack"), u_height_stack("uHeightStack"),
+        u_stack_layers("uStackLayers"), u_stack_resolution("uStackResolution");
+    static const Uniform<glm::vec2> u_stack_center("uStackCenter");
+    static const Uniform<float> u_stack_extent("uStackExtent");
+
+    //Sampler always gets its own unit, so it never aliases samplers of other types
+    shader.setUniform(u_height_stack_sampler, id);
+    shader.setUniform(u_height_stack, int(m_StackLayers > 0));
+
+    if (m_StackLayers == 0)
+        return;
+
+    m_HeightStack->Bind(id);
+
+    shader.setUniform(u_stack_center, m_StackCenter);
+    shader.setUniform(u_stack_extent, m_StackExtent / m_ScaleXZ);
+    shader.setUniform(u_stack_layers, m_StackLayers);
+    shader.setUniform(u_stack_resolution, m_StackRes);
+}
+
+void MapGenerator::RequestUpdate(int flags, const DispatchRegion& region) {
+    auto request = [&](UpdateFlags flag, DispatchRegion& target) {
+        if ((flags & flag) == None)
+            return;
+
+        target = ((m_UpdateFlags & flag) == None) ? region : MergeRegions(target, region);
+    };
+
+    request(Height, m_HeightRegion);
+    request(Normal, m_NormalRegion);
+    request(Material, m_MaterialRegion);
+    request(Shadow, m_ShadowRegion);
+
+    //Any other height update may change the procedures
+    if ((flags & Height) != None)
+        m_ContinueStages = false;
+
+    m_UpdateFlags = m_UpdateFlags | flags;
+}
+
+void MapGenerator::RequestUpdate(int flags) {
+    RequestUpdate(flags, FullRegion());
+}
+
+void MapGenerator::RequestHeightUpdate(glm::ivec2 offset, glm::ivec2 size, bool update_shadows) {
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    DispatchRegion region = FullRegion();
+    region.Offset = glm::clamp(offset, glm::ivec2(0), glm::ivec2(res));
+    region.Size = glm::clamp(offset + size, glm::ivec2(0), glm::ivec2(res)) - region.Offset;
+
+    if (region.Empty())
+        return;
+
+    RequestUpdate(Height, region);
+
+    //Normals sample neighbouring texels, ao samples heights within its radius
+    const int ao_radius = int(std::ceil(m_AOSettings.R * float(res)));
+    RequestUpdate(Normal, DilateRegion(region, ao_radius + 1));
+
+    //Slope selection samples neighbouring texels
+    RequestUpdate(Material, DilateRegion(region, 1));
+
+    if (update_shadows)
+        RequestUpdate(Shadow, region);
+}
+
+glm::vec4 MapGenerator::getHeightUpdateRect() const {
+    //Scale changes also move all vertices
+    if ((m_UpdateFlags & Height) == None || IsFull(m_HeightRegion))
+        return glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    const float texel_size = m_HeightRegion.TexelSize;
+
+    //Bilinear sampling reaches one texel further
+    const glm::vec2 lo = texel_size * glm::vec2(m_HeightRegion.Offset - 1);
+    const glm::vec2 hi = texel_size * glm::vec2(m_HeightRegion.Offset + m_HeightRegion.Size + 1);
+
+    return glm::vec4(lo, hi);
+}
+
+DispatchRegion MapGenerator::FullRegion() const {
+    return DispatchRegion::Full(m_Heightmap->getSpec().ResolutionX);
+}
+
+bool MapGenerator::IsFull(const DispatchRegion& region) const {
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    return region.Offset == glm::ivec2(0) && region.Size.x >= res && region.Size.y >= res;
+}
+
+DispatchRegion MapGenerator::MergeRegions(const DispatchRegion& lhs, const DispatchRegion& rhs) const {
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    const glm::ivec2 lo = glm::min(lhs.Offset, rhs.Offset);
+    const glm::ivec2 hi = glm::max(lhs.Offset + lhs.Size, rhs.Offset + rhs.Size);
+
+    DispatchRegion merged = lhs;
+    merged.Offset = lo;
+    //Bounding rectangle of wrapped regions may be larger than the map
+    merged.Size = glm::min(hi - lo, glm::ivec2(res));
+    merged.Toroidal = lhs.Toroidal || rhs.Toroidal;
+
+    return merged;
+}
+
+DispatchRegion MapGenerator::DilateRegion(const DispatchRegion& region, int r) const {
+    const int res = m_Heightmap->getSpec().ResolutionX;
+
+    glm::ivec2 lo = region.Offset - r;
+    glm::ivec2 hi = region.Offset + region.Size + r;
+
+    DispatchRegion dilated = region;
+
+    if (m_Tiling) {
+        dilated.Toroidal = true;
+    }
+
+    else {
+        lo = glm::max(lo, glm::ivec2(0));
+        hi = glm::min(hi, glm::ivec2(res));
+    }
+
+    dilated.Offset = lo;
+    dilated.Size = glm::min(hi - lo, glm::ivec2(res));
+
+    return dilated;
+}
+
+void MapGenerator::Sculpt(const glm::vec3& origin, const glm::vec3& dir, float deltatime, bool update_shadows) {
+    if (!m_BrushSettings.Enabled)
+        return;
+
+    LOFI_PROFILE_GPU("Map::Sculpt");
+
+    glm::vec4 hit;
+
+    if (!PickTerrain(origin, dir, hit) || hit.w == 0.0f)
+        return;
+
+    glm::vec2 center{ hit.x, hit.y };
+
+    //Tiling maps are edited in the tile under the brush
+    if (m_Tiling)
+        center = glm::fract(center);
+
+    else if (center.x < 0.0f || center.y < 0.0f || center.x > 1.0f || center.y > 1.0f)
+        return;
+
+    if (!m_HasStrokeHeight) {
+        m_StrokeHeight = hit.z;
+        m_HasStrokeHeight = true;
+    }
+
+    const int res = m_SculptLayer->getSpec().ResolutionX;
+    const float radius = m_BrushSettings.Radius / m_ScaleXZ;
+
+    //Texels covered by the brush, brush is clipped at the map borders
+    const glm::ivec2 lo = glm::ivec2(glm::floor(float(res) * (center - radius)));
+    const glm::ivec2 hi = glm::ivec2(glm::ceil(float(res) * (center + radius))) + 1;
+
+    DispatchRegion region = FullRegion();
+    region.Offset = glm::clamp(lo, glm::ivec2(0), glm::ivec2(res));
+    region.Size = glm::clamp(hi, glm::ivec2(0), glm::ivec2(res)) - region.Offset;
+
+    if (region.Empty())
+        return;
+
+    m_Heightmap->Bind(0);
+    m_SculptLayer->BindImage(0, 0);
+
+    m_BrushShader->Bind();
+    region.SetUniforms(*m_BrushShader);
+    m_BrushShader->setUniform1i("heightmap", 0);
+    m_BrushShader->setUniform2f("uCenter", center);
+    m_BrushShader->setUniform1f("uRadius", radius);
+    m_BrushShader->setUniform1f("uStrength", m_BrushSettings.Strength * deltatime);
+    m_BrushShader->setUniform1f("uTarget", m_StrokeHeight);
+    m_BrushShader->setUniform1i("uMode", m_BrushSettings.Mode);
+
+    m_BrushShader->Dispatch(region.Size.x, region.Size.y, 1);
+    m_HasSculpt = true;
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    RequestHeightUpdate(region.Offset, region.Size, update_shadows);
+}
+
+void MapGenerator::EndStroke() {
+    m_StrokePicks = 0;
+    m_HasStrokeHeight = false;
+}
+
+bool MapGenerator::PickTerrain(const glm::vec3& origin, const glm::vec3& dir, glm::vec4& result) {
+    //Buffer written last frame, it is most likely finished by now
+    const bool has_result = (m_StrokePicks > 0);
+
+    if (has_result) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_PickBuffers[m_PickIndex ^ 1]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::vec4), &result);
+    }
+
+    m_Heightmap->Bind(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_PickBuffers[m_PickIndex]);
+
+    m_PickShader->Bind();
+    m_PickShader->setUniform1i("heightmap", 0);
+    m_PickShader->setUniform1f("uScaleXZ", m_ScaleXZ);
+    m_PickShader->setUniform1f("uScaleY", m_ScaleY);
+    m_PickShader->setUniform3f("uOrigin", origin);
+    m_PickShader->setUniform3f("uDir", glm::normalize(dir));
+    m_PickShader->setUniform1f("uMaxDist", 1000.0f);
+
+    m_PickShader->Dispatch(1, 1, 1);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    m_PickIndex ^= 1;
+    m_StrokePicks++;
+
+    return has_result;
+}
+
+void MapGenerator::ApplySculptLayer(const DispatchRegion& region) {
+    m_SculptApplyShader->Bind();
+    region.SetUniforms(*m_SculptApplyShader);
+
+    m_Heightmap->BindImage(0, 0);
+    m_SculptLayer->BindImage(1, 0);
+
+    m_SculptApplyShader->Dispatch(region.Size.x, region.Size.y, 1);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 }
 
 void MapGenerator::BindHeightmap(int id) const {
@@ -321,25 +855,65 @@ void MapGenerator::ImGuiTerrain(bool &open, bool update_shadows) {
 
     bool height_changed = m_HeightEditor.OnImGui();
 
+    if (m_HeightEditor.IsPending())
+        ImGui::Text("Running iterative procedures...");
+
+    //Doesn't change the result, so no update is needed
+    bool fused = m_HeightEditor.IsFused();
+
+    ImGui::Columns(2, "###col");
+    ImGuiUtils::ColCheckbox("Fuse procedures", &fused);
+    ImGui::Columns(1, "###col");
+
+    m_HeightEditor.SetFusion(fused);
+
+    ImGuiUtils::Separator();
+
+    ImGuiSculpt(update_shadows);
+
     ImGui::End();
 
     if (height_changed) {
-        m_UpdateFlags = m_UpdateFlags | Height | Normal | Material;
+        RequestUpdate(Height | Normal | Material);
 
         if (update_shadows)
-            m_UpdateFlags = m_UpdateFlags | Shadow;
+            RequestUpdate(Shadow);
     }
 
     else if (scale_changed) {
         m_ScaleXZ = scale_xz;
         m_ScaleY = scale_y;
 
-        m_UpdateFlags = m_UpdateFlags | Normal;
+        RequestUpdate(Normal);
+
+        if (update_shadows)
+            RequestUpdate(Shadow);
+    }
+
+}
+
+void MapGenerator::ImGuiSculpt(bool update_shadows) {
+    std::vector<std::string> modes{ "Raise", "Lower", "Smooth", "Flatten", "Erode" };
+
+    ImGuiUtils::BeginGroupPanel("Sculpt brush:");
+    ImGui::Columns(2, "###col");
+    ImGuiUtils::ColCheckbox("Sculpt (hold LMB)", &m_BrushSettings.Enabled);
+    ImGuiUtils::ColCombo("Mode", modes, m_BrushSettings.Mode);
+    ImGuiUtils::ColSliderFloat("Radius", &m_BrushSettings.Radius, 0.1f, 20.0f);
+    ImGuiUtils::ColSliderFloat("Strength", &m_BrushSettings.Strength, 0.0f, 0.5f);
+    ImGui::Columns(1, "###col");
+
+    if (ImGuiUtils::ButtonCentered("Clear sculpt layer")) {
+        m_SculptLayer->Clear(0.0f, 0.0f, 0.0f, 0.0f);
+        m_HasSculpt = false;
+
+        RequestUpdate(Height | Normal | Material);
 
         if (update_shadows)
-            m_UpdateFlags = m_UpdateFlags | Shadow;
+            RequestUpdate(Shadow);
     }
 
+    ImGuiUtils::EndGroupPanel();
 }
 
 void MapGenerator::ImGuiShadowmap(bool &open, bool update_shadows) {
@@ -368,7 +942,7 @@ void MapGenerator::ImGuiShadowmap(bool &open, bool update_shadows) {
 
     if (temp2 != m_AOSettings) {
         m_AOSettings = temp2;
-        m_UpdateFlags = m_UpdateFlags | Normal;
+        RequestUpdate(Normal);
     }
 
     if (temp != m_ShadowSettings) {
@@ -377,7 +951,7 @@ void MapGenerator::ImGuiShadowmap(bool &open, bool update_shadows) {
         m_ShadowSettings = temp;
 
         if (update_shadows)
-            m_UpdateFlags = m_UpdateFlags | Shadow;
+            RequestUpdate(Shadow);
     }
 }
 
@@ -389,11 +963,12 @@ void MapGenerator::ImGuiMaterials(bool& open) {
     ImGui::End();
 
     if (material_changed)
-        m_UpdateFlags = m_UpdateFlags | Material;
+        RequestUpdate(Material);
 }
 
 void MapGenerator::RequestShadowUpdate() const {
     m_UpdateFlags = m_UpdateFlags | Shadow;
+    m_ShadowRegion = FullRegion();
 }
 
 bool MapGenerator::GeometryShouldUpdate() {
@@ -402,24 +977,100 @@ bool MapGenerator::GeometryShouldUpdate() {
     return (m_UpdateFlags & Normal) != None;
 }
 
-void MapGenerator::OnSerialize(nlohmann::ordered_json& output)
+void MapGenerator::OnSerialize(nlohmann::ordered_json& output, const std::filesystem::path& world_path)
 {
     output["Scale XZ"] = m_ScaleXZ;
     output["Scale Y"] = m_ScaleY;
 
+    if (m_HasSculpt) {
+        //Stored by name, so that worlds can be moved together with their sculpt files
+        const std::string filename = world_path.filename().string() + ".sculpt";
+
+        SaveSculptLayer(world_path.parent_path() / filename);
+        output["Sculpt layer"] = filename;
+    }
+
     m_HeightEditor.OnSerialize(output);
     m_MaterialEditor.OnSerialize(output);
 }
 
-void MapGenerator::OnDeserialize(nlohmann::ordered_json& input)
+void MapGenerator::OnDeserialize(nlohmann::ordered_json& input, const std::filesystem::path& world_path)
 {
     m_ScaleXZ = input["Scale XZ"];
     m_ScaleY = input["Scale Y"];
 
+    //Offsets of the previous world mustn't end up on the new one
+    m_SculptLayer->Clear(0.0f, 0.0f, 0.0f, 0.0f);
+    m_HasSculpt = false;
+
+    if (input.contains("Sculpt layer")) {
+        const std::string filename = input["Sculpt layer"];
+
+        m_HasSculpt = LoadSculptLayer(world_path.parent_path() / filename);
+    }
+
     m_HeightEditor.OnDeserialize(input[m_HeightEditor.getName()]);
     m_MaterialEditor.OnDeserialize(input[m_MaterialEditor.getName()]);
 
-    m_UpdateFlags = Height | Normal | Shadow | Material;
+    RequestUpdate(Height | Normal | Shadow | Material);
+}
+
+//Sculpt files hold the resolution (int32) followed by res x res floats in row major order
+void MapGenerator::SaveSculptLayer(const std::filesystem::path& filepath) const
+{
+    const int32_t res = m_SculptLayer->getSpec().ResolutionX;
+    const std::vector<float> data = m_SculptLayer->GetData();
+
+    std::ofstream output(filepath, std::ios::binary | std::ios::trunc);
+
+    output.write(reinterpret_cast<const char*>(&res), sizeof(res));
+    output.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+
+    if (!output)
+        std::cerr << "Map Generator Error: Could not write sculpt layer to " << filepath.string() << '\n';
+}
+
+bool MapGenerator::LoadSculptLayer(const std::filesystem::path& filepath)
+{
+    std::ifstream input(filepath, std::ios::binary);
+
+    int32_t file_res = 0;
+    input.read(reinterpret_cast<char*>(&file_res), sizeof(file_res));
+
+    if (!input || file_res <= 0 || file_res > 16384) {
+        std::cerr << "Map Generator Error: Could not read sculpt layer from " << filepath.string() << '\n';
+        return false;
+    }
+
+    std::vector<float> file_data(size_t(file_res) * size_t(file_res));
+    input.read(reinterpret_cast<char*>(file_data.data()), file_data.size() * sizeof(float));
+
+    if (!input) {
+        std::cerr << "Map Generator Error: Sculpt layer " << filepath.string() << " is truncated\n";
+        return false;
+    }
+
+    const int res = m_SculptLayer->getSpec().ResolutionX;
+
+    //Heightmap resolution is a start setting, so the layer is resampled (nearest) if it differs
+    if (file_res == res) {
+        m_SculptLayer->SetData(file_data.data(), res, 0, 0, res, res);
+        return true;
+    }
+
+    std::vector<float> data(size_t(res) * size_t(res));
+
+    for (int y = 0; y < res; y++) {
+        const size_t src_y = size_t(y) * size_t(file_res) / size_t(res);
+
+        for (int x = 0; x < res; x++) {
+            const size_t src_x = size_t(x) * size_t(file_res) / size_t(res);
+            data[size_t(y) * res + x] = file_data[src_y * file_res + src_x];
+        }
+    }
+
+    m_SculptLayer->SetData(data.data(), res, 0, 0, res, res);
+    return true;
 }
 
 //Settings structs operator overloads:
@@ -7,11 +7,25 @@
 
 #include "nlohmann/json.hpp"
 
+#include <filesystem>
+
 struct AOSettings{
     int Samples = 16;
     float R = 0.01;
 };
 
+struct BrushSettings{
+    bool Enabled = false;
+
+    //Same order as defines in terrain/brush.glsl
+    int Mode = 0;
+
+    //World units
+    float Radius = 2.0f;
+    //Heightmap units per second
+    float Strength = 0.05f;
+};
+
 struct ShadowmapSettings{
     int MinLevel = 5;
     int StartCell = 32;
@@ -26,6 +40,7 @@ struct ShadowmapSettings{
 class MapGenerator {
 public:
     MapGenerator(ResourceManager& manager);
+    ~MapGenerator();
 
     void Init(int height_res, int shadow_res, int wrap_type);
     void Update(const glm::vec3& sun_dir);
@@ -36,25 +51,83 @@ public:
     void BindMaterialmap(int id=0) const;
     void RequestShadowUpdate() const;
 
+    //Regenerates heightmap texels in [offset, offset + size) and the parts of
+    //normal/material maps depending on them, instead of entire maps
+    void RequestHeightUpdate(glm::ivec2 offset, glm::ivec2 size, bool update_shadows);
+
+    //Uv rectangle (min.xy, max.xy) of heights changed by the pending update
+    glm::vec4 getHeightUpdateRect() const;
+
+    //-----Sculpting
+    //Applies the brush where the ray hits the terrain. Hits are read back with a frame of latency,
+    //so the brush starts acting one frame after the beginning of the stroke.
+    void Sculpt(const glm::vec3& origin, const glm::vec3& dir, float deltatime, bool update_shadows);
+    void EndStroke();
+
     void ImGuiTerrain(bool &open, bool update_shadows);
     void ImGuiShadowmap(bool &open, bool update_shadows);
     void ImGuiMaterials(bool& open);
 
     bool GeometryShouldUpdate();
 
+    //-----Cpu heightmap procedures (see CpuProcedures.h)
+    //Heightmap is generated on the cpu and uploaded, for machines with slow compute.
+    //Stacks containing procedures without cpu versions still run on the gpu, as does the height stack.
+    void setCpuProcedures(bool enabled) { m_CpuProcedures = enabled; }
+    //Runs the heightmap procedures on both the cpu and the gpu, returns the largest
+    //absolute difference of the results, or -1 if some procedure has no cpu version
+    float ValidateCpuProcedures();
+
+    //-----Heightmap stack for unbounded worlds
+    //Toroidally addressed texture array, layer i covers extent * 1.25 * 2^(i - layers + 1)
+    //world units around the camera, so the last layer covers the entire clipmap of given extent.
+    void InitHeightStack(int res, int layers, float extent);
+    //Regenerates strips of texels exposed by camera movement. Returns true if some layer
+    //was regenerated entirely (procedures or scale changed, camera jumped far away).
+    bool UpdateHeightStack(const glm::vec3& cam_pos);
+    //Sets uniforms used by height_stack.glsl, stack is bound to texture unit id.
+    //Should be called for every shader including height_stack.glsl, even if the stack is not used.
+    void BindHeightStack(Shader& shader, int id) const;
+
     float getScaleXZ() const {return m_ScaleXZ;}
     float getScaleY() const {return m_ScaleY;}
 
-    void OnSerialize(nlohmann::ordered_json& output);
-    void OnDeserialize(nlohmann::ordered_json& input);
+    //Sculpt layer goes into a separate binary file next to world_path, referenced from the json
+    void OnSerialize(nlohmann::ordered_json& output, const std::filesystem::path& world_path);
+    void OnDeserialize(nlohmann::ordered_json& input, const std::filesystem::path& world_path);
 
 private:
     void UpdateHeight();
+    //Returns false if the stack can't run on the cpu
+    bool UpdateHeightCpu();
     void UpdateNormal();
     void UpdateShadow(const glm::vec3& sun_dir);
     void UpdateMaterial();
 
-    void GenMaxMips();
+    void GenMaxMips(const DispatchRegion& region);
+    //Updates the mip chain of texture over the region (in base level texels) only,
+    //the full chain is generated if it wasn't allocated yet
+    void GenAverageMips(Texture2D& texture, const DispatchRegion& region);
+
+    //Region is merged with the regions requested earlier for the same maps
+    void RequestUpdate(int flags, const DispatchRegion& region);
+    void RequestUpdate(int flags);
+
+    DispatchRegion FullRegion() const;
+    bool IsFull(const DispatchRegion& region) const;
+    DispatchRegion MergeRegions(const DispatchRegion& lhs, const DispatchRegion& rhs) const;
+    //Grows region by r texels, regions wrap around tiling maps and are clamped otherwise
+    DispatchRegion DilateRegion(const DispatchRegion& region, int r) const;
+
+    void UpdateStackRegion(int layer, glm::ivec2 offset, glm::ivec2 size);
+
+    void ApplySculptLayer(const DispatchRegion& region);
+    void ImGuiSculpt(bool update_shadows);
+    void SaveSculptLayer(const std::filesystem::path& filepath) const;
+    //Returns false if the file is missing or malformed
+    bool LoadSculptLayer(const std::filesystem::path& filepath);
+    //Dispatches a new pick, returns the result of the one issued last frame
+    bool PickTerrain(const glm::vec3& origin, const glm::vec3& dir, glm::vec4& result);
 
     enum UpdateFlags {
         None     =  0,
@@ -68,7 +141,7 @@ private:
     std::shared_ptr<Texture2D> m_Heightmap, m_Normalmap, m_Shadowmap, m_Materialmap;
 
     std::shared_ptr<ComputeShader> m_NormalmapShader, m_ShadowmapShader;
-    std::shared_ptr<ComputeShader> m_MipShader;
+    std::shared_ptr<ComputeShader> m_MipShader, m_AverageMipShader;
     
     float m_ScaleXZ = 100.0f;
     float m_ScaleY = 20.0f;
@@ -78,6 +151,50 @@ private:
 
     mutable int m_UpdateFlags = None;
     int m_MipLevels = 0;
+    bool m_Tiling = true;
+
+    //Set while the only pending height update is continuation of unfinished stages
+    bool m_ContinueStages = false;
+    //Shadows requested while stages are running
+    bool m_DeferredShadows = false;
+
+    bool m_CpuProcedures = false;
+    std::vector<float> m_CpuHeights;
+
+    //Texels to regenerate with the next update, shadow region is in heightmap texels
+    //and gets extended away from the sun once the update happens
+    DispatchRegion m_HeightRegion, m_NormalRegion, m_MaterialRegion;
+    mutable DispatchRegion m_ShadowRegion;
+
+    //Sculpt layer is added on top of the procedural heightmap
+    BrushSettings m_BrushSettings;
+    std::shared_ptr<Texture2D> m_SculptLayer;
+    //Layer is only saved if something was sculpted
+    bool m_HasSculpt = false;
+    std::shared_ptr<ComputeShader> m_BrushShader, m_PickShader, m_SculptApplyShader;
+
+    //Picks alternate between two buffers, one is written while the other one is read
+    unsigned int m_PickBuffers[2] = { 0, 0 };
+    int m_PickIndex = 0, m_StrokePicks = 0;
+
+    //Height under the brush at the beginning of the stroke, used for flattening
+    float m_StrokeHeight = 0.0f;
+    bool m_HasStrokeHeight = false;
+
+    //Heightmap stack, texel with global coordinates p of layer i lies at
+    //uv = p * texel size of layer i and is stored at p mod resolution
+    std::shared_ptr<TextureArray> m_HeightStack;
+
+    //Global coordinates of the first texel of each layer
+    std::vector<glm::ivec2> m_StackOrigins;
+
+    int m_StackLayers = 0, m_StackRes = 0;
+    //World extent of the finest layer
+    float m_StackExtent = 0.0f;
+    //Scale xz the stack was generated with, layers cover fixed world extents
+    float m_StackScaleXZ = 0.0f;
+    glm::vec2 m_StackCenter{ 0.0f };
+    bool m_StackValid = false;
     
     ResourceManager& m_ResourceManager;
 };
@@ -18,9 +18,9 @@ MaterialGenerator::MaterialGenerator(ResourceManager& manager)
 {
     m_NormalShader = m_ResourceManager.RequestComputeShader("res/shaders/materials/normal.glsl");
 
-    m_Height = m_ResourceManager.RequestTextureArray();
-    m_Normal = m_ResourceManager.RequestTextureArray();
-    m_Albedo = m_ResourceManager.RequestTextureArray();
+    m_Height = m_ResourceManager.RequestTextureArray("Material");
+    m_Normal = m_ResourceManager.RequestTextureArray("Material");
+    m_Albedo = m_ResourceManager.RequestTextureArray("Material");
 }
 
 void MaterialGenerator::Init(int material_res) {
@@ -40,8 +40,7 @@ void MaterialGenerator::Init(int material_res) {
         {0.5f, 1.0f, 0.5f, 1.0f}
     }, m_Layers);
 
-    m_Normal->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    m_Normal->GenerateMips();
 
     m_Albedo->Initialize(Texture2DSpec{
         material_res, material_res, GL_RGBA8, GL_RGBA,
@@ -50,8 +49,7 @@ void MaterialGenerator::Init(int material_res) {
         {0.0f, 0.0f, 0.0f, 0.7f}
     }, m_Layers);
 
-    m_Albedo->Bind();
-    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    m_Albedo->GenerateMips();
 
     //=====Initialize material editors:
     std::vector<std::string> labels{ "Average", "Add", "Subtract" };
@@ -121,7 +119,7 @@ void MaterialGenerator::Update() {
     //Draw to heightmap:
     if ((m_UpdateFlags & Height) != None)
     {
-        ProfilerGPUEvent we("Material::UpdateHeight");
+        LOFI_PROFILE_GPU("Material::UpdateHeight");
 
         const int res = m_Height->getSpec().ResolutionX;
         
@@ -134,7 +132,7 @@ void MaterialGenerator::Update() {
     //Draw to normal:
     if ((m_UpdateFlags & Normal) != None)
     {
-        ProfilerGPUEvent we("Material::UpdateNormal");
+        LOFI_PROFILE_GPU("Material::UpdateNormal");
 
         const int res = m_Normal->getSpec().ResolutionX;
         m_Height->BindLayer(0, m_Current);
@@ -150,8 +148,7 @@ void MaterialGenerator::Update() {
 
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
     
-        m_Normal->Bind();
-        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        m_Normal->GenerateMips();
 
         m_ResourceManager.RequestPreviewUpdate(m_Normal);
     }
@@ -159,7 +156,7 @@ void MaterialGenerator::Update() {
     //Draw to albedo/roughness:
     if ((m_UpdateFlags & Albedo) != None)
     {
-        ProfilerGPUEvent we("Material::UpdateAlbedo");
+        LOFI_PROFILE_GPU("Material::UpdateAlbedo");
 
         const int res = m_Albedo->getSpec().ResolutionX;
         m_Height->BindLayer(0, m_Current);
@@ -168,8 +165,7 @@ void MaterialGenerator::Update() {
         m_AlbedoEditor.OnDispatch(m_Current, res);
         m_RoughnessEditor.OnDispatch(m_Current, res);
     
-        m_Albedo->Bind();
-        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        m_Albedo->GenerateMips();
 
         m_ResourceManager.RequestPreviewUpdate(m_Albedo);
     }
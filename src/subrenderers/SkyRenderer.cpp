@@ -32,18 +32,18 @@ SkyRenderer::SkyRenderer(ResourceManager& manager, const PerspectiveCamera& cam,
         m_ARaymarchShader = m_ResourceManager.RequestComputeShader("res/shaders/sky/aerial_shadowed.glsl");
     }
 
-    m_TransLUT       = m_ResourceManager.RequestTexture2D();
-    m_MultiLUT       = m_ResourceManager.RequestTexture2D();
-    m_SkyLUT         = m_ResourceManager.RequestTexture2D();
-    m_IrradianceMap  = m_ResourceManager.RequestCubemap();
-    m_PrefilteredMap = m_ResourceManager.RequestCubemap();
+    m_TransLUT       = m_ResourceManager.RequestTexture2D("Sky");
+    m_MultiLUT       = m_ResourceManager.RequestTexture2D("Sky");
+    m_SkyLUT         = m_ResourceManager.RequestTexture2D("Sky");
+    m_IrradianceMap  = m_ResourceManager.RequestCubemap("Sky");
+    m_PrefilteredMap = m_ResourceManager.RequestCubemap("Sky");
 
-    m_AerialLUT = m_ResourceManager.RequestTexture3D();
+    m_AerialLUT = m_ResourceManager.RequestTexture3D("Sky");
 
     if (m_AerialShadows)
     {
-        m_ScatterVolume = m_ResourceManager.RequestTexture3D();
-        m_ShadowVolume = m_ResourceManager.RequestTexture3D();
+        m_ScatterVolume = m_ResourceManager.RequestTexture3D("Sky");
+        m_ShadowVolume = m_ResourceManager.RequestTexture3D("Sky");
     }
 
     Init();
@@ -133,8 +133,7 @@ void SkyRenderer::Init() {
         GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR,
     });
 
-    m_PrefilteredMap->Bind();
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    m_PrefilteredMap->GenerateMips();
 
     //Initialize sun direction
     float cT = cos(m_Theta), sT = sin(m_Theta);
@@ -171,15 +170,19 @@ void SkyRenderer::Update(bool aerial) {
             UpdateAerialWithShadows();
     }
 
+    m_UpdateFlags = None;
+    m_SunDirChanged = false;
+}
+
+void SkyRenderer::UpdateSunColor() {
     if ((m_UpdateFlags & SunColor) != None)
         CalculateSunTransmittance();
 
-    m_UpdateFlags = None;
-    m_SunDirChanged = false;
+    m_UpdateFlags = m_UpdateFlags & ~SunColor;
 }
 
 void SkyRenderer::UpdateTrans() {
-    ProfilerGPUEvent we("Sky::UpdateTransLUT");
+    LOFI_PROFILE_GPU("Sky::UpdateTransLUT");
 
     m_TransLUT->BindImage(0, 0);
 
@@ -196,7 +199,7 @@ void SkyRenderer::UpdateTrans() {
 }
 
 void SkyRenderer::UpdateMulti() {
-    ProfilerGPUEvent we("Sky::UpdateMultiLUT");
+    LOFI_PROFILE_GPU("Sky::UpdateMultiLUT");
 
     m_TransLUT->Bind(0);
     m_MultiLUT->BindImage(0, 0);
@@ -216,7 +219,7 @@ void SkyRenderer::UpdateMulti() {
 }
 
 void SkyRenderer::UpdateSky() {
-    ProfilerGPUEvent we("Sky::UpdateSkyLUT");
+    LOFI_PROFILE_GPU("Sky::UpdateSkyLUT");
 
     //Update sky lut
     m_TransLUT->Bind(0);
@@ -226,7 +229,6 @@ void SkyRenderer::UpdateSky() {
     m_SkyShader->Bind();
     m_SkyShader->setUniform1i("transLUT", 0);
     m_SkyShader->setUniform1i("multiLUT", 1);
-    m_SkyShader->setUniform3f("uSunDir", m_SunDir);
     m_SkyShader->setUniform1f("uHeight", 0.000001f * m_Height); // meter -> megameter
 
     const int res_x = m_SkyLUT->getSpec().ResolutionX;
@@ -246,7 +248,6 @@ void SkyRenderer::UpdateSky() {
 
     m_IrradianceShader->Bind();
     m_IrradianceShader->setUniform1i("uResolution", m_IrradianceMap->getSpec().Resolution);
-    m_IrradianceShader->setUniform3f("uSunDir", m_SunDir);
     m_IrradianceShader->setUniform1f("uSkyBrightness", m_Brightness);
     m_IrradianceShader->setUniform1f("uIBLOversaturation", m_IBLOversaturation);
 
@@ -263,7 +264,6 @@ void SkyRenderer::UpdateSky() {
 
     m_PrefilteredShader->Bind();
     m_PrefilteredShader->setUniform1i("uResolution", m_PrefilteredMap->getSpec().Resolution);
-    m_PrefilteredShader->setUniform3f("uSunDir", m_SunDir);
     m_PrefilteredShader->setUniform1f("uSkyBrightness", m_Brightness);
     m_PrefilteredShader->setUniform1f("uIBLOversaturation", m_IBLOversaturation);
 
@@ -271,15 +271,14 @@ void SkyRenderer::UpdateSky() {
 
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 
-    m_PrefilteredMap->Bind();
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    m_PrefilteredMap->GenerateMips();
 
     m_ResourceManager.RequestPreviewUpdate(m_PrefilteredMap);
 }
 
 void SkyRenderer::UpdateAerial()
 {
-    ProfilerGPUEvent we("Sky::UpdateAerial");
+    LOFI_PROFILE_GPU("Sky::UpdateAerial");
 
     m_AerialLUT->BindImage(0, 0);
 
@@ -290,17 +289,8 @@ void SkyRenderer::UpdateAerial()
     m_AerialShader->setUniform1i("transLUT", 0);
     m_AerialShader->setUniform1i("multiLUT", 1);
     m_AerialShader->setUniform1f("uHeight", 0.000001f * m_Height); // meter -> megameter
-    m_AerialShader->setUniform3f("uSunDir", m_SunDir);
     m_AerialShader->setUniform1f("uNear", glm::radians(m_Camera.getNearPlane()));
     m_AerialShader->setUniform1f("uFar", m_Camera.getFarPlane());
-    m_AerialShader->setUniform3f("uFront", m_Camera.getFront());
-
-    const FrustumExtents extents = m_Camera.getFrustumExtents();
-
-    m_AerialShader->setUniform3f("uBotLeft", extents.BottomLeft);
-    m_AerialShader->setUniform3f("uBotRight", extents.BottomRight);
-    m_AerialShader->setUniform3f("uTopLeft", extents.TopLeft);
-    m_AerialShader->setUniform3f("uTopRight", extents.TopRight);
 
     m_AerialShader->setUniform1f("uDistScale", m_AerialDistWrite);
     //m_AerialShader->setUniform3f("uGroundAlbedo", m_GroundAlbedo);
@@ -322,9 +312,7 @@ void SkyRenderer::UpdateAerial()
 
 void SkyRenderer::UpdateAerialWithShadows()
 {
-    ProfilerGPUEvent we("Sky::UpdateAerial");
-
-    const FrustumExtents extents = m_Camera.getFrustumExtents();
+    LOFI_PROFILE_GPU("Sky::UpdateAerial");
 
     //All 3d textures used here have the same resolution by assumption
     int res_x = m_ScatterVolume->getSpec().ResolutionX;
@@ -341,14 +329,8 @@ void SkyRenderer::UpdateAerialWithShadows()
     m_AScatterShader->setUniform1i("transLUT", 0);
     m_AScatterShader->setUniform1i("multiLUT", 1);
     m_AScatterShader->setUniform1f("uHeight", 0.000001f * m_Height); // meter -> megameter
-    m_AScatterShader->setUniform3f("uSunDir", m_SunDir);
     m_AScatterShader->setUniform1f("uNear", glm::radians(m_Camera.getNearPlane()));
     m_AScatterShader->setUniform1f("uFar", m_Camera.getFarPlane());
-    m_AScatterShader->setUniform3f("uFront", m_Camera.getFront());
-    m_AScatterShader->setUniform3f("uBotLeft", extents.BottomLeft);
-    m_AScatterShader->setUniform3f("uBotRight", extents.BottomRight);
-    m_AScatterShader->setUniform3f("uTopLeft", extents.TopLeft);
-    m_AScatterShader->setUniform3f("uTopRight", extents.TopRight);
     m_AScatterShader->setUniform1f("uDistScale", m_AerialDistWrite);
     //m_AerialShader->setUniform3f("uGroundAlbedo", m_GroundAlbedo);
     m_AScatterShader->setUniform1i("uMultiscatter", int(m_AerialMultiscatter));
@@ -366,18 +348,9 @@ void SkyRenderer::UpdateAerialWithShadows()
 
     m_AShadowShader->Bind();
     m_AShadowShader->setUniform1i("shadowmap", 2);
-    m_AShadowShader->setUniform3f("uPos", m_Camera.getPos());
-    m_AShadowShader->setUniform3f("uSunDir", m_SunDir);
     m_AShadowShader->setUniform1f("uNear", glm::radians(m_Camera.getNearPlane()));
     m_AShadowShader->setUniform1f("uFar", m_Camera.getFarPlane());
-    m_AShadowShader->setUniform3f("uFront", m_Camera.getFront());
-    m_AShadowShader->setUniform3f("uBotLeft", extents.BottomLeft);
-    m_AShadowShader->setUniform3f("uBotRight", extents.BottomRight);
-    m_AShadowShader->setUniform3f("uTopLeft", extents.TopLeft);
-    m_AShadowShader->setUniform3f("uTopRight", extents.TopRight);
     m_AShadowShader->setUniform1f("uL", 4.0f); //Temp, get this from the clipmap!
-    m_AShadowShader->setUniform1f("uScaleY", m_Map.getScaleY());
-    m_AShadowShader->setUniform1f("uScaleXZ", m_Map.getScaleXZ());
 
     m_AShadowShader->Dispatch(res_x, res_y, res_z);
     
@@ -404,9 +377,7 @@ void SkyRenderer::UpdateAerialWithShadows()
 
 //Draws sky on a fullscreen quad, meant to be called after rendering scene geometry
 void SkyRenderer::Render() {
-    ProfilerGPUEvent we("Sky::Render");
-
-    const FrustumExtents extents = m_Camera.getFrustumExtents();
+    LOFI_PROFILE_GPU("Sky::Render");
 
     m_TransLUT->Bind(0);
     m_SkyLUT->Bind(1);
@@ -414,12 +385,6 @@ void SkyRenderer::Render() {
     m_FinalShader->Bind();
     m_FinalShader->setUniform1i("transLUT", 0);
     m_FinalShader->setUniform1i("skyLUT", 1);
-    m_FinalShader->setUniform3f("uSunDir", m_SunDir);
-
-    m_FinalShader->setUniform3f("uBotLeft", extents.BottomLeft);
-    m_FinalShader->setUniform3f("uBotRight", extents.BottomRight);
-    m_FinalShader->setUniform3f("uTopLeft", extents.TopLeft);
-    m_FinalShader->setUniform3f("uTopRight", extents.TopRight);
     m_FinalShader->setUniform1f("uSkyBrightness", m_Brightness);
     m_FinalShader->setUniform1f("uHeight", 0.000001f * m_Height); // meter -> megameter
 
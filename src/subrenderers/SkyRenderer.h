@@ -14,6 +14,8 @@ public:
 
 	void OnImGui(bool& open);
 	void Update(bool aerial);
+	//Separate from Update, since the sun color goes into the per-frame uniforms before the sky is updated
+	void UpdateSunColor();
 	void Render();
 
 	void BindSkyLUT(int id=0) const;
@@ -8,6 +8,9 @@
 
 #include "glad/glad.h"
 
+#include <algorithm>
+#include <iostream>
+
 TerrainRenderer::TerrainRenderer(ResourceManager& manager, const PerspectiveCamera& cam,
                                  const MapGenerator& map, const MaterialGenerator& material,
                                  const SkyRenderer& sky)
@@ -21,25 +24,87 @@ TerrainRenderer::TerrainRenderer(ResourceManager& manager, const PerspectiveCame
     m_WireframeShader = m_ResourceManager.RequestVertFragShader("res/shaders/wireframe.vert", "res/shaders/wireframe.frag");
 
     m_DisplaceShader = m_ResourceManager.RequestComputeShader("res/shaders/displace.glsl");
+    m_CullShader     = m_ResourceManager.RequestComputeShader("res/shaders/clipmap_cull.glsl");
+
+    //Occluders use the wireframe geometry path, only depth is written out
+    m_OccluderShader = m_ResourceManager.RequestVertFragShader("res/shaders/wireframe.vert", "res/shaders/occluder.frag");
+    m_HiZShader      = m_ResourceManager.RequestComputeShader("res/shaders/terrain/maximal_mip.glsl");
+
+    m_HiZ = m_ResourceManager.RequestTexture2D("Terrain");
+
+    m_ResourceManager.RegisterBufferSource("Terrain", [this]() { return m_Clipmap.getMemoryUsage(); });
 }
 
-TerrainRenderer::~TerrainRenderer() {}
+TerrainRenderer::~TerrainRenderer() 
+{
+    glDeleteFramebuffers(1, &m_OcclusionFBO);
+    glDeleteRenderbuffers(1, &m_OcclusionDepthRBO);
+}
 
-void TerrainRenderer::Init(uint32_t subdivisions, uint32_t levels)
+void TerrainRenderer::Init(uint32_t subdivisions, uint32_t levels, ClipmapMode mode)
 {
-    m_Clipmap.Init(subdivisions, levels);
+    m_Clipmap.Init(subdivisions, levels, mode);
+
+    //-----Hi-z pyramid, max depth of each texel's footprint
+    m_HiZ->Initialize(Texture2DSpec{
+        s_HiZResolution, s_HiZResolution, GL_R32F, GL_RED,
+        GL_FLOAT, GL_NEAREST, GL_NEAREST,
+        GL_CLAMP_TO_EDGE,
+        {1.0f, 1.0f, 1.0f, 1.0f}
+    });
+
+    //Allocates the mip chain
+    m_HiZ->GenerateMips();
+
+    int res = s_HiZResolution;
+    m_HiZMips = 0;
+    while (res >>= 1) m_HiZMips++;
+
+    glGenFramebuffers(1, &m_OcclusionFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_OcclusionFBO);
+
+    m_HiZ->AttachToFramebuffer();
+
+    glGenRenderbuffers(1, &m_OcclusionDepthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_OcclusionDepthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, s_HiZResolution, s_HiZResolution);
+
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_OcclusionDepthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Framebuffer Error: Occlusion framebuffer is not complete\n";
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void TerrainRenderer::Update()
 {
+    UpdateGeometry();
+    CullGeometry();
+}
+
+void TerrainRenderer::UpdateGeometry()
+{
+    //Heights are sampled in the vertex shader, no geometry work is needed
+    if (m_Clipmap.SamplesHeight())
+    {
+        m_UpdateAll = false;
+        m_UpdateRegion = false;
+        return;
+    }
+
     m_Map.BindHeightmap();
 
+    static const Uniform<glm::vec2> u_pos("uPos");
+    static const Uniform<int> u_use_dirty_rect("uUseDirtyRect");
+    static const Uniform<glm::vec4> u_dirty_rect("uDirtyRect");
+
     const glm::vec2 curr{ m_Camera.getPos().x, m_Camera.getPos().z };
 
     m_DisplaceShader->Bind();
-    m_DisplaceShader->setUniform2f("uPos", curr);
-    m_DisplaceShader->setUniform1f("uScaleXZ", m_Map.getScaleXZ());
-    m_DisplaceShader->setUniform1f("uScaleY", m_Map.getScaleY());
+    m_DisplaceShader->setUniform(u_pos, curr);
+    m_Map.BindHeightStack(*m_DisplaceShader, 1);
+    m_DisplaceShader->setUniform(u_use_dirty_rect, 0);
 
     const uint32_t binding_id = 1;
 
@@ -53,9 +118,97 @@ void TerrainRenderer::Update()
         const glm::vec2 prev{ m_Camera.getPrevPos().x, m_Camera.getPrevPos().z };
 
         m_Clipmap.RunCompute(m_DisplaceShader, binding_id, curr, prev);
+
+        //Local heightmap edits, all levels may overlap them
+        if (m_UpdateRegion)
+        {
+            m_DisplaceShader->setUniform(u_use_dirty_rect, 1);
+            m_DisplaceShader->setUniform(u_dirty_rect, m_UpdateRect);
+
+            m_Clipmap.RunCompute(m_DisplaceShader, binding_id);
+        }
     }
 
     m_UpdateAll = false;
+    m_UpdateRegion = false;
+}
+
+//Culling results are shared by the wireframe and shaded passes
+void TerrainRenderer::CullGeometry()
+{
+    //Command buffer still holds last frame's visible set at this point
+    if (m_OcclusionCulling)
+        RenderOccluders();
+
+    LOFI_PROFILE_GPU("Terrain::Cull");
+
+    static const Uniform<int> u_heightmap("heightmap"), u_occlusion("uOcclusion"), u_hizmap("hizmap");
+
+    m_Map.BindHeightmap(0);
+    m_HiZ->Bind(1);
+
+    m_CullShader->Bind();
+    m_CullShader->setUniform(u_heightmap, 0);
+
+    m_CullShader->setUniform(u_occlusion, int(m_OcclusionCulling));
+    m_CullShader->setUniform(u_hizmap, 1);
+    m_Map.BindHeightStack(*m_CullShader, 2);
+
+    m_Clipmap.Cull(m_CullShader, m_Camera);
+}
+
+void TerrainRenderer::RenderOccluders()
+{
+    LOFI_PROFILE_GPU("Terrain::Occluders");
+
+    static const Uniform<int> u_instanced("uInstanced"), u_sample_height("uSampleHeight"), u_heightmap("heightmap");
+    static const Uniform<glm::ivec2> u_region_offset("uRegionOffset"), u_region_size("uRegionSize");
+
+    //This runs in the middle of the frame, so touched state is restored afterwards
+    int prev_fbo = 0;
+    int viewport[4], polygon_mode[2];
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_OcclusionFBO);
+    glViewport(0, 0, s_HiZResolution, s_HiZResolution);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    const float far_depth[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, far_depth);
+    glClearBufferfv(GL_DEPTH, 0, far_depth);
+
+    m_OccluderShader->Bind();
+    m_OccluderShader->setUniform(u_instanced, int(m_Clipmap.getMode() == ClipmapMode::Instanced));
+    m_OccluderShader->setUniform(u_sample_height, int(m_Clipmap.SamplesHeight()));
+    m_Map.BindHeightmap(0);
+    m_OccluderShader->setUniform(u_heightmap, 0);
+    m_Map.BindHeightStack(*m_OccluderShader, 1);
+
+    m_Clipmap.Draw();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glPolygonMode(GL_FRONT_AND_BACK, polygon_mode[0]);
+
+    //Same reduction as the max mips of the heightmap
+    m_HiZShader->Bind();
+
+    for (int i = 0; i < m_HiZMips; i++)
+    {
+        m_HiZ->BindImage(1, i);
+        m_HiZ->BindImage(0, i + 1);
+
+        const int size = std::max(s_HiZResolution >> (i + 1), 1);
+
+        m_HiZShader->setUniform(u_region_offset, glm::ivec2(0));
+        m_HiZShader->setUniform(u_region_size, glm::ivec2(size));
+
+        m_HiZShader->Dispatch(size, size, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
 }
 
 void TerrainRenderer::RequestFullUpdate()
@@ -63,38 +216,50 @@ void TerrainRenderer::RequestFullUpdate()
     m_UpdateAll = true;
 }
 
+void TerrainRenderer::RequestRegionUpdate(const glm::vec4& uv_rect)
+{
+    if (uv_rect.x <= 0.0f && uv_rect.y <= 0.0f && uv_rect.z >= 1.0f && uv_rect.w >= 1.0f)
+    {
+        RequestFullUpdate();
+        return;
+    }
+
+    if (!m_UpdateRegion)
+    {
+        m_UpdateRect = uv_rect;
+        m_UpdateRegion = true;
+        return;
+    }
+
+    //Merge with other edits made before the update
+    m_UpdateRect.x = std::min(m_UpdateRect.x, uv_rect.x);
+    m_UpdateRect.y = std::min(m_UpdateRect.y, uv_rect.y);
+    m_UpdateRect.z = std::max(m_UpdateRect.z, uv_rect.z);
+    m_UpdateRect.w = std::max(m_UpdateRect.w, uv_rect.w);
+}
+
 void TerrainRenderer::RenderWireframe() {
     glClearColor(m_ClearColor[0], m_ClearColor[1], m_ClearColor[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     {
-        ProfilerGPUEvent we("Terrain::PrepareWireframe");
+        LOFI_PROFILE_GPU("Terrain::PrepareWireframe");
 
-        const glm::mat4 mvp = m_Camera.getViewProjMatrix();
+        static const Uniform<int> u_instanced("uInstanced"), u_sample_height("uSampleHeight"), u_heightmap("heightmap");
 
         m_WireframeShader->Bind();
-        m_WireframeShader->setUniform1f("uL", m_Map.getScaleXZ());
-        m_WireframeShader->setUniform2f("uPos", m_Camera.getPos().x, m_Camera.getPos().z);
-        m_WireframeShader->setUniformMatrix4fv("uMVP", mvp);
+        m_WireframeShader->setUniform(u_instanced, int(m_Clipmap.getMode() == ClipmapMode::Instanced));
+
+        m_WireframeShader->setUniform(u_sample_height, int(m_Clipmap.SamplesHeight()));
+        m_Map.BindHeightmap(0);
+        m_WireframeShader->setUniform(u_heightmap, 0);
+        m_Map.BindHeightStack(*m_WireframeShader, 1);
     }
     
     {
-        ProfilerGPUEvent we("Terrain::Draw");
+        LOFI_PROFILE_GPU("Terrain::Draw");
 
-        auto scale_y = m_Map.getScaleY();
-
-        for (const auto& grid : m_Clipmap.getGrids())
-        {
-            if (m_Camera.IsInFrustum(grid.BoundingBox, scale_y))
-            {
-                grid.Draw();
-            }
-        }
-
-        for (const auto& fill : m_Clipmap.getFills())
-        {
-            fill.Draw();
-        }
+        m_Clipmap.Draw();
     }
 }
 
@@ -104,68 +269,63 @@ void TerrainRenderer::RenderShaded()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     {
-        ProfilerGPUEvent we("Terrain::PrepareShaded");
-
-        const float scale_xz = m_Map.getScaleXZ();
-
-        const glm::mat4 mvp = m_Camera.getViewProjMatrix();
+        LOFI_PROFILE_GPU("Terrain::PrepareShaded");
+
+        //Camera, sun and scales come from the FrameData/MapData blocks
+        static const Uniform<float> u_sun_str("uSunStr"), u_sky_diff("uSkyDiff"), u_sky_spec("uSkySpec"),
+            u_ref_str("uRefStr"), u_tiling_factor("uTilingFactor"), u_normal_strength("uNormalStrength"),
+            u_aerial_dist("uAerialDist");
+        static const Uniform<int> u_shadow("uShadow"), u_material("uMaterial"), u_fix_tiling("uFixTiling"),
+            u_fog("uFog"), u_instanced("uInstanced"), u_sample_height("uSampleHeight");
+        static const Uniform<int> u_normalmap("normalmap"), u_shadowmap("shadowmap"), u_materialmap("materialmap"),
+            u_albedo("albedo"), u_normal("normal"), u_irradiance("irradiance"), u_prefiltered("prefiltered"),
+            u_aerial("aerial"), u_heightmap("heightmap");
 
         m_ShadedShader->Bind();
-        m_ShadedShader->setUniform1f("uL", scale_xz);
-        m_ShadedShader->setUniform3f("uLightDir", m_Sky.getSunDir());
-        m_ShadedShader->setUniform3f("uPos", m_Camera.getPos());
-        m_ShadedShader->setUniformMatrix4fv("uMVP", mvp);
-        m_ShadedShader->setUniform1i("uShadow", int(m_Shadows));
-        m_ShadedShader->setUniform1i("uMaterial", int(m_Materials));
-        m_ShadedShader->setUniform1i("uFixTiling", int(m_FixTiling));
-        m_ShadedShader->setUniform1i("uFog", int(m_Fog));
-        m_ShadedShader->setUniform3f("uSunCol", m_Sky.getSunCol());
-        m_ShadedShader->setUniform1f("uSunStr", m_SunStr);
-        m_ShadedShader->setUniform1f("uSkyDiff", m_SkyDiff);
-        m_ShadedShader->setUniform1f("uSkySpec", m_SkySpec);
-        m_ShadedShader->setUniform1f("uRefStr", m_RefStr);
-        m_ShadedShader->setUniform1f("uTilingFactor", m_TilingFactor);
-        m_ShadedShader->setUniform1f("uNormalStrength", m_NormalStrength);
-
-        m_ShadedShader->setUniform1f("uAerialDist", m_Sky.getAerialDistScale());
+        m_ShadedShader->setUniform(u_shadow, int(m_Shadows));
+        m_ShadedShader->setUniform(u_material, int(m_Materials));
+        m_ShadedShader->setUniform(u_fix_tiling, int(m_FixTiling));
+        m_ShadedShader->setUniform(u_fog, int(m_Fog));
+        m_ShadedShader->setUniform(u_sun_str, m_SunStr);
+        m_ShadedShader->setUniform(u_sky_diff, m_SkyDiff);
+        m_ShadedShader->setUniform(u_sky_spec, m_SkySpec);
+        m_ShadedShader->setUniform(u_ref_str, m_RefStr);
+        m_ShadedShader->setUniform(u_tiling_factor, m_TilingFactor);
+        m_ShadedShader->setUniform(u_normal_strength, m_NormalStrength);
+
+        m_ShadedShader->setUniform(u_aerial_dist, m_Sky.getAerialDistScale());
 
         m_Map.BindNormalmap(0);
-        m_ShadedShader->setUniform1i("normalmap", 0);
+        m_ShadedShader->setUniform(u_normalmap, 0);
         m_Map.BindShadowmap(1);
-        m_ShadedShader->setUniform1i("shadowmap", 1);
+        m_ShadedShader->setUniform(u_shadowmap, 1);
         m_Map.BindMaterialmap(2);
-        m_ShadedShader->setUniform1i("materialmap", 2);
+        m_ShadedShader->setUniform(u_materialmap, 2);
 
         m_Material.BindAlbedo(3);
-        m_ShadedShader->setUniform1i("albedo", 3);
+        m_ShadedShader->setUniform(u_albedo, 3);
         m_Material.BindNormal(4);
-        m_ShadedShader->setUniform1i("normal", 4);
+        m_ShadedShader->setUniform(u_normal, 4);
 
         m_Sky.BindIrradiance(5);
-        m_ShadedShader->setUniform1i("irradiance", 5);
+        m_ShadedShader->setUniform(u_irradiance, 5);
         m_Sky.BindPrefiltered(6);
-        m_ShadedShader->setUniform1i("prefiltered", 6);
+        m_ShadedShader->setUniform(u_prefiltered, 6);
         m_Sky.BindAerial(7);
-        m_ShadedShader->setUniform1i("aerial", 7);
+        m_ShadedShader->setUniform(u_aerial, 7);
+
+        m_ShadedShader->setUniform(u_instanced, int(m_Clipmap.getMode() == ClipmapMode::Instanced));
+
+        m_ShadedShader->setUniform(u_sample_height, int(m_Clipmap.SamplesHeight()));
+        m_Map.BindHeightmap(8);
+        m_ShadedShader->setUniform(u_heightmap, 8);
+        m_Map.BindHeightStack(*m_ShadedShader, 9);
     }
     
     {
-        ProfilerGPUEvent we("Terrain::Draw");
+        LOFI_PROFILE_GPU("Terrain::Draw");
 
-        auto scale_y = m_Map.getScaleY();
-
-        for (const auto& grid : m_Clipmap.getGrids())
-        {
-            if (m_Camera.IsInFrustum(grid.BoundingBox, scale_y))
-            {
-                grid.Draw();
-            }
-        }
-
-        for (const auto& fill : m_Clipmap.getFills())
-        {
-            fill.Draw();
-        }
+        m_Clipmap.Draw();
     }
 }
 
@@ -199,6 +359,12 @@ void TerrainRenderer::OnImGui(bool& open) {
     ImGui::Columns(1, "###col");
     ImGuiUtils::EndGroupPanel();
 
+    ImGuiUtils::BeginGroupPanel("Culling:");
+    ImGui::Columns(2, "###col");
+    ImGuiUtils::ColCheckbox("Occlusion culling", &m_OcclusionCulling);
+    ImGui::Columns(1, "###col");
+    ImGuiUtils::EndGroupPanel();
+
     ImGuiUtils::BeginGroupPanel("Background:");
     ImGui::Columns(2, "###col");
     ImGuiUtils::ColColorEdit3("ClearColor", &m_ClearColor);
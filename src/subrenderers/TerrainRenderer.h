@@ -18,10 +18,12 @@ public:
                     const SkyRenderer& sky);
     ~TerrainRenderer();
 
-    void Init(uint32_t subdivisions, uint32_t levels);
+    void Init(uint32_t subdivisions, uint32_t levels, ClipmapMode mode);
 
     void Update();
     void RequestFullUpdate();
+    //Displaces only vertices within the uv rectangle (min.xy, max.xy) of the heightmap
+    void RequestRegionUpdate(const glm::vec4& uv_rect);
 
     void RenderWireframe();
     void RenderShaded();
@@ -31,7 +33,17 @@ public:
     bool DoShadows() { return m_Shadows; }
     bool DoFog() { return m_Fog; }
 
+    void setOcclusionCulling(bool enabled) { m_OcclusionCulling = enabled; }
+
+    float getClipmapExtent() const { return m_Clipmap.getExtent(); }
+
 private:
+    void UpdateGeometry();
+    void CullGeometry();
+
+    //Draws depth of the last frame's visible grids and reduces it into the hi-z pyramid
+    void RenderOccluders();
+
     //Settings
     glm::vec3 m_ClearColor{ 0.0f, 0.0f, 0.0f };
 
@@ -43,11 +55,26 @@ private:
     bool m_Materials = true, m_FixTiling = true;
     bool m_Fog = true;
 
+    bool m_OcclusionCulling = false;
+
     //Private resources
     bool m_UpdateAll = true;
 
+    bool m_UpdateRegion = false;
+    glm::vec4 m_UpdateRect{ 0.0f };
+
     std::shared_ptr<VertFragShader> m_ShadedShader, m_WireframeShader;
-    std::shared_ptr<ComputeShader> m_DisplaceShader;
+    std::shared_ptr<ComputeShader> m_DisplaceShader, m_CullShader;
+
+    //Occlusion culling resources, occluders are drawn straight into the first mip of the pyramid
+    static const int s_HiZResolution = 512;
+
+    std::shared_ptr<VertFragShader> m_OccluderShader;
+    std::shared_ptr<ComputeShader> m_HiZShader;
+    std::shared_ptr<Texture2D> m_HiZ;
+    int m_HiZMips = 0;
+
+    unsigned int m_OcclusionFBO = 0, m_OcclusionDepthRBO = 0;
 
     Clipmap m_Clipmap;
 
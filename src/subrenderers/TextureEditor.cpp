@@ -1,4 +1,5 @@
 #include "TextureEditor.h"
+#include "FusedProcedures.h"
 
 #include "glad/glad.h"
 
@@ -7,14 +8,36 @@
 #include "ImGuiUtils.h"
 
 #include <algorithm>
+#include <cmath>
+
+void DispatchRegion::SetUniforms(Shader& shader) const {
+    static const Uniform<glm::ivec2> offset("uRegionOffset"), size("uRegionSize");
+    static const Uniform<float> texel_size("uTexelSize");
+    static const Uniform<int> toroidal("uToroidal");
+
+    shader.setUniform(offset, Offset);
+    shader.setUniform(size, Size);
+    shader.setUniform(texel_size, TexelSize);
+    shader.setUniform(toroidal, int(Toroidal));
+}
+
+DispatchRegion DispatchRegion::Full(int res) {
+    return DispatchRegion{ glm::ivec2(0), glm::ivec2(res), false, 1.0f / float(res) };
+}
+
+bool DispatchRegion::IsFull() const {
+    const int res = int(std::round(1.0f / TexelSize));
+
+    return !Toroidal && Offset == glm::ivec2(0) && Size.x >= res && Size.y >= res;
+}
 
 ConstIntTask::ConstIntTask(const std::string& uniform_name, int val) 
-    : UniformName(uniform_name), Value(val) {}
+    : UniformName(uniform_name), Handle(uniform_name), Value(val) {}
 
 void ConstIntTask::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<int>(data);
-    shader.setUniform1i(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void ConstIntTask::OnSerialize(nlohmann::ordered_json& output, InstanceData data)
@@ -33,12 +56,12 @@ void ConstIntTask::ProvideData(std::vector<InstanceData>& data, nlohmann::ordere
 }
 
 ConstFloatTask::ConstFloatTask(const std::string& uniform_name, float val) 
-    : UniformName(uniform_name), Value(val) {}
+    : UniformName(uniform_name), Handle(uniform_name), Value(val) {}
 
 void ConstFloatTask::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<float>(data);
-    shader.setUniform1f(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void ConstFloatTask::OnSerialize(nlohmann::ordered_json& output, InstanceData data)
@@ -59,13 +82,13 @@ void ConstFloatTask::ProvideData(std::vector<InstanceData>& data, nlohmann::orde
 SliderIntTask::SliderIntTask(const std::string& uniform_name,
                              const std::string& ui_name,
                              int min, int max, int def)
-    : UniformName(uniform_name), UiName(ui_name), Min(min), Max(max), Def(def)
+    : UniformName(uniform_name), UiName(ui_name), Handle(uniform_name), Min(min), Max(max), Def(def)
 {}
 
 void SliderIntTask::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<int>(data);
-    shader.setUniform1i(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void SliderIntTask::OnSerialize(nlohmann::ordered_json& output, InstanceData data)
@@ -99,13 +122,13 @@ void SliderIntTask::ProvideData(std::vector<InstanceData>& data, nlohmann::order
 SliderFloatTask::SliderFloatTask(const std::string& uniform_name,
                                  const std::string& ui_name,
                                  float min, float max, float def)
-    : UniformName(uniform_name), UiName(ui_name), Min(min), Max(max), Def(def)
+    : UniformName(uniform_name), UiName(ui_name), Handle(uniform_name), Min(min), Max(max), Def(def)
 {}
 
 void SliderFloatTask::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<float>(data);
-    shader.setUniform1f(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void SliderFloatTask::OnImGui(InstanceData& data, bool& state, const std::string& suffix)
@@ -139,13 +162,13 @@ void SliderFloatTask::ProvideData(std::vector<InstanceData>& data, nlohmann::ord
 ColorEdit3Task::ColorEdit3Task(const std::string& uniform_name,
                                const std::string& ui_name,
                                glm::vec3 def)
-    : UniformName(uniform_name), UiName(ui_name), Def(def)
+    : UniformName(uniform_name), UiName(ui_name), Handle(uniform_name), Def(def)
 {}
 
 void ColorEdit3Task::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<glm::vec3>(data);
-    shader.setUniform3f(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void ColorEdit3Task::OnImGui(InstanceData& data, bool& state, const std::string& suffix)
@@ -181,13 +204,13 @@ void ColorEdit3Task::ProvideData(std::vector<InstanceData>& data, nlohmann::orde
 GLEnumTask::GLEnumTask(const std::string& uniform_name,
                        const std::string& ui_name,
                        const std::vector<std::string>& labels)
-     : UniformName(uniform_name), UiName(ui_name), Labels(labels)
+     : UniformName(uniform_name), UiName(ui_name), Handle(uniform_name), Labels(labels)
 {}
 
 void GLEnumTask::OnDispatch(Shader& shader, const InstanceData& data)
 {
     auto value = std::get<int>(data);
-    shader.setUniform1i(UniformName, value);
+    shader.setUniform(Handle, value);
 }
 
 void GLEnumTask::OnImGui(InstanceData& data, bool& state, const std::string& suffix)
@@ -225,23 +248,30 @@ Procedure::Procedure(ResourceManager& manager)
 {}
 
 void Procedure::CompileShader(const std::string& filepath) {
+    m_Filepath = filepath;
     m_Shader = m_ResourceManager.RequestComputeShader(filepath);
 }
 
-void Procedure::OnDispatch(int res, const std::vector<InstanceData>& data) {
+void Procedure::OnDispatch(const DispatchRegion& region, const std::vector<InstanceData>& data) {
     m_Shader -> Bind();
 
+    //Ignored by shaders which always process the entire texture
+    region.SetUniforms(*m_Shader);
+    SetUniforms(*m_Shader, data);
+
+    m_Shader->Dispatch(region.Size.x, region.Size.y, 1);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Procedure::SetUniforms(Shader& shader, const std::vector<InstanceData>& data) const {
     unsigned int i = 0;
-    
+
     for (auto& task : m_Tasks) {
-        task->OnDispatch(*m_Shader.get(), data[i]);
+        task->OnDispatch(shader, data[i]);
 
         ++i;
     }
-
-    m_Shader->Dispatch(res, res, 1);
-
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
 }
 
 bool Procedure::OnImGui(std::vector<InstanceData>& data, unsigned int id) {
@@ -278,6 +308,12 @@ void EditorBase::RegisterShader(const std::string& name,
     m_Procedures.at(name).CompileShader(filepath);
 }
 
+void EditorBase::AttachCpu(const std::string& name, CpuProcedure function)
+{
+    if (m_Procedures.count(name))
+        m_Procedures.at(name).m_CpuFunction = function;
+}
+
 //===========================================================================
 
 void AddProcedureInstanceImpl(std::unordered_map<std::string, Procedure>& procedures,
@@ -293,6 +329,9 @@ void AddProcedureInstanceImpl(std::unordered_map<std::string, Procedure>& proced
         for (auto& task : procedure.m_Tasks) {
             task->ProvideDefaultData(data);
         }
+
+        if (procedure.m_StageFactory)
+            instances.back().Stage = procedure.m_StageFactory();
     }
 }
 
@@ -309,18 +348,131 @@ void AddProcedureInstanceImpl(std::unordered_map<std::string, Procedure>& proced
         for (auto& task : procedure.m_Tasks) {
             task->ProvideData(data, input);
         }
+
+        if (procedure.m_StageFactory)
+            instances.back().Stage = procedure.m_StageFactory();
     }
 }
 
-void OnDispatchImpl(std::unordered_map<std::string, Procedure>& procedures,
-                    std::vector<ProcedureInstance>& instances,
-                    int res) 
+//Boost style hash_combine
+size_t HashCombine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+size_t HashInstance(const ProcedureInstance& instance) {
+    size_t res = std::hash<std::string>{}(instance.Name);
+
+    for (auto& data : instance.Data) {
+        res = HashCombine(res, data.index());
+
+        if (auto value = std::get_if<int>(&data))
+            res = HashCombine(res, std::hash<int>{}(*value));
+
+        else if (auto value = std::get_if<float>(&data))
+            res = HashCombine(res, std::hash<float>{}(*value));
+
+        else if (auto value = std::get_if<glm::vec3>(&data)) {
+            for (int i = 0; i < 3; i++)
+                res = HashCombine(res, std::hash<float>{}((*value)[i]));
+        }
+    }
+
+    return res;
+}
+
+//Returns true if the stage needs to continue with the next dispatch
+bool DispatchStage(Procedure& procedure, ProcedureInstance& instance,
+                   const DispatchRegion& region, size_t key)
 {
-    for (auto& instance : instances) {
-        auto& data = instance.Data;
+    auto& stage = *instance.Stage;
+
+    if (!instance.StageStarted || instance.StageKey != key) {
+        //Input of the stage is the entire texture, so a new run needs a full dispatch
+        if (!region.IsFull())
+            return true;
+
+        stage.OnStart(region, procedure, instance.Data);
+
+        instance.StageKey = key;
+        instance.StageStarted = true;
+        instance.StageFinished = false;
+    }
+
+    //Partial dispatches only write the state left by the last full one
+    if (!instance.StageFinished && region.IsFull())
+        instance.StageFinished = stage.OnStep(procedure, instance.Data);
+
+    stage.OnWrite(region);
+
+    return !instance.StageFinished;
+}
+
+//Procedures are deterministic, so the key of all instances up to a given one
+//identifies the texture content after it. Resolution is a part of the input, and so is
+//the shader generation, since reloaded shaders invalidate checkpoints and stage results.
+std::vector<size_t> InstanceKeys(const std::vector<ProcedureInstance>& instances,
+                                 const DispatchRegion& region, size_t shader_generation)
+{
+    std::vector<size_t> keys(instances.size());
+    size_t key = HashCombine(std::hash<float>{}(region.TexelSize), shader_generation);
+
+    for (size_t i = 0; i < instances.size(); i++) {
+        key = HashCombine(key, HashInstance(instances[i]));
+        keys[i] = key;
+    }
+
+    return keys;
+}
+
+//Index of the last stage which was started with its current input, since result of that
+//stage already contains all preceding procedures. Stages need the entire texture,
+//so toroidal (height stack) dispatches don't run them and always start from 0.
+size_t StageResumeIndex(const std::vector<ProcedureInstance>& instances,
+                        const std::vector<size_t>& keys, const DispatchRegion& region)
+{
+    if (region.Toroidal)
+        return 0;
+
+    for (size_t i = instances.size(); i-- > 0;) {
+        auto& instance = instances[i];
 
-        procedures.at(instance.Name).OnDispatch(res, data);
+        if (instance.Stage && instance.StageStarted && instance.StageKey == keys[i])
+            return i;
     }
+
+    return 0;
+}
+
+//Returns true if the instance is a stage which didn't finish
+bool DispatchInstance(std::unordered_map<std::string, Procedure>& procedures,
+                      ProcedureInstance& instance, const DispatchRegion& region, size_t key)
+{
+    auto& procedure = procedures.at(instance.Name);
+
+    if (!instance.Stage) {
+        procedure.OnDispatch(region, instance.Data);
+        return false;
+    }
+
+    if (region.Toroidal)
+        return false;
+
+    return DispatchStage(procedure, instance, region, key);
+}
+
+//Returns true if some stage didn't finish
+bool OnDispatchImpl(std::unordered_map<std::string, Procedure>& procedures,
+                    std::vector<ProcedureInstance>& instances,
+                    const DispatchRegion& region, size_t shader_generation)
+{
+    const auto keys = InstanceKeys(instances, region, shader_generation);
+
+    bool pending = false;
+
+    for (size_t i = StageResumeIndex(instances, keys, region); i < instances.size(); i++)
+        pending |= DispatchInstance(procedures, instances[i], region, keys[i]);
+
+    return pending;
 }
 
 bool OnImGuiImpl(std::unordered_map<std::string, Procedure>& procedures,
@@ -423,9 +575,12 @@ bool PopupImpl(std::unordered_map<std::string, Procedure>& procedures,
 #include <iostream>
 
 TextureEditor::TextureEditor(ResourceManager& manager, const std::string& name)
-    : EditorBase(manager), m_Name(name), m_InstanceID(s_InstanceCount++) 
+    : EditorBase(manager), m_Name(name), m_FusedProcedures(std::make_unique<FusedProcedures>(manager)),
+      m_InstanceID(s_InstanceCount++)
 {}
 
+TextureEditor::~TextureEditor() = default;
+
 void TextureEditor::AddProcedureInstance(const std::string& name) {
     AddProcedureInstanceImpl(m_Procedures, m_Instances, name);
 }
@@ -435,7 +590,194 @@ void TextureEditor::AddProcedureInstance(const std::string& name, nlohmann::orde
 }
 
 void TextureEditor::OnDispatch(int res) {
-    OnDispatchImpl(m_Procedures, m_Instances, res);
+    OnDispatch(DispatchRegion::Full(res));
+}
+
+void TextureEditor::OnDispatch(const DispatchRegion& region) {
+    const auto keys = InstanceKeys(m_Instances, region, m_ResourceManager.getShaderGeneration());
+
+    size_t first = StageResumeIndex(m_Instances, keys, region);
+
+    //Stack dispatches don't run stages and write to other textures than the checkpoint target
+    const bool checkpoints = m_CheckpointTarget && !region.Toroidal;
+
+    if (checkpoints) {
+        m_DispatchCount++;
+
+        //Checkpoint after instance i lets the dispatch start with instance i + 1
+        for (size_t i = m_Instances.size(); i-- > first;) {
+            Checkpoint* checkpoint = FindCheckpoint(keys[i]);
+
+            if (checkpoint) {
+                glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+                checkpoint->Texture->CopyTo(*m_CheckpointTarget, region.Offset.x, region.Offset.y,
+                                            region.Size.x, region.Size.y);
+                checkpoint->LastUse = m_DispatchCount;
+
+                first = i + 1;
+                break;
+            }
+        }
+    }
+
+    //Checkpoints need the entire texture, and can't be taken after
+    //unfinished stages, since their keys don't include the progress
+    bool stable = checkpoints && region.IsFull();
+    bool pending = false;
+
+    //First instance with changed input, usually the one being edited. Fused runs end before it,
+    //so that the instances preceding it get a checkpoint and later edits resume from there.
+    size_t split = m_Instances.size();
+
+    if (checkpoints) {
+        split = 0;
+
+        while (split < keys.size() && split < m_LastKeys.size() && keys[split] == m_LastKeys[split])
+            split++;
+
+        m_LastKeys = keys;
+    }
+
+    for (size_t i = first; i < m_Instances.size();) {
+        //Instances [i, last) are dispatched together
+        size_t last = i + 1;
+
+        if (m_Fusion && !m_Instances[i].Stage) {
+            while (last < m_Instances.size() && !m_Instances[last].Stage && last != split)
+                last++;
+        }
+
+        const bool fused = (last - i > 1) && m_FusedProcedures->Dispatch(m_Procedures, m_Instances, i, last, region);
+
+        for (size_t j = i; j < last && !fused; j++) {
+            auto& instance = m_Instances[j];
+
+            pending |= DispatchInstance(m_Procedures, instance, region, keys[j]);
+
+            if (instance.Stage && !instance.StageFinished)
+                stable = false;
+
+            if (stable)
+                WriteCheckpoint(keys[j]);
+        }
+
+        if (fused && stable)
+            WriteCheckpoint(keys[last - 1]);
+
+        i = last;
+    }
+
+    if (!region.Toroidal)
+        m_Pending = pending;
+}
+
+bool TextureEditor::OnDispatchCpu(std::vector<float>& heights, int res, DispatchRegion& region) {
+    if (region.Toroidal)
+        return false;
+
+    for (const auto& instance : m_Instances) {
+        if (!m_Procedures.at(instance.Name).m_CpuFunction)
+            return false;
+    }
+
+    //Cpu procedures don't depend on shaders
+    const auto keys = InstanceKeys(m_Instances, DispatchRegion::Full(res), 0);
+    const size_t count = size_t(res) * size_t(res);
+
+    heights.resize(count);
+
+    size_t first = 0;
+
+    for (size_t i = m_Instances.size(); i-- > 0;) {
+        const auto& instance = m_Instances[i];
+
+        if (instance.Stage && instance.CpuKey == keys[i] && instance.CpuResult.size() == count) {
+            //Content outside of the region is already up to date
+            for (int y = region.Offset.y; y < region.Offset.y + region.Size.y; y++) {
+                const size_t offset = size_t(y) * size_t(res) + size_t(region.Offset.x);
+                std::copy_n(instance.CpuResult.begin() + offset, region.Size.x, heights.begin() + offset);
+            }
+
+            first = i + 1;
+            break;
+        }
+    }
+
+    for (size_t i = first; i < m_Instances.size(); i++) {
+        if (m_Instances[i].Stage)
+            region = DispatchRegion::Full(res);
+    }
+
+    for (size_t i = first; i < m_Instances.size(); i++) {
+        auto& instance = m_Instances[i];
+        const auto& procedure = m_Procedures.at(instance.Name);
+
+        procedure.m_CpuFunction(heights, res, region, procedure, instance.Data);
+
+        if (instance.Stage) {
+            instance.CpuResult = heights;
+            instance.CpuKey = keys[i];
+        }
+    }
+
+    return true;
+}
+
+void TextureEditor::EnableCheckpoints(std::shared_ptr<Texture2D> target, size_t budget) {
+    m_CheckpointTarget = target;
+    m_Checkpoints.clear();
+
+    const auto& spec = target->getSpec();
+    const size_t size = BytesPerTexel(spec.InternalFormat) * size_t(spec.ResolutionX) * size_t(spec.ResolutionY);
+
+    //Textures are allocated once they are needed
+    for (size_t i = 0; i < budget / size; i++)
+        m_Checkpoints.push_back(Checkpoint{});
+}
+
+Checkpoint* TextureEditor::FindCheckpoint(size_t key) {
+    for (auto& checkpoint : m_Checkpoints) {
+        if (checkpoint.Valid && checkpoint.Key == key)
+            return &checkpoint;
+    }
+
+    return nullptr;
+}
+
+void TextureEditor::WriteCheckpoint(size_t key) {
+    if (m_Checkpoints.empty() || FindCheckpoint(key))
+        return;
+
+    //Invalid checkpoints have LastUse of 0
+    auto it = std::min_element(m_Checkpoints.begin(), m_Checkpoints.end(),
+        [](const Checkpoint& lhs, const Checkpoint& rhs) {
+            const size_t l = lhs.Valid ? lhs.LastUse : 0, r = rhs.Valid ? rhs.LastUse : 0;
+            return l < r;
+        }
+    );
+
+    auto& checkpoint = *it;
+
+    if (!checkpoint.Texture) {
+        auto spec = m_CheckpointTarget->getSpec();
+        spec.MagFilter = GL_NEAREST;
+        spec.MinFilter = GL_NEAREST;
+
+        checkpoint.Texture = m_ResourceManager.RequestTexture2D("Checkpoints");
+        checkpoint.Texture->Initialize(spec);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    const int res_x = m_CheckpointTarget->getSpec().ResolutionX;
+    const int res_y = m_CheckpointTarget->getSpec().ResolutionY;
+
+    m_CheckpointTarget->CopyTo(*checkpoint.Texture, 0, 0, res_x, res_y);
+
+    checkpoint.Key = key;
+    checkpoint.Valid = true;
+    checkpoint.LastUse = m_DispatchCount;
 }
 
 bool TextureEditor::OnImGui() {
@@ -505,7 +847,8 @@ void TextureArrayEditor::AddProcedureInstance(int layer, const std::string& name
 void TextureArrayEditor::OnDispatch(int layer, int res) {
     auto& instances = m_InstanceLists[layer];
 
-    OnDispatchImpl(m_Procedures, instances, res);
+    OnDispatchImpl(m_Procedures, instances, DispatchRegion::Full(res),
+                   m_ResourceManager.getShaderGeneration());
 }
 
 bool TextureArrayEditor::OnImGui(int layer) {
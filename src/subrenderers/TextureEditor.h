@@ -7,13 +7,36 @@
 #include <variant>
 #include <memory>
 #include <unordered_map>
+#include <functional>
 
 #include "nlohmann/json.hpp"
 
 typedef std::variant<int, float, glm::vec3> InstanceData;
 
+//Texels updated by a single dispatch, in global texel coordinates (see terrain/region.glsl).
+//With toroidal addressing texel p is stored at p mod resolution, TexelSize converts
+//global texel coordinates into map uv.
+struct DispatchRegion {
+    glm::ivec2 Offset{0};
+    glm::ivec2 Size{0};
+
+    bool Toroidal = false;
+    float TexelSize = 0.0f;
+
+    bool Empty() const { return Size.x <= 0 || Size.y <= 0; }
+    //True if the region is the entire (non toroidal) texture
+    bool IsFull() const;
+
+    //Sets uniforms declared in terrain/region.glsl
+    void SetUniforms(Shader& shader) const;
+
+    //Entire texture of given resolution
+    static DispatchRegion Full(int res);
+};
+
 class EditorTask{
 public:
+    virtual const std::string& getUniformName() const = 0;
 
     virtual void OnDispatch(Shader& shader, const InstanceData& data) = 0;
     virtual void OnImGui(InstanceData& data, bool& state, const std::string& suffix) {}
@@ -27,6 +50,8 @@ class ConstIntTask : public EditorTask{
 public:
     ConstIntTask(const std::string& uniform_name, int val);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
 
@@ -34,6 +59,7 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName;
+    Uniform<int> Handle;
     const int Value;
 };
 
@@ -41,6 +67,8 @@ class ConstFloatTask : public EditorTask{
 public:
     ConstFloatTask(const std::string& uniform_name, float val);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
 
@@ -48,6 +76,7 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName;
+    Uniform<float> Handle;
     const float Value;
 };
 
@@ -57,6 +86,8 @@ public:
                   const std::string& ui_name,
                   int min, int max, int def);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnImGui(InstanceData& data, bool& state, const std::string& suffix) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
@@ -65,6 +96,7 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName, UiName;
+    Uniform<int> Handle;
     int Min, Max, Def;
 };
 
@@ -74,6 +106,8 @@ public:
                     const std::string& ui_name,
                     float min, float max, float def);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnImGui(InstanceData& data, bool& state, const std::string& suffix) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
@@ -82,6 +116,7 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName, UiName;
+    Uniform<float> Handle;
     float Min, Max, Def;
 };
 
@@ -91,6 +126,8 @@ public:
                    const std::string& ui_name,
                    glm::vec3 def);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnImGui(InstanceData& data, bool& state, const std::string& suffix) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
@@ -99,6 +136,7 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName, UiName;
+    Uniform<glm::vec3> Handle;
     glm::vec3 Def;
 };
 
@@ -108,6 +146,8 @@ public:
                const std::string& ui_name,
                const std::vector<std::string>& labels);
 
+    const std::string& getUniformName() const override { return UniformName; }
+
     void OnDispatch(Shader& shader, const InstanceData& data) override;
     void OnImGui(InstanceData& data, bool& state, const std::string& suffix) override;
     void OnSerialize(nlohmann::ordered_json& output, InstanceData data) override;
@@ -116,9 +156,32 @@ public:
     void ProvideData(std::vector<InstanceData>& data, nlohmann::ordered_json& input) override;
 
     std::string UniformName, UiName;
+    Uniform<int> Handle;
     std::vector<std::string> Labels;
 };
 
+class Procedure;
+
+//Cpu implementation of a procedure, updates the region of heights (res x res values in row major order).
+//Procedures implemented by stages get the entire map as the region.
+typedef std::function<void(std::vector<float>& heights, int res, const DispatchRegion& region,
+                           const Procedure& procedure, const std::vector<InstanceData>& data)> CpuProcedure;
+
+//Procedure which can't be done in a single pointwise dispatch (e.g. erosion). Stages keep their own
+//copy of the result, so it is computed once per input and may take multiple dispatches to finish.
+class ProcedureStage {
+public:
+    virtual ~ProcedureStage() = default;
+
+    //Begins a new run, input is the texture bound to image unit 0 and region covers all of it
+    virtual void OnStart(const DispatchRegion& region, const Procedure& procedure,
+                         const std::vector<InstanceData>& data) = 0;
+    //Advances the run by a limited amount of work, returns true once it is finished
+    virtual bool OnStep(const Procedure& procedure, const std::vector<InstanceData>& data) = 0;
+    //Writes the current result into the region of the texture bound to image unit 0
+    virtual void OnWrite(const DispatchRegion& region) = 0;
+};
+
 class Procedure{
 public:
     Procedure(ResourceManager& manager);
@@ -136,12 +199,33 @@ public:
         ));
     }
 
-    void OnDispatch(int res, const std::vector<InstanceData>& data);
+    void OnDispatch(const DispatchRegion& region, const std::vector<InstanceData>& data);
     bool OnImGui(std::vector<InstanceData>& data, unsigned int id);
 
+    //Sets uniforms of all tasks, for stages dispatching their own shaders
+    void SetUniforms(Shader& shader, const std::vector<InstanceData>& data) const;
+
+    //Value of the task with given uniform name, for stages which need it on the cpu
+    template<typename T>
+    T getValue(const std::vector<InstanceData>& data, const std::string& uniform_name) const {
+        for (size_t i = 0; i < m_Tasks.size(); i++) {
+            if (m_Tasks[i]->getUniformName() == uniform_name)
+                return std::get<T>(data[i]);
+        }
+
+        return T{};
+    }
+
     std::shared_ptr<ComputeShader> m_Shader;
+    std::string m_Filepath;
     std::vector<std::unique_ptr<EditorTask>> m_Tasks;
 
+    //Set for procedures implemented by stages, each instance gets its own stage
+    std::function<std::shared_ptr<ProcedureStage>()> m_StageFactory;
+
+    //Optional, used by TextureEditor::OnDispatchCpu
+    CpuProcedure m_CpuFunction;
+
     ResourceManager& m_ResourceManager;
 };
 
@@ -153,6 +237,27 @@ public:
     std::vector<InstanceData> Data;
 
     bool KeepAlive = true;
+
+    //Stage and the key of the input (preceding instances and own data) it was started with
+    std::shared_ptr<ProcedureStage> Stage;
+    size_t StageKey = 0;
+    bool StageStarted = false, StageFinished = false;
+
+    //Map after the cpu implementation of the stage and the key it belongs to, see OnDispatchCpu
+    std::vector<float> CpuResult;
+    size_t CpuKey = 0;
+};
+
+//Texture content after some instance of a TextureEditor stack, see TextureEditor::EnableCheckpoints
+struct Checkpoint {
+    std::shared_ptr<Texture2D> Texture;
+
+    //Key of the instance (and all preceding ones) the content corresponds to
+    size_t Key = 0;
+    bool Valid = false;
+
+    //Dispatch of the last use, least recently used checkpoint is replaced first
+    size_t LastUse = 0;
 };
 
 class EditorBase {
@@ -161,6 +266,27 @@ public:
 
     void RegisterShader(const std::string& name, const std::string& filepath);
 
+    //Registers procedure implemented by a stage of type T, constructed from the resource manager,
+    //T::Resources and args. Resources (e.g. shaders) are created once here and shared by all
+    //instances of the procedure. Tasks are attached the same way as for shaders.
+    template<class T, typename ... Args>
+    void RegisterStage(const std::string& name, Args ... args)
+    {
+        static_assert(std::is_base_of<ProcedureStage, T>::value,
+            "RegisterStage template argument not derived from ProcedureStage"
+        );
+
+        if (m_Procedures.count(name)) return;
+
+        ResourceManager& manager = m_ResourceManager;
+        auto resources = std::make_shared<const typename T::Resources>(manager);
+
+        m_Procedures.emplace(name, m_ResourceManager);
+        m_Procedures.at(name).m_StageFactory = [&manager, resources, args...]() {
+            return std::shared_ptr<ProcedureStage>(new T(manager, resources, args...));
+        };
+    }
+
     template<class T, typename ... Args>
     void Attach(const std::string& name, Args ... args)
     {
@@ -172,21 +298,50 @@ public:
             m_Procedures.at(name).Add<T>(args...);
     }
 
+    void AttachCpu(const std::string& name, CpuProcedure function);
+
 protected:
     std::unordered_map<std::string, Procedure> m_Procedures;
 
     ResourceManager& m_ResourceManager;
 };
 
+class FusedProcedures;
+
 class TextureEditor : public EditorBase{
 public:
     TextureEditor(ResourceManager& manager, const std::string& name);
+    ~TextureEditor();
 
     void AddProcedureInstance(const std::string& name);
 
     void OnDispatch(int res);
+    void OnDispatch(const DispatchRegion& region);
     bool OnImGui();
 
+    //Keeps copies of target after recomputed instances, as many as fit in the budget (in bytes).
+    //Dispatches then resume after the last instance whose checkpoint is still valid, so editing
+    //late procedures doesn't recompute the early ones. Target has to be the texture bound to image
+    //unit 0 for all non toroidal dispatches.
+    void EnableCheckpoints(std::shared_ptr<Texture2D> target, size_t budget);
+
+    //Runs consecutive shader procedures as a single generated kernel (see FusedProcedures.h).
+    //Checkpoints are then only written after each fused run and stage, runs are split before
+    //the first instance whose input changed since the last dispatch (i.e. the edited one).
+    void SetFusion(bool enabled) { m_Fusion = enabled; }
+    bool IsFused() const { return m_Fusion; }
+
+    //Runs the stack with cpu implementations of the procedures, the previous content of heights
+    //(res x res values in row major order) is the input of the first one. Returns false if some
+    //procedure doesn't have one, region can't be toroidal. Results of stages are kept, dispatches
+    //resume after the last stage whose input didn't change. If some stage has to run, the entire
+    //map is updated, so region is replaced by it.
+    bool OnDispatchCpu(std::vector<float>& heights, int res, DispatchRegion& region);
+
+    //True if some stage didn't finish during the last dispatch, it continues
+    //with the next one covering the entire texture
+    bool IsPending() const { return m_Pending; }
+
     void OnSerialize(nlohmann::ordered_json& output);
     void OnDeserialize(nlohmann::ordered_json& input);
 
@@ -198,7 +353,22 @@ private:
     
     std::string m_Name;
 
+    //Returns checkpoint holding content of given key, nullptr if there isn't one
+    Checkpoint* FindCheckpoint(size_t key);
+    void WriteCheckpoint(size_t key);
+
     bool m_PopupOpen = true;
+    bool m_Pending = false;
+    bool m_Fusion = false;
+
+    std::unique_ptr<FusedProcedures> m_FusedProcedures;
+
+    std::shared_ptr<Texture2D> m_CheckpointTarget;
+    std::vector<Checkpoint> m_Checkpoints;
+    size_t m_DispatchCount = 0;
+
+    //Instance keys of the last non toroidal dispatch
+    std::vector<size_t> m_LastKeys;
 
     unsigned int m_InstanceID;
     static unsigned int s_InstanceCount;